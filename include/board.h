@@ -33,10 +33,18 @@
 #ifndef __BOARD_H__
 #define __BOARD_H__
 
+#include <stdint.h>
+
 /**
  * \brief Initialize all board dependant functionality
  * \return 0 on success, -1 otherwise
  */
 int board_init(void);
 
+/**
+ * \brief Get the current SMCLK frequency
+ * \return the SMCLK frequency in Hz
+ */
+uint32_t board_get_smclk(void);
+
 #endif /* __BOARD_H__ */
@@ -0,0 +1,65 @@
+/**
+ * \file cobs.h
+ * \author Chris Karaplis
+ * \brief Consistent Overhead Byte Stuffing API
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __COBS_H__
+#define __COBS_H__
+
+#include <stddef.h>
+
+/* Maximum encoded size of len bytes, excluding the frame delimiter */
+#define COBS_ENCODED_MAX(len)   ((len) + ((len) / 254) + 1)
+
+/**
+ * \brief Encode a block of data
+ * \param[in] src - the data to encode
+ * \param[in] len - the number of bytes to encode
+ * \param[out] dst - the buffer to store the encoded data, at least COBS_ENCODED_MAX(len) bytes
+ * \return the number of encoded bytes
+ *
+ * The encoded data contains no zero bytes. The zero frame delimiter is
+ * not appended. Less than 254 bytes may be encoded in place one byte down
+ * (dst == src - 1), as the encoding then only adds the leading code byte.
+ */
+size_t cobs_encode(const void *src, size_t len, void *dst);
+
+/**
+ * \brief Decode a block of data
+ * \param[in] src - the encoded data, without the frame delimiter
+ * \param[in] len - the number of encoded bytes
+ * \param[out] dst - the buffer to store the decoded data, at least len bytes
+ * \return the number of decoded bytes on success, -1 if the data is invalid
+ *
+ * The data may be decoded in place (dst == src).
+ */
+int cobs_decode(const void *src, size_t len, void *dst);
+
+#endif /* __COBS_H__ */
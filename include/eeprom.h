@@ -0,0 +1,87 @@
+/**
+ * \file eeprom.h
+ * \author Chris Karaplis
+ * \brief 24xx series I2C EEPROM API
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __EEPROM_H__
+#define __EEPROM_H__
+
+#include "i2c.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * EEPROM device. The geometry depends on the part, for example:
+ *  - 24C02: 256 bytes, 8 byte pages, 1 address byte
+ *  - 24C16: 2048 bytes, 16 byte pages, 1 address byte
+ *  - 24C256: 32768 bytes, 64 byte pages, 2 address bytes
+ * Parts with 1 address byte and more than 256 bytes select the 256 byte
+ * block with the low bits of the I2C address.
+ */
+struct eeprom
+{
+    struct i2c_device dev;  /* Base I2C address and bus rate */
+    uint32_t size;          /* Capacity in bytes, at most 64KB */
+    uint16_t page_size;     /* Page size in bytes, a power of 2 */
+    uint8_t addr_width;     /* Address width in bytes, 1 or 2 */
+};
+
+/* Maximum duration of the internal write cycle in us */
+#define EEPROM_WRITE_TIME_US    10000UL
+
+/**
+ * \brief Read from the EEPROM
+ * \param[in] eeprom - the EEPROM device
+ * \param[in] address - the address of the first byte
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the number of bytes to read
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The data is read sequentially in one transaction, or one per 256 byte
+ * block for parts with 1 address byte.
+ */
+int eeprom_read(const struct eeprom *eeprom, uint16_t address, void *buf, size_t len);
+
+/**
+ * \brief Write to the EEPROM
+ * \param[in] eeprom - the EEPROM device
+ * \param[in] address - the address of the first byte
+ * \param[in] buf - the data
+ * \param[in] len - the number of bytes to write
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The data is written one page at a time. After each page, the device is
+ * polled until it acknowledges its address again, so this returns as soon
+ * as the last write cycle has completed. A write cycle which takes longer
+ * than EEPROM_WRITE_TIME_US fails with I2C_ERR_TIMEOUT.
+ */
+int eeprom_write(const struct eeprom *eeprom, uint16_t address, const void *buf, size_t len);
+
+#endif /* __EEPROM_H__ */
@@ -0,0 +1,119 @@
+/**
+ * \file eeprom_cache.h
+ * \author Chris Karaplis
+ * \brief EEPROM page cache API
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __EEPROM_CACHE_H__
+#define __EEPROM_CACHE_H__
+
+#include "eeprom.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* Number of cached pages */
+#ifndef EEPROM_CACHE_LINES
+#define EEPROM_CACHE_LINES      4
+#endif
+
+/* Size of a cache line, the largest page size which can be cached */
+#ifndef EEPROM_CACHE_LINE_SIZE
+#define EEPROM_CACHE_LINE_SIZE  8
+#endif
+
+/* Time without writes after which eeprom_cache_poll() flushes the cache */
+#define EEPROM_CACHE_IDLE_MS    1000UL
+
+/* Cache line statistics */
+struct eeprom_cache_stats
+{
+    int valid;                  /* Non-zero if the line holds a page */
+    uint16_t page;              /* Address of the page held by the line */
+    unsigned int hits;          /* Accesses to the page held by the line */
+    unsigned int misses;        /* Pages loaded into the line */
+    unsigned int writebacks;    /* Page programs of the line */
+};
+
+/**
+ * \brief Initialize the cache
+ * \param[in] eeprom - the EEPROM device to cache
+ * \return 0 on success, -1 otherwise
+ *
+ * The page size of the EEPROM must not exceed EEPROM_CACHE_LINE_SIZE. Once
+ * the cache is in use, all accesses to the EEPROM must go through it.
+ */
+int eeprom_cache_init(const struct eeprom *eeprom);
+
+/**
+ * \brief Read through the cache
+ * \param[in] address - the address of the first byte
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the number of bytes to read
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ */
+int eeprom_cache_read(uint16_t address, void *buf, size_t len);
+
+/**
+ * \brief Write through the cache
+ * \param[in] address - the address of the first byte
+ * \param[in] buf - the data
+ * \param[in] len - the number of bytes to write
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The data is only written to the EEPROM when the page is evicted, the
+ * cache is flushed, or by eeprom_cache_poll() once the cache has been idle
+ * for EEPROM_CACHE_IDLE_MS. Writes to the same page are merged into a
+ * single page program.
+ */
+int eeprom_cache_write(uint16_t address, const void *buf, size_t len);
+
+/**
+ * \brief Write all modified pages to the EEPROM
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ */
+int eeprom_cache_flush(void);
+
+/**
+ * \brief Flush the cache if it has been idle
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * To be called periodically from the main loop.
+ */
+int eeprom_cache_poll(void);
+
+/**
+ * \brief Get the statistics of a cache line
+ * \param[in] line - the cache line, less than EEPROM_CACHE_LINES
+ * \param[out] stats - the statistics structure to fill
+ * \param[in] reset - non-zero to reset the counters once read
+ * \return 0 on success, -1 otherwise
+ */
+int eeprom_cache_stats(unsigned int line, struct eeprom_cache_stats *stats, int reset);
+
+#endif /* __EEPROM_CACHE_H__ */
@@ -36,10 +36,18 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/* I2C configuration */
+struct i2c_config
+{
+    uint32_t bus_hz;    /* Requested bus rate */
+    uint32_t actual_hz; /* Bus rate achieved, set by i2c_init() */
+};
+
 /* I2C slave device structure */
 struct i2c_device
 {
     uint8_t address;
+    uint32_t bus_hz;    /* Bus rate for this device, 0 for the rate set by i2c_init() */
 };
 
 /* I2C transaction data */
@@ -51,18 +59,187 @@ struct i2c_data
     size_t rx_len;
 };
 
+/* I2C message flags */
+#define I2C_MSG_READ    0x0001  /* Read into the buffer, otherwise write from it */
+#define I2C_MSG_NOSTOP  0x0002  /* Do not send a stop condition after the message */
+
+/**
+ * I2C message, one segment of a transfer. A message without I2C_MSG_NOSTOP
+ * ends with a stop condition. With I2C_MSG_NOSTOP, a following message in
+ * the same direction continues the data without a new start condition, and
+ * a following message in the other direction begins with a repeated start.
+ * Reads must be at least one byte and can only be continued by reads; a
+ * read followed by a write always ends with a stop condition.
+ */
+struct i2c_msg
+{
+    void *buf;
+    size_t len;
+    uint16_t flags;
+};
+
+/* I2C transfer errors, -1 is returned for invalid arguments */
+#define I2C_ERR_NACK_ADDR   -2  /* The slave did not acknowledge its address */
+#define I2C_ERR_NACK_DATA   -3  /* The slave did not acknowledge a data byte */
+#define I2C_ERR_TIMEOUT     -4  /* The transfer did not complete in time, the bus was recovered */
+#define I2C_ERR_ARB_LOST    -5  /* Another master won the bus */
+
+/**
+ * Default transfer timeout in ms. The timer module has a resolution of 100ms,
+ * so a transfer times out between (timeout - 100ms) and timeout after it
+ * starts. Shorter timeouts are raised to 200ms.
+ */
+#define I2C_TIMEOUT_MS  200
+
+/* Status of a job which has not completed yet */
+#define I2C_JOB_PENDING 1
+
+/**
+ * I2C job, a transfer executed by the driver from its job queue. The job,
+ * its messages and buffers must remain valid until status is no longer
+ * I2C_JOB_PENDING, after which it holds the result, 0 or a negative error.
+ */
+struct i2c_job
+{
+    const struct i2c_device *dev;
+    const struct i2c_msg *msgs;
+    size_t count;
+    uint16_t timeout_ms;    /* Transfer timeout, 0 for I2C_TIMEOUT_MS */
+    volatile int status;
+    uint32_t submitted;
+};
+
+/* I2C job queue statistics */
+struct i2c_stats
+{
+    unsigned int depth;         /* Jobs queued or in progress */
+    unsigned int peak;          /* Maximum depth */
+    unsigned int completed;     /* Jobs completed */
+    unsigned int errors;        /* Jobs completed with an error */
+    uint32_t latency_max_us;    /* Maximum time from submission to completion */
+    uint32_t latency_total_us;  /* Sum of the time from submission to completion */
+};
+
 /**
  * \brief Initialize the I2C peripheral
+ * \param[in/out] config - the I2C configuration
  * \return 0 on success, -1 otherwise
+ *
+ * The prescaler is computed from the current SMCLK frequency, rounded so
+ * the bus never runs faster than requested. The fastest rate is SMCLK / 4,
+ * 250kHz at 1MHz. On return, actual_hz is set to the rate achieved. Must be
+ * called again if SMCLK changes.
  */
-int i2c_init(void);
+int i2c_init(struct i2c_config *config);
 
 /**
  * \brief Perform an I2C transfer
  * \param[in] dev - the I2C slave device
  * \param[in/out] data - data structure containing the buffers
- * \return 0 on success, -1 otherwise
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The transfer is queued behind any submitted jobs and blocks until it
+ * completes, sleeping in LPM0. Must not be called with interrupts disabled
+ * or from interrupt context.
  */
 int i2c_transfer(const struct i2c_device *dev, struct i2c_data *data);
 
+/**
+ * \brief Start an I2C transfer
+ * \param[in] dev - the I2C slave device
+ * \param[in/out] data - data structure containing the buffers
+ * \param[in] callback - function called from interrupt context on completion
+ * \param[in] arg - callback function private data
+ * \return 0 if the transfer was started, -1 otherwise
+ *
+ * The data is transmitted first, followed by a repeated start and the
+ * reception of the data if there is any. The data structure and buffers
+ * must remain valid until the callback is invoked with the result, 0 on
+ * success or I2C_ERR_* on error. Only one transfer can be in progress at a time;
+ * the callback may start the next one. Fails while the bus is busy, with a
+ * transfer or a queued job; queued jobs wait for this transfer to complete.
+ */
+int i2c_transfer_async(const struct i2c_device *dev, struct i2c_data *data,
+                       void (*callback)(int err, void *arg), void *arg);
+
+/**
+ * \brief Perform an I2C transfer made of several messages
+ * \param[in] dev - the I2C slave device
+ * \param[in/out] msgs - array of messages
+ * \param[in] count - number of messages
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The transfer is queued behind any submitted jobs and blocks until it
+ * completes, sleeping in LPM0. Must not be called with interrupts disabled
+ * or from interrupt context.
+ */
+int i2c_transfer_msgs(const struct i2c_device *dev, const struct i2c_msg *msgs, size_t count);
+
+/**
+ * \brief Start an I2C transfer made of several messages
+ * \param[in] dev - the I2C slave device
+ * \param[in/out] msgs - array of messages
+ * \param[in] count - number of messages
+ * \param[in] callback - function called from interrupt context on completion
+ * \param[in] arg - callback function private data
+ * \return 0 if the transfer was started, -1 otherwise
+ *
+ * The messages and their buffers must remain valid until the callback is
+ * invoked with the result, 0 on success or I2C_ERR_* on error. The transfer
+ * times out after I2C_TIMEOUT_MS.
+ */
+int i2c_transfer_msgs_async(const struct i2c_device *dev, const struct i2c_msg *msgs, size_t count,
+                            void (*callback)(int err, void *arg), void *arg);
+
+/**
+ * \brief Submit a job to the queue
+ * \param[in/out] job - the job, status is set to I2C_JOB_PENDING
+ * \return 0 if the job was queued, -1 otherwise
+ *
+ * Queued jobs are executed back to back from interrupt context in the order
+ * they were submitted.
+ */
+int i2c_submit(struct i2c_job *job);
+
+/**
+ * \brief Wait for a job to complete
+ * \param[in] job - the job
+ * \return the status of the job, 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * Sleeps in LPM0 until the job completes. Must not be called with interrupts
+ * disabled or from interrupt context.
+ */
+int i2c_wait(struct i2c_job *job);
+
+/**
+ * \brief Get the job queue statistics
+ * \param[out] stats - the statistics
+ * \param[in] reset - non-zero to reset the statistics after reading
+ * \return 0 on success, -1 otherwise
+ */
+int i2c_get_stats(struct i2c_stats *stats, int reset);
+
+/**
+ * \brief Get the bus rate achieved for a device
+ * \param[in] dev - the I2C slave device, NULL for the rate set by i2c_init()
+ * \return the bus rate in Hz
+ */
+uint32_t i2c_bus_hz(const struct i2c_device *dev);
+
+/**
+ * \brief Recover the bus from a slave holding SDA low
+ * \return 0 if the bus is free afterwards, -1 otherwise
+ *
+ * Clocks SCL up to 9 times until SDA is released, sends a stop condition and
+ * resets USCI_B0. Fails while a transfer is in progress. Transfers which
+ * time out recover the bus by themselves.
+ */
+int i2c_recover(void);
+
+/**
+ * \brief Check whether an I2C transfer is in progress
+ * \return non-zero if a transfer is in progress, 0 otherwise
+ */
+int i2c_busy(void);
+
 #endif /* __I2C_H__ */ 
@@ -0,0 +1,105 @@
+/**
+ * \file kv.h
+ * \author Chris Karaplis
+ * \brief Log-structured key-value store API
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __KV_H__
+#define __KV_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* EEPROM region holding the store, the sectors follow each other */
+#ifndef KV_BASE
+#define KV_BASE         128
+#endif
+
+#ifndef KV_SECTOR_SIZE
+#define KV_SECTOR_SIZE  32
+#endif
+
+/* Number of sectors, at least 3 and at most 8 */
+#ifndef KV_SECTORS
+#define KV_SECTORS      4
+#endif
+
+/* Number of keys, keys range from 0 to KV_KEYS - 1 */
+#ifndef KV_KEYS
+#define KV_KEYS         4
+#endif
+
+/* Maximum length of a value */
+#ifndef KV_VALUE_MAX
+#define KV_VALUE_MAX    8
+#endif
+
+/**
+ * \brief Initialize the store
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * Scans the records to build the index. Must be called after the EEPROM
+ * cache has been initialized, since all accesses go through it.
+ */
+int kv_init(void);
+
+/**
+ * \brief Get the value of a key
+ * \param[in] key - the key
+ * \param[out] buf - the buffer to store the value
+ * \param[in] len - the size of the buffer
+ * \return the length of the value on success, -1 or I2C_ERR_* otherwise
+ *
+ * Fails if the key has no value or the value does not fit in the buffer.
+ */
+int kv_get(uint8_t key, void *buf, size_t len);
+
+/**
+ * \brief Set the value of a key
+ * \param[in] key - the key
+ * \param[in] value - the value
+ * \param[in] len - the length of the value, at most KV_VALUE_MAX
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The record is appended to the log through the EEPROM cache, so it only
+ * reaches the EEPROM once the cache is flushed. Fails if the values would
+ * no longer fit after compaction.
+ */
+int kv_set(uint8_t key, const void *value, size_t len);
+
+/**
+ * \brief Compact the store in the background
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * To be called periodically from the main loop. Once less than two sectors
+ * are free, the oldest sector is compacted, one sector per call.
+ */
+int kv_poll(void);
+
+#endif /* __KV_H__ */
@@ -0,0 +1,85 @@
+/**
+ * \file proto.h
+ * \author Chris Karaplis
+ * \brief Binary command protocol API
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PROTO_H__
+#define __PROTO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Maximum size of a request or response payload. It sizes the frame buffer
+ * on the stack of proto_run(). The firmware is built with 16, so its EEPROM
+ * read command returns at most 16 bytes, and its write command carries the
+ * address and at most 15 bytes of data.
+ */
+#ifndef PROTO_MAX_PAYLOAD
+#define PROTO_MAX_PAYLOAD       32
+#endif
+
+/* Command which leaves binary mode */
+#define PROTO_CMD_EXIT          0x7F
+
+/* Response status codes */
+#define PROTO_STATUS_OK         0x00
+#define PROTO_STATUS_ERROR      0x01
+#define PROTO_STATUS_UNKNOWN    0x02
+
+/* A protocol command structure */
+struct proto_cmd
+{
+    uint8_t id;
+    int (*handler)(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+};
+
+/**
+ * \brief Run the binary protocol until the exit command is received
+ * \param[in] cmds - array of commands
+ * \param[in] count - number of commands
+ *
+ * Each packet is COBS encoded and terminated by a zero byte. A request
+ * contains the command ID, a sequence number, the payload and a CRC-16
+ * (CCITT, initial value 0xFFFF) of the preceding bytes, sent MSB first.
+ * The response contains the command ID with bit 7 set, the same sequence
+ * number, a status code, the payload and the CRC-16. Either payload is at
+ * most PROTO_MAX_PAYLOAD bytes, longer requests are discarded.
+ *
+ * Handlers are invoked with the request payload and must store at most
+ * PROTO_MAX_PAYLOAD bytes in rsp, setting rsp_len to the number stored.
+ * The response is built in the request buffer, so rsp and req point to
+ * the same bytes and a handler must read what it needs from the request
+ * before writing the response. They return 0 on success, -1 otherwise. Packets with an invalid
+ * encoding or CRC are discarded.
+ */
+void proto_run(const struct proto_cmd *cmds, size_t count);
+
+#endif /* __PROTO_H__ */
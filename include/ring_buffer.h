@@ -36,16 +36,109 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/* Maximum number of ring buffers which can be initialized at once */
+#ifndef RING_BUFFER_MAX
+#define RING_BUFFER_MAX         4
+#endif
+
+/* Size in bytes of the arena backing ring buffers which provide no memory */
+#ifndef RING_BUFFER_ARENA_SIZE
+#define RING_BUFFER_ARENA_SIZE  64
+#endif
+
+/**
+ * Native multicore builds (e.g. host side tools) should define RING_BUFFER_ATOMIC
+ * and build with C11, which makes the head and tail indices atomic with
+ * acquire/release ordering. RB_OVERWRITE_OLDEST is not supported in this mode.
+ */
+
+/**
+ * \brief Define a statically sized ring buffer of a given element type
+ * \param name - the name of the ring buffer
+ * \param type - the element type
+ * \param N - the number of elements, must be a power of 2
+ *
+ * Generates static storage for the ring buffer along with the functions
+ * name_put(), name_get() and name_count(). Since the size and element type
+ * are known at compile time, indexing is a constant mask and elements are
+ * copied by assignment, so no descriptor lookup, multiply or memcpy() is
+ * required. Compilation fails if N is not a power of 2.
+ *
+ * This is meant for fast paths such as an ISR with a single producer and a
+ * single consumer. It is independent of the descriptor API below, which
+ * takes the element size and count at run time and adds overflow policies,
+ * bulk and zero-copy access and statistics.
+ */
+#define RING_BUFFER_DEFINE(name, type, N)                                      \
+    typedef char name##_size_not_power_of_2[                                   \
+        (((N) > 0) && (((N) & ((N) - 1)) == 0)) ? 1 : -1];                     \
+                                                                               \
+    static struct {                                                            \
+        type buf[N];                                                           \
+        volatile size_t head;                                                  \
+        volatile size_t tail;                                                  \
+    } name;                                                                    \
+                                                                               \
+    static inline int name##_put(type data)                                    \
+    {                                                                          \
+        int err = -1;                                                          \
+                                                                               \
+        if ((name.head - name.tail) != (N)) {                                  \
+            name.buf[name.head & ((N) - 1)] = data;                            \
+            name.head++;                                                       \
+            err = 0;                                                           \
+        }                                                                      \
+                                                                               \
+        return err;                                                            \
+    }                                                                          \
+                                                                               \
+    static inline int name##_get(type *data)                                   \
+    {                                                                          \
+        int err = -1;                                                          \
+                                                                               \
+        if (name.head != name.tail) {                                          \
+            *data = name.buf[name.tail & ((N) - 1)];                           \
+            name.tail++;                                                       \
+            err = 0;                                                           \
+        }                                                                      \
+                                                                               \
+        return err;                                                            \
+    }                                                                          \
+                                                                               \
+    static inline size_t name##_count(void)                                    \
+    {                                                                          \
+        return (name.head - name.tail);                                        \
+    }
+
 /* Ring buffer descriptor */
 typedef unsigned int rbd_t;
 
+/* Ring buffer overflow policy */
+typedef enum {
+    RB_DROP_NEWEST = 0,
+    RB_OVERWRITE_OLDEST
+} rb_policy_t;
+
 /* User defined ring buffer attributes */
 typedef struct {
     size_t s_elem;
     size_t n_elem;
     void *buffer;
+    rb_policy_t policy;
+    size_t high_water;
+    void (*callback)(void *);
+    void *arg;
 } rb_attr_t;
 
+/* Ring buffer usage statistics */
+typedef struct {
+    size_t size;
+    size_t peak;
+    unsigned int puts;
+    unsigned int gets;
+    unsigned int drops;
+} rb_stats_t;
+
 /**
  * \brief Initialize a ring buffer
  * \param[out] rb - pointer to a ring buffer descriptor
@@ -54,10 +147,33 @@ typedef struct {
  *
  * The attributes must contain a ring buffer which is sized
  * to an even power of 2. This should be reflected by the
- * attribute n_elem.
+ * attribute n_elem. If the buffer is NULL, the memory is
+ * allocated from the ring buffer arena.
+ *
+ * The policy selects what ring_buffer_put and ring_buffer_write do when
+ * the ring buffer is full: RB_DROP_NEWEST rejects the new elements,
+ * RB_OVERWRITE_OLDEST discards the oldest ones. If a callback is provided, it is invoked
+ * with arg from the producer's context each time the number of elements
+ * rises to high_water.
  */
 int ring_buffer_init(rbd_t *rbd, rb_attr_t *attr);
 
+/**
+ * \brief Deinitialize a ring buffer and release the descriptor
+ * \param[in] rbd - the ring buffer descriptor
+ * \return 0 on success, -1 otherwise
+ *
+ * Memory allocated from the arena is returned only if it is the most
+ * recent allocation, otherwise it remains committed.
+ */
+int ring_buffer_deinit(rbd_t rbd);
+
+/**
+ * \brief Get the number of bytes committed from the ring buffer arena
+ * \return the number of bytes in use, including alignment padding
+ */
+size_t ring_buffer_arena_used(void);
+
 /**
  * \brief Add an element to the ring buffer
  * \param[in] rb - the ring buffer descriptor
@@ -74,4 +190,102 @@ int ring_buffer_put(rbd_t rbd, const void *data);
  */
 int ring_buffer_get(rbd_t rbd, void *data);
 
+/**
+ * \brief Add multiple elements to the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[in] data - the elements to add
+ * \param[in] count - the number of elements to add
+ * \return the number of elements added
+ *
+ * With RB_DROP_NEWEST, only as many elements as there is space for are
+ * added, which may be fewer than count if the ring buffer fills up. With
+ * RB_OVERWRITE_OLDEST, all the elements are added and the oldest ones are
+ * discarded to make room, so only the last n_elem of data are kept if count
+ * is larger than the ring buffer.
+ */
+size_t ring_buffer_write(rbd_t rbd, const void *data, size_t count);
+
+/**
+ * \brief Get (and remove) multiple elements from the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] data - pointer to store the elements
+ * \param[in] count - the maximum number of elements to get
+ * \return the number of elements read
+ */
+size_t ring_buffer_read(rbd_t rbd, void *data, size_t count);
+
+/**
+ * \brief Get the number of elements in the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \return the number of elements available to read
+ */
+size_t ring_buffer_count(rbd_t rbd);
+
+/**
+ * \brief Get the free space in the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \return the number of elements which can be added
+ */
+size_t ring_buffer_space(rbd_t rbd);
+
+/**
+ * \brief Reserve contiguous space in the ring buffer for writing in place
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] data - pointer to the start of the reserved space
+ * \param[in] count - the maximum number of elements to reserve
+ * \return the number of contiguous elements reserved
+ *
+ * The reservation stops at the end of the buffer memory, so a second
+ * reserve may be needed after a commit to use the space at the start.
+ * Nothing is visible to the consumer until ring_buffer_commit is called.
+ * Not supported with RB_OVERWRITE_OLDEST, where nothing is reserved, since
+ * the elements cannot be written in place and discarded atomically.
+ */
+size_t ring_buffer_reserve(rbd_t rbd, void **data, size_t count);
+
+/**
+ * \brief Commit elements written in place to the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[in] count - the number of elements to commit
+ * \return 0 on success, -1 otherwise
+ *
+ * Fails if count exceeds the free space, and always with RB_OVERWRITE_OLDEST.
+ */
+int ring_buffer_commit(rbd_t rbd, size_t count);
+
+/**
+ * \brief Peek at the contiguous elements at the front of the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] data - pointer to the first element
+ * \return the number of contiguous elements which can be read in place
+ *
+ * The span stops at the end of the buffer memory. The elements remain
+ * in the ring buffer until ring_buffer_consume is called. This should
+ * not be used with RB_OVERWRITE_OLDEST since the producer may overwrite
+ * the elements being read in place.
+ */
+size_t ring_buffer_peek(rbd_t rbd, void **data);
+
+/**
+ * \brief Remove elements from the front of the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[in] count - the number of elements to remove
+ * \return 0 on success, -1 otherwise
+ */
+int ring_buffer_consume(rbd_t rbd, size_t count);
+
+/**
+ * \brief Get the usage statistics of a ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] stats - the statistics structure to fill
+ * \param[in] reset - non-zero to reset the statistics once read
+ * \return 0 on success, -1 otherwise
+ *
+ * The counters are the number of elements added (puts), removed (gets)
+ * and discarded due to overflow (drops) and wrap around if not reset.
+ * The peak is the highest number of elements held at once. On reset,
+ * the counters are cleared and the peak is set to the current count.
+ */
+int ring_buffer_stats(rbd_t rbd, rb_stats_t *stats, int reset);
+
 #endif /* __RING_BUFFER_H__ */
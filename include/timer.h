@@ -72,5 +72,15 @@ int timer_delete(int handle);
  */
 int timer_capture(struct time *time);
 
+/**
+ * \brief Get a microsecond timestamp
+ * \return the time since the timer module was initialized in us
+ *
+ * The resolution is 2us. The timestamp is a free running 32-bit count, so
+ * it wraps every 2^32us (about 71 minutes). The difference of two unsigned
+ * timestamps is valid across the wrap, for intervals shorter than that.
+ */
+uint32_t timer_timestamp_us(void);
+
 #endif /* __TIMER__ */
 
@@ -30,36 +30,184 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "ring_buffer.h"
 #include <stdint.h>
+#include <stddef.h>
+
+/* Maximum length of a received line, excluding the terminator */
+#define UART_LINE_MAX   16
+
+/* Baud rate which requests automatic detection in uart_init() */
+#define UART_BAUD_AUTO  0
+
+/* Flow control */
+typedef enum
+{
+    UART_FLOW_NONE = 0,
+    UART_FLOW_XONXOFF,  /* Software flow control, not for binary data */
+    UART_FLOW_RTSCTS    /* Hardware flow control, RTS on P2.0 and CTS on P2.1 */
+} uart_flow_t;
 
 typedef struct
 {
     uint32_t baud;
+    uart_flow_t flow;
+    int error;
 } uart_config_t;
 
+/* Receive modes */
+typedef enum
+{
+    UART_MODE_RAW = 0,  /* Bytes are received as is */
+    UART_MODE_LINE      /* Lines are assembled and echoed by the driver */
+} uart_mode_t;
+
 /**
  * \brief Initialize the UART peripheral
- * \param[in] config - the UART configuration
+ * \param[in/out] config - the UART configuration
  * \return 0 on success, -1 otherwise
+ *
+ * The baud rate registers are computed from the current SMCLK frequency.
+ * On return, error is set to the resulting baud rate error in tenths of a
+ * percent. Baud rates with an error of more than 2% are rejected.
+ *
+ * With flow control enabled, the host is stopped when the receive buffer
+ * fills up past a high water mark and resumed once it has been read down to
+ * a low water mark. Transmission pauses while the host requests it.
+ *
+ * If baud is UART_BAUD_AUTO, this blocks until the host sends a 'U' (0x55)
+ * and the measured baud rate, rounded to the nearest standard rate, is
+ * stored in baud. The lowest rate which can be detected is 1200 baud. The
+ * highest depends on SMCLK, about 38400 baud at 1MHz.
  */
 int uart_init(uart_config_t *config);
 
+/**
+ * \brief Set the receive mode
+ * \param[in] mode - the receive mode
+ *
+ * Any received data which has not been read yet is discarded. The driver
+ * starts in raw mode.
+ */
+void uart_set_mode(uart_mode_t mode);
+
 /**
  * \brief Read a character from UART
  * \return the character read on success, -1 if nothing was read
+ *
+ * The character is returned as an unsigned char converted to an int. In
+ * line mode, only characters of complete lines are returned and each
+ * line ends with a line-feed.
  */
 int uart_getchar(void);
 
+/**
+ * \brief Read a complete line from UART
+ * \param[out] buf - the buffer to store the line
+ * \param[in] len - the size of the buffer
+ * \return the length of the line on success, -1 if no line is ready
+ *
+ * Only valid in line mode. The line is NULL terminated and the terminator
+ * is removed. Characters which do not fit in the buffer are discarded.
+ */
+int uart_getline(char *buf, size_t len);
+
+/**
+ * \brief Get the number of complete lines waiting to be read
+ * \return the number of lines
+ */
+unsigned int uart_line_ready(void);
+
+/**
+ * \brief Sleep until a line is ready or another interrupt wakes the CPU
+ *
+ * Returns immediately if a line is already waiting. The CPU waits in LPM0,
+ * so the caller must check for its own events again on return.
+ */
+void uart_wait_line(void);
+
 /**
  * \brief Write a character to UART
  * \param[in] c - the character to write
  * \return 0 on sucess, -1 otherwise
+ *
+ * The character is queued for transmission. This only blocks if the
+ * transmit buffer is full, and gives up like uart_write_all().
  */
 int uart_putchar(int c);
 
 /**
  * \brief Write a string to UART
- * \return 0 on sucesss, -1 otherwise
+ * \return the number of bytes queued on success, -1 otherwise
+ *
+ * Line-feeds are followed by a carriage return. The string is queued for
+ * transmission, blocking only while the transmit buffer is full, and gives
+ * up like uart_write_all().
  */
 int uart_puts(const char *str);
 
+/**
+ * \brief Write a block of data to UART
+ * \param[in] buf - the data to write
+ * \param[in] len - the number of bytes to write
+ * \return the number of bytes queued on success, -1 otherwise
+ *
+ * Never blocks. Only as much data as fits in the transmit buffer is queued,
+ * which may be less than len or even nothing, and the caller retries with
+ * the remainder. Use uart_write_all() to wait for room instead.
+ */
+int uart_write(const void *buf, size_t len);
+
+/**
+ * \brief Write a block of data to UART, waiting for room as needed
+ * \param[in] buf - the data to write
+ * \param[in] len - the number of bytes to write
+ * \return the number of bytes queued on success, -1 otherwise
+ *
+ * While the transmit buffer is full, the CPU sleeps in LPM0 until the TX
+ * interrupt makes room, and the watchdog is pet on each wake up. Gives up
+ * once nothing has been sent for 500ms, for instance while the host holds
+ * off transmission with XOFF or CTS, and returns the number of bytes queued
+ * so far.
+ */
+int uart_write_all(const void *buf, size_t len);
+
+/**
+ * \brief Read a block of data from UART
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the maximum number of bytes to read
+ * \param[in] timeout_ms - the time to wait for data in ms, 0 to not wait
+ * \param[in] delim - the character to stop at, or -1 for none
+ * \return the number of bytes read on success, -1 otherwise
+ *
+ * Returns when len bytes have been read, the delimiter has been read (it is
+ * stored in the buffer) or the timeout expires. While waiting, the CPU
+ * sleeps in LPM0 until data arrives or the next timer tick, and the watchdog
+ * is pet on each wake up. The timeout needs no timer and may run over by up
+ * to a tick (100ms). In line mode, only characters of complete lines are
+ * read, as with uart_getchar(), and reading a line-feed consumes the line.
+ */
+int uart_read(void *buf, size_t len, uint16_t timeout_ms, int delim);
+
+/**
+ * \brief Wait for all queued data to be transmitted
+ * \return 0 on success, -1 if transmission stalled
+ *
+ * Gives up once nothing has been sent for 500ms, for instance while the
+ * host holds off transmission with XOFF or CTS. The watchdog is pet while
+ * waiting.
+ */
+int uart_flush(void);
+
+/**
+ * \brief Get the usage statistics of the receive buffer
+ * \param[out] stats - the statistics structure to fill
+ * \param[in] reset - non-zero to reset the statistics once read
+ * \return 0 on success, -1 otherwise
+ *
+ * The receive buffer is not allocated from the ring buffer pool, so it is
+ * not reported by ring_buffer_stats(). Drops are the bytes received while
+ * the buffer was full, including complete lines which did not fit.
+ */
+int uart_rx_stats(rb_stats_t *stats, int reset);
+
@@ -0,0 +1,68 @@
+/**
+ * \file usci.h
+ * \author Chris Karaplis
+ * \brief USCI interrupt dispatch API
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __USCI_H__
+#define __USCI_H__
+
+/**
+ * USCI_A0 (UART) and USCI_B0 (I2C) share the USCIAB0TX and USCIAB0RX
+ * interrupt vectors, which are owned by usci.c. Each driver provides a
+ * handler per vector which checks its own flags and returns non-zero to
+ * wake the main loop from low power mode.
+ */
+
+/**
+ * \brief UART transmit interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int uart_tx_isr(void);
+
+/**
+ * \brief UART receive interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int uart_rx_isr(void);
+
+/**
+ * \brief I2C data (transmit and receive) interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int i2c_data_isr(void);
+
+/**
+ * \brief I2C state (NACK) interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int i2c_state_isr(void);
+
+#endif /* __USCI_H__ */
@@ -38,6 +38,24 @@
 #include "i2c.h"
 #include <msp430.h>
 
+/* Frequency the DCO is calibrated to */
+#define BOARD_DCO_HZ    1000000UL
+
+/* UART baud rate, UART_BAUD_AUTO to detect it from a 'U' sent by the host */
+#ifndef BOARD_UART_BAUD
+#define BOARD_UART_BAUD 9600
+#endif
+
+/* UART flow control, UART_FLOW_NONE, UART_FLOW_XONXOFF or UART_FLOW_RTSCTS */
+#ifndef BOARD_UART_FLOW
+#define BOARD_UART_FLOW UART_FLOW_NONE
+#endif
+
+/* Default I2C bus rate, devices may select their own */
+#ifndef BOARD_I2C_BUS_HZ
+#define BOARD_I2C_BUS_HZ    100000
+#endif
+
 /**
  * \brief Initialize all board dependant functionality
  * \return 0 on success, -1 otherwise
@@ -45,6 +63,7 @@
 int board_init(void)
 {
     uart_config_t config;
+    struct i2c_config i2c_config;
 
     watchdog_disable();
 
@@ -103,17 +122,30 @@ int board_init(void)
  
     watchdog_enable();
     
-    /* Initialize UART to 9600 baud */
-    config.baud = 9600;
+    /* Initialize UART to the configured baud rate */
+    config.baud = BOARD_UART_BAUD;
+    config.flow = BOARD_UART_FLOW;
 
     if (uart_init(&config) != 0) {
         while (1);
     }
 
-    if (i2c_init() != 0) {
+    /* Initialize I2C to the default bus rate */
+    i2c_config.bus_hz = BOARD_I2C_BUS_HZ;
+
+    if (i2c_init(&i2c_config) != 0) {
         while (1);
     }
 
     return 0;
 }
 
+/**
+ * \brief Get the current SMCLK frequency
+ * \return the SMCLK frequency in Hz
+ */
+uint32_t board_get_smclk(void)
+{
+    /* SMCLK is sourced from the DCO and divided by 1, 2, 4 or 8 */
+    return BOARD_DCO_HZ >> ((BCSCTL2 & DIVS_3) >> 1);
+}
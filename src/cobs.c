@@ -0,0 +1,108 @@
+/**
+ * \file cobs.c
+ * \author Chris Karaplis
+ * \brief Consistent Overhead Byte Stuffing implementation
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cobs.h"
+#include <stdint.h>
+
+/**
+ * \brief Encode a block of data
+ * \param[in] src - the data to encode
+ * \param[in] len - the number of bytes to encode
+ * \param[out] dst - the buffer to store the encoded data, at least COBS_ENCODED_MAX(len) bytes
+ * \return the number of encoded bytes
+ */
+size_t cobs_encode(const void *src, size_t len, void *dst)
+{
+    const uint8_t *in = src;
+    uint8_t *out = dst;
+    uint8_t *code = out++;
+
+    *code = 1;
+
+    while (len-- > 0) {
+        if (*in == 0) {
+            /* A zero ends the current block */
+            code = out++;
+            *code = 1;
+        } else {
+            *out++ = *in;
+            (*code)++;
+
+            /* A block holds at most 254 non-zero bytes, without an implied zero */
+            if ((*code == 0xFF) && (len > 0)) {
+                code = out++;
+                *code = 1;
+            }
+        }
+
+        in++;
+    }
+
+    return (size_t) (out - (uint8_t *) dst);
+}
+
+/**
+ * \brief Decode a block of data
+ * \param[in] src - the encoded data, without the frame delimiter
+ * \param[in] len - the number of encoded bytes
+ * \param[out] dst - the buffer to store the decoded data, at least len bytes
+ * \return the number of decoded bytes on success, -1 if the data is invalid
+ */
+int cobs_decode(const void *src, size_t len, void *dst)
+{
+    const uint8_t *in = src;
+    const uint8_t *end = in + len;
+    uint8_t *out = dst;
+    int err = 0;
+
+    while ((in < end) && (err == 0)) {
+        const uint8_t code = *in++;
+
+        if ((code == 0) || ((size_t) (end - in) < (size_t) (code - 1))) {
+            /* Zero bytes and truncated blocks are not valid */
+            err = -1;
+        } else {
+            uint8_t i;
+
+            for (i = 1; i < code; i++) {
+                *out++ = *in++;
+            }
+
+            /* Every block except a full one or the last is followed by a zero */
+            if ((code != 0xFF) && (in < end)) {
+                *out++ = 0;
+            }
+        }
+    }
+
+    return (err == 0) ? (int) (out - (uint8_t *) dst) : -1;
+}
@@ -0,0 +1,215 @@
+/**
+ * \file eeprom.c
+ * \author Chris Karaplis
+ * \brief 24xx series I2C EEPROM driver
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "eeprom.h"
+
+/* Size of the block selected by the I2C address for parts with 1 address byte */
+#define EEPROM_BLOCK_SIZE   256
+
+/* Bus clocks of a poll at least: start, address, acknowledge and stop */
+#define EEPROM_POLL_CLOCKS  10
+
+static int _check(const struct eeprom *eeprom, uint16_t address, const void *buf, size_t len);
+static void _setup(const struct eeprom *eeprom, uint16_t address, struct i2c_device *dev,
+                   struct i2c_msg *msg, uint8_t *addr);
+static int _wait_ready(const struct i2c_device *dev, struct i2c_msg *msg);
+
+/**
+ * \brief Read from the EEPROM
+ * \param[in] eeprom - the EEPROM device
+ * \param[in] address - the address of the first byte
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the number of bytes to read
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The address is written followed by a repeated start, after which the
+ * device sends the data from consecutive addresses until the stop.
+ */
+int eeprom_read(const struct eeprom *eeprom, uint16_t address, void *buf, size_t len)
+{
+    uint8_t *ptr = buf;
+    int err;
+
+    err = _check(eeprom, address, buf, len);
+
+    while ((err == 0) && (len > 0)) {
+        struct i2c_device dev;
+        struct i2c_msg msgs[2];
+        uint8_t addr[2];
+        const size_t block_left = EEPROM_BLOCK_SIZE - (size_t) (address & 0xFF);
+        size_t count = len;
+
+        /* The block cannot change within a transaction */
+        if ((eeprom->addr_width == 1) && (count > block_left)) {
+            count = block_left;
+        }
+
+        _setup(eeprom, address, &dev, &msgs[0], addr);
+
+        msgs[1].buf = ptr;
+        msgs[1].len = count;
+        msgs[1].flags = I2C_MSG_READ;
+
+        err = i2c_transfer_msgs(&dev, msgs, 2);
+
+        address += count;
+        ptr += count;
+        len -= count;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Write to the EEPROM
+ * \param[in] eeprom - the EEPROM device
+ * \param[in] address - the address of the first byte
+ * \param[in] buf - the data
+ * \param[in] len - the number of bytes to write
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The address wraps around within a page, so a write never crosses a page
+ * boundary. The data is sent straight from the buffer.
+ */
+int eeprom_write(const struct eeprom *eeprom, uint16_t address, const void *buf, size_t len)
+{
+    const uint8_t *ptr = buf;
+    int err;
+
+    err = _check(eeprom, address, buf, len);
+
+    while ((err == 0) && (len > 0)) {
+        struct i2c_device dev;
+        struct i2c_msg msgs[2];
+        uint8_t addr[2];
+        size_t count = eeprom->page_size - (address & (eeprom->page_size - 1));
+
+        if (count > len) {
+            count = len;
+        }
+
+        _setup(eeprom, address, &dev, &msgs[0], addr);
+
+        /* The data continues the address message without a repeated start */
+        msgs[1].buf = (void *) ptr;
+        msgs[1].len = count;
+        msgs[1].flags = 0;
+
+        err = i2c_transfer_msgs(&dev, msgs, 2);
+
+        if (err == 0) {
+            err = _wait_ready(&dev, &msgs[1]);
+        }
+
+        address += count;
+        ptr += count;
+        len -= count;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Validate the arguments of a read or write
+ * \param[in] eeprom - the EEPROM device
+ * \param[in] address - the address of the first byte
+ * \param[in] buf - the buffer
+ * \param[in] len - the number of bytes
+ * \return 0 if valid, -1 otherwise
+ */
+static int _check(const struct eeprom *eeprom, uint16_t address, const void *buf, size_t len)
+{
+    int err = -1;
+
+    if ((eeprom != NULL) && (buf != NULL) &&
+        ((eeprom->addr_width == 1) || (eeprom->addr_width == 2)) &&
+        (eeprom->page_size > 0) && ((eeprom->page_size & (eeprom->page_size - 1)) == 0) &&
+        (((uint32_t) address + len) <= eeprom->size)) {
+        err = 0;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Set up the device and the address message of a transaction
+ * \param[in] eeprom - the EEPROM device
+ * \param[in] address - the memory address
+ * \param[out] dev - the I2C device to address
+ * \param[out] msg - the address message, joined to the next message
+ * \param[out] addr - buffer of at least 2 bytes for the address message
+ */
+static void _setup(const struct eeprom *eeprom, uint16_t address, struct i2c_device *dev,
+                   struct i2c_msg *msg, uint8_t *addr)
+{
+    *dev = eeprom->dev;
+    msg->buf = addr;
+    msg->len = 0;
+    msg->flags = I2C_MSG_NOSTOP;
+
+    if (eeprom->addr_width == 2) {
+        addr[msg->len++] = address >> 8;
+    } else {
+        /* The upper address bits select the block */
+        dev->address |= (address >> 8) & 0x07;
+    }
+
+    addr[msg->len++] = address & 0xFF;
+}
+
+/**
+ * \brief Wait for the internal write cycle to complete
+ * \param[in] dev - the I2C device which was written
+ * \param[out] msg - a message of the write which has completed, reused for polling
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The device does not acknowledge its address during the write cycle, so
+ * it is polled with transactions which only address it. Each poll takes at
+ * least EEPROM_POLL_CLOCKS bus clocks, so the number of polls is bounded
+ * such that they span at least EEPROM_WRITE_TIME_US at the device's rate.
+ * The bound depends neither on the timestamp nor on a free timer.
+ */
+static int _wait_ready(const struct i2c_device *dev, struct i2c_msg *msg)
+{
+    uint16_t polls = (uint16_t) ((((EEPROM_WRITE_TIME_US / 1000) * (i2c_bus_hz(dev) / 1000)) / EEPROM_POLL_CLOCKS) + 1);
+    int err;
+
+    msg->buf = NULL;
+    msg->len = 0;
+    msg->flags = 0;
+
+    do {
+        err = i2c_transfer_msgs(dev, msg, 1);
+    } while ((err == I2C_ERR_NACK_ADDR) && (--polls > 0));
+
+    return (err == I2C_ERR_NACK_ADDR) ? I2C_ERR_TIMEOUT : err;
+}
@@ -0,0 +1,357 @@
+/**
+ * \file eeprom_cache.c
+ * \author Chris Karaplis
+ * \brief EEPROM page cache with LRU eviction and write-back
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "eeprom_cache.h"
+#include "timer.h"
+#include <string.h>
+
+/* Cache line state */
+#define LINE_VALID  0x01
+#define LINE_DIRTY  0x02
+
+/* Cache line holding one page, 20 bytes with the default line size */
+struct cache_line
+{
+    uint16_t page;
+    uint16_t used;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int writebacks;
+    uint8_t flags;
+    uint8_t data[EEPROM_CACHE_LINE_SIZE];
+};
+
+static const struct eeprom *_eeprom = NULL;
+static struct cache_line _lines[EEPROM_CACHE_LINES];
+
+/* Access counter, the least recently used line has the oldest stamp */
+static uint16_t _stamp = 0;
+
+/* Whether any line is dirty and when the cache was last written */
+static int _dirty = 0;
+static uint32_t _written = 0;
+
+static int _line_get(uint16_t page, int fill, struct cache_line **line);
+static struct cache_line *_line_find(uint16_t page) __attribute__((noinline));
+static int _line_evict(struct cache_line *line);
+static int _writeback(struct cache_line *line);
+
+/**
+ * \brief Initialize the cache
+ * \param[in] eeprom - the EEPROM device to cache
+ * \return 0 on success, -1 otherwise
+ */
+int eeprom_cache_init(const struct eeprom *eeprom)
+{
+    int err = -1;
+
+    if ((eeprom != NULL) && (eeprom->page_size > 0) && (eeprom->page_size <= EEPROM_CACHE_LINE_SIZE) &&
+        ((eeprom->page_size & (eeprom->page_size - 1)) == 0)) {
+        memset(_lines, 0, sizeof(_lines));
+        _eeprom = eeprom;
+        _dirty = 0;
+        err = 0;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Read through the cache
+ * \param[in] address - the address of the first byte
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the number of bytes to read
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ */
+int eeprom_cache_read(uint16_t address, void *buf, size_t len)
+{
+    uint8_t *ptr = buf;
+    int err = -1;
+
+    if ((_eeprom != NULL) && (buf != NULL) && (((uint32_t) address + len) <= _eeprom->size)) {
+        err = 0;
+
+        while ((err == 0) && (len > 0)) {
+            const uint16_t offset = address & (_eeprom->page_size - 1);
+            size_t count = _eeprom->page_size - offset;
+            struct cache_line *line;
+
+            if (count > len) {
+                count = len;
+            }
+
+            err = _line_get(address - offset, 1, &line);
+
+            if (err == 0) {
+                memcpy(ptr, &line->data[offset], count);
+
+                address += count;
+                ptr += count;
+                len -= count;
+            }
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Write through the cache
+ * \param[in] address - the address of the first byte
+ * \param[in] buf - the data
+ * \param[in] len - the number of bytes to write
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * Pages which are only partially written are read into the cache first,
+ * so the page program rewrites the rest of the page unchanged.
+ */
+int eeprom_cache_write(uint16_t address, const void *buf, size_t len)
+{
+    const uint8_t *ptr = buf;
+    int err = -1;
+
+    if ((_eeprom != NULL) && (buf != NULL) && (((uint32_t) address + len) <= _eeprom->size)) {
+        err = 0;
+
+        while ((err == 0) && (len > 0)) {
+            const uint16_t offset = address & (_eeprom->page_size - 1);
+            size_t count = _eeprom->page_size - offset;
+            struct cache_line *line;
+
+            if (count > len) {
+                count = len;
+            }
+
+            err = _line_get(address - offset, (count < _eeprom->page_size), &line);
+
+            if (err == 0) {
+                memcpy(&line->data[offset], ptr, count);
+                line->flags |= LINE_DIRTY;
+
+                _dirty = 1;
+                _written = timer_timestamp_us();
+
+                address += count;
+                ptr += count;
+                len -= count;
+            }
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Write all modified pages to the EEPROM
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * Pages which fail to be written remain dirty.
+ */
+int eeprom_cache_flush(void)
+{
+    int err = 0;
+    size_t i;
+
+    for (i = 0; i < EEPROM_CACHE_LINES; i++) {
+        const int line_err = _writeback(&_lines[i]);
+
+        /* Keep going with the other lines, but report the first error */
+        if (err == 0) {
+            err = line_err;
+        }
+    }
+
+    _dirty = (err != 0) ? 1 : 0;
+
+    return err;
+}
+
+/**
+ * \brief Flush the cache if it has been idle
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ */
+int eeprom_cache_poll(void)
+{
+    int err = 0;
+
+    if ((_dirty != 0) && ((timer_timestamp_us() - _written) >= (EEPROM_CACHE_IDLE_MS * 1000))) {
+        err = eeprom_cache_flush();
+
+        if (err != 0) {
+            /* Try again after the next idle period */
+            _written = timer_timestamp_us();
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Get the statistics of a cache line
+ * \param[in] line - the cache line, less than EEPROM_CACHE_LINES
+ * \param[out] stats - the statistics structure to fill
+ * \param[in] reset - non-zero to reset the counters once read
+ * \return 0 on success, -1 otherwise
+ */
+int eeprom_cache_stats(unsigned int line, struct eeprom_cache_stats *stats, int reset)
+{
+    int err = -1;
+
+    if ((line < EEPROM_CACHE_LINES) && (stats != NULL)) {
+        struct cache_line *l = &_lines[line];
+
+        stats->valid = l->flags & LINE_VALID;
+        stats->page = l->page;
+        stats->hits = l->hits;
+        stats->misses = l->misses;
+        stats->writebacks = l->writebacks;
+
+        if (reset != 0) {
+            l->hits = 0;
+            l->misses = 0;
+            l->writebacks = 0;
+        }
+
+        err = 0;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Get the cache line holding a page
+ * \param[in] page - the address of the page
+ * \param[in] fill - non-zero to read the page on a miss, 0 if the caller
+ *                   overwrites the whole page
+ * \param[out] line - the cache line
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * On a miss, the least recently used line is evicted.
+ */
+static int _line_get(uint16_t page, int fill, struct cache_line **line)
+{
+    struct cache_line *l = _line_find(page);
+    int err = 0;
+
+    if ((l->flags & LINE_VALID) && (l->page == page)) {
+        l->hits++;
+    } else {
+        err = _line_evict(l);
+
+        if ((err == 0) && (fill != 0)) {
+            err = eeprom_read(_eeprom, page, l->data, _eeprom->page_size);
+        }
+
+        if (err == 0) {
+            l->flags = LINE_VALID;
+            l->page = page;
+            l->misses++;
+        }
+    }
+
+    if (err == 0) {
+        l->used = _stamp;
+        *line = l;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Look up the cache line for a page
+ * \param[in] page - the address of the page
+ * \return the line holding the page, or else the line to evict for it
+ *
+ * Kept out of line, so the state of the search is off the stack while a
+ * miss accesses the EEPROM.
+ */
+static struct cache_line *_line_find(uint16_t page)
+{
+    struct cache_line *lru = &_lines[0];
+    struct cache_line *found = NULL;
+    size_t i;
+
+    _stamp++;
+
+    for (i = 0; (i < EEPROM_CACHE_LINES) && (found == NULL); i++) {
+        struct cache_line *l = &_lines[i];
+
+        if ((l->flags & LINE_VALID) && (l->page == page)) {
+            found = l;
+        } else if (((l->flags & LINE_VALID) == 0) ||
+                   (((lru->flags & LINE_VALID) != 0) && ((uint16_t) (_stamp - l->used) > (uint16_t) (_stamp - lru->used)))) {
+            /* Empty lines are used first, otherwise the one unused the longest */
+            lru = l;
+        } else {
+            /* Used more recently */
+        }
+    }
+
+    return (found != NULL) ? found : lru;
+}
+
+/**
+ * \brief Evict the page held by a cache line
+ * \param[in] line - the cache line
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ */
+static int _line_evict(struct cache_line *line)
+{
+    const int err = _writeback(line);
+
+    if (err == 0) {
+        line->flags = 0;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Write a cache line to the EEPROM if it is dirty
+ * \param[in] line - the cache line
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ */
+static int _writeback(struct cache_line *line)
+{
+    int err = 0;
+
+    if (line->flags & LINE_DIRTY) {
+        err = eeprom_write(_eeprom, line->page, line->data, _eeprom->page_size);
+
+        if (err == 0) {
+            line->flags &= ~LINE_DIRTY;
+            line->writebacks++;
+        }
+    }
+
+    return err;
+}
@@ -0,0 +1,318 @@
+/**
+ * \file format.c
+ * \author Chris Karaplis
+ * \brief Formatted output without division
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "format.h"
+#include "uart.h"
+#include "defines.h"
+#include <stdarg.h>
+#include <stddef.h>
+
+/* Enough digits for a 32-bit value in decimal, plus the sign */
+#define FORMAT_DIGITS_MAX   11
+
+/* Powers of ten for values which need 32-bit arithmetic, largest first */
+static const unsigned long _pow10_long[] = {
+    1000000000UL,
+    100000000UL,
+    10000000UL,
+    1000000UL,
+    100000UL,
+    10000UL,
+    1000UL,
+    100UL,
+    10UL,
+    1UL
+};
+
+/* Powers of ten for values which fit in 16 bits */
+static const unsigned int _pow10[] = {10000U, 1000U, 100U, 10U, 1U};
+
+static const char _hex[] = "0123456789abcdef";
+
+static size_t _format_dec(char *buf, unsigned long value);
+static size_t _format_hex(char *buf, unsigned long value);
+static void _format_putchar(char c);
+static int _format_field(const char *str, size_t len, int neg, unsigned int width, int zero);
+
+/**
+ * \brief Print a formatted string to the UART
+ * \param[in] fmt - the format string
+ * \return the number of characters written
+ */
+int format_printf(const char *fmt, ...)
+{
+    va_list args;
+    int count = 0;
+
+    va_start(args, fmt);
+
+    while (*fmt != '\0') {
+        char digits[FORMAT_DIGITS_MAX];
+        unsigned long value;
+        unsigned int width = 0;
+        int zero = 0;
+        int is_long = 0;
+        int neg = 0;
+
+        if (*fmt != '%') {
+            _format_putchar(*fmt++);
+            count++;
+            continue;
+        }
+
+        fmt++;
+
+        if (*fmt == '0') {
+            zero = 1;
+            fmt++;
+        }
+
+        /* Accumulate the width by shifts and adds, 10x = 8x + 2x */
+        while ((*fmt >= '0') && (*fmt <= '9')) {
+            width = (width << 3) + (width << 1) + (unsigned int) (*fmt - '0');
+            fmt++;
+        }
+
+        if (*fmt == 'l') {
+            is_long = 1;
+            fmt++;
+        }
+
+        switch (*fmt) {
+            case 'u':
+            case 'x':
+                value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+
+                if (*fmt == 'u') {
+                    count += _format_field(digits, _format_dec(digits, value), 0, width, zero);
+                } else {
+                    count += _format_field(digits, _format_hex(digits, value), 0, width, zero);
+                }
+                break;
+            case 'd':
+            {
+                const long svalue = is_long ? va_arg(args, long) : va_arg(args, int);
+
+                if (svalue < 0) {
+                    neg = 1;
+                    value = 0UL - (unsigned long) svalue;
+                } else {
+                    value = (unsigned long) svalue;
+                }
+
+                count += _format_field(digits, _format_dec(digits, value), neg, width, zero);
+                break;
+            }
+            case 'c':
+                digits[0] = (char) va_arg(args, int);
+                count += _format_field(digits, 1, 0, width, 0);
+                break;
+            case 's':
+            {
+                const char *str = va_arg(args, const char *);
+                size_t len = 0;
+
+                while (str[len] != '\0') {
+                    len++;
+                }
+
+                count += _format_field(str, len, 0, width, 0);
+                break;
+            }
+            case '%':
+                _format_putchar('%');
+                count++;
+                break;
+            default:
+                /* Unsupported conversion, stop here */
+                fmt--;
+                break;
+        }
+
+        if (*fmt == '\0') {
+            break;
+        }
+
+        fmt++;
+    }
+
+    va_end(args);
+
+    return count;
+}
+
+/**
+ * \brief Convert a value to decimal digits
+ * \param[out] buf - buffer of at least FORMAT_DIGITS_MAX characters
+ * \param[in] value - the value to convert
+ * \return the number of digits written
+ *
+ * Each digit is found by repeatedly subtracting its power of ten, at most
+ * nine times per digit, instead of calling the software division routines.
+ * unsigned long is 32 bits on the target, larger values are not supported.
+ */
+static size_t _format_dec(char *buf, unsigned long value)
+{
+    size_t len = 0;
+    size_t i = 0;
+
+    if (value > 0xFFFFUL) {
+        /* Skip the leading zeros, the value is at least 65536 */
+        while (value < _pow10_long[i]) {
+            i++;
+        }
+
+        for (; i < ARRAY_SIZE(_pow10_long); i++) {
+            char digit = '0';
+
+            while (value >= _pow10_long[i]) {
+                value -= _pow10_long[i];
+                digit++;
+            }
+
+            buf[len++] = digit;
+        }
+    } else {
+        /* Stay in native 16-bit arithmetic for the common case */
+        unsigned int short_value = (unsigned int) value;
+
+        /* Skip the leading zeros, the last power always produces a digit */
+        while ((i < (ARRAY_SIZE(_pow10) - 1)) && (short_value < _pow10[i])) {
+            i++;
+        }
+
+        for (; i < ARRAY_SIZE(_pow10); i++) {
+            char digit = '0';
+
+            while (short_value >= _pow10[i]) {
+                short_value -= _pow10[i];
+                digit++;
+            }
+
+            buf[len++] = digit;
+        }
+    }
+
+    return len;
+}
+
+/**
+ * \brief Convert a value to lower case hexadecimal digits
+ * \param[out] buf - buffer of at least FORMAT_DIGITS_MAX characters
+ * \param[in] value - the value to convert
+ * \return the number of digits written
+ */
+static size_t _format_hex(char *buf, unsigned long value)
+{
+    int shift = 28;
+    size_t len = 0;
+
+    /* Skip the leading zeros */
+    while ((shift > 0) && (((value >> shift) & 0xF) == 0)) {
+        shift -= 4;
+    }
+
+    for (; shift >= 0; shift -= 4) {
+        buf[len++] = _hex[(value >> shift) & 0xF];
+    }
+
+    return len;
+}
+
+/**
+ * \brief Write a character, translating newlines like uart_puts
+ * \param[in] c - the character to write
+ */
+static void _format_putchar(char c)
+{
+    uart_putchar(c);
+
+    if (c == '\n') {
+        uart_putchar('\r');
+    }
+}
+
+/**
+ * \brief Write a converted field padded to the requested width
+ *
+ * Newlines in the field are translated as in the format string.
+ * \param[in] str - the characters of the field
+ * \param[in] len - the number of characters
+ * \param[in] neg - non-zero to prefix a minus sign
+ * \param[in] width - the minimum field width
+ * \param[in] zero - non-zero to pad with zeros after the sign
+ * \return the number of characters written
+ */
+static int _format_field(const char *str, size_t len, int neg, unsigned int width, int zero)
+{
+    size_t total = len + (neg ? 1 : 0);
+    size_t pad = (width > total) ? (width - total) : 0;
+    const char fill = zero ? '0' : ' ';
+    int count = (int) (total + pad);
+
+    if (!zero) {
+        while (pad-- > 0) {
+            uart_putchar(fill);
+        }
+    }
+
+    if (neg) {
+        uart_putchar('-');
+    }
+
+    if (zero) {
+        while (pad-- > 0) {
+            uart_putchar(fill);
+        }
+    }
+
+    while (len > 0) {
+        size_t run = 0;
+
+        /* Write the characters up to the next newline in one go */
+        while ((run < len) && (str[run] != '\n')) {
+            run++;
+        }
+
+        (void) uart_write_all(str, run);
+
+        if (run < len) {
+            _format_putchar(str[run++]);
+        }
+
+        str += run;
+        len -= run;
+    }
+
+    return count;
+}
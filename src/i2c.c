@@ -32,36 +32,134 @@
  */
 
 #include "i2c.h"
+#include "board.h"
+#include "usci.h"
+#include "timer.h"
+#include "ring_buffer.h"
 #include "defines.h"
+#include <string.h>
 #include <msp430.h>
 
-static int _transmit(const struct i2c_device *dev, const uint8_t *buf, size_t nbytes);
-static int _receive(const struct i2c_device *dev, uint8_t *buf, size_t nbytes);
-static int _check_ack(const struct i2c_device *dev);
+#define SR_ALLOC() uint16_t __sr
+#define ENTER_CRITICAL() __sr = _get_interrupt_state(); __disable_interrupt()
+#define EXIT_CRITICAL() __set_interrupt_state(__sr)
+
+/* Maximum number of queued jobs, must be a power of 2 */
+#ifndef I2C_QUEUE_SIZE
+#define I2C_QUEUE_SIZE  8
+#endif
+
+/* The USCI cannot divide BRCLK by less than 4 in I2C master mode */
+#define I2C_PRESCALER_MIN   4
+
+/* Shortest timeout which spans at least one full timer tick */
+#define I2C_TIMEOUT_MIN_MS  200
+
+/**
+ * Iterations of the busy waits for a start or stop condition, about 15ms at
+ * 1MHz. This is well beyond a byte time, so it only expires if the bus hangs
+ */
+#define I2C_SPIN_MAX    1000
+
+/* USCI_B0 pins on port 1 */
+#define I2C_SCL BIT6
+#define I2C_SDA BIT7
+
+/* Half of the SCL period during bus recovery in cycles, about 50kHz at 1MHz */
+#define I2C_RECOVER_DELAY   10
+
+/* Progress of the slave addressing after a (repeated) start condition */
+#define I2C_PHASE_ADDRESS   0   /* Address being sent */
+#define I2C_PHASE_LOADED    1   /* First data byte loaded while the address is sent */
+#define I2C_PHASE_ACKED     2   /* Address acknowledged */
+
+/* State of the transfer in progress */
+static struct
+{
+    const struct i2c_msg *msg;
+    size_t count;
+    uint8_t *buf;
+    size_t len;
+    size_t rx_run;
+    int phase;
+    int timer;
+    void (*callback)(int err, void *arg);
+    void *arg;
+    volatile int busy;
+} _xfer = {NULL, 0, NULL, 0, 0, I2C_PHASE_ADDRESS, -1, NULL, NULL, 0};
+
+/* Bus rate prescalers */
+static struct
+{
+    uint32_t smclk;             /* SMCLK frequency at initialization */
+    uint16_t prescaler;         /* Prescaler of the rate set by i2c_init() */
+    uint32_t last_hz;           /* Last device rate converted to a prescaler */
+    uint16_t last_prescaler;
+    uint16_t current;           /* Prescaler set in USCI_B0 */
+} _rate;
+
+/* Messages of a transfer started with struct i2c_data */
+static struct i2c_msg _data_msgs[2];
+
+/* Job queue, the job in progress and the queue statistics */
+RING_BUFFER_DEFINE(_jobs, struct i2c_job *, I2C_QUEUE_SIZE)
+static struct i2c_job *_job = NULL;
+static struct i2c_stats _stats;
+
+static size_t _data_to_msgs(const struct i2c_data *data, struct i2c_msg *msgs);
+static int _start_transfer(const struct i2c_device *dev, const struct i2c_msg *msgs, size_t count,
+                           uint16_t timeout_ms, void (*callback)(int err, void *arg), void *arg);
+static uint16_t _prescaler_compute(uint32_t bus_hz);
+static uint16_t _prescaler(const struct i2c_device *dev);
+static void _prescaler_set(uint16_t prescaler);
+static void _job_next(void);
+static void _job_done(int err, void *arg);
+static void _job_finish(struct i2c_job *job, int err);
+static void _next_msg(void);
+static int _joined(void);
+static void _start(void);
+static void _start_receive(void);
+static int _msg_end(void);
+static int _nack_error(void);
+static int _wait_clear(uint8_t mask);
+static void _timeout(void *arg);
+static int _abort(int err);
+static int _complete(int err);
+static void _reset(void);
+static int _recover(void);
 
 /**
  * \brief Initialize the I2C peripheral
+ * \param[in/out] config - the I2C configuration
  * \return 0 on success, -1 otherwise
+ *
+ * The prescaler is computed from the current SMCLK frequency and the rate
+ * achieved is stored in the configuration.
  */
-int i2c_init(void)
+int i2c_init(struct i2c_config *config)
 {
-    /* Ensure USCI_B0 is in reset before configuring */
-    UCB0CTL1 = UCSWRST;
+    int err = -1;
 
-    /* Set USCI_B0 to master mode I2C mode */
-    UCB0CTL0 = UCMST | UCMODE_3 | UCSYNC;
+    if ((config != NULL) && (config->bus_hz > 0)) {
+        /* Ensure USCI_B0 is in reset before configuring */
+        UCB0CTL1 = UCSWRST;
 
-    /**
-     * Configure the baud rate registers for 100kHz when sourcing from SMCLK
-     * where SMCLK = 1MHz
-     */
-    UCB0BR0 = 10;
-    UCB0BR1 = 0;
-    
-    /* Take USCI_B0 out of reset and source clock from SMCLK */
-    UCB0CTL1 = UCSSEL_2;
-    
-    return 0;
+        _rate.smclk = board_get_smclk();
+        _rate.prescaler = _prescaler_compute(config->bus_hz);
+        _rate.last_hz = 0;
+
+        /* Configure the baud rate registers, sourcing from SMCLK */
+        _rate.current = _rate.prescaler;
+        UCB0BR0 = _rate.current & 0xFF;
+        UCB0BR1 = _rate.current >> 8;
+
+        _reset();
+
+        config->actual_hz = _rate.smclk / _rate.prescaler;
+        err = 0;
+    }
+
+    return err;
 }
 
 /**
@@ -69,141 +167,787 @@ int i2c_init(void)
  * \param[in] dev - the I2C slave device
  * \param[in/out] data - data structure containing the buffers
  * \return 0 on success, -1 otherwise
+ *
+ * The transfer is queued behind any submitted jobs. The CPU sleeps in LPM0
+ * until the transfer completes, so this must not be called with interrupts
+ * disabled or from interrupt context.
  */
 int i2c_transfer(const struct i2c_device *dev, struct i2c_data *data)
 {
-    int err = 0;
+    int err = -1;
 
-    /* Set the slave device address */
-    UCB0I2CSA = dev->address;
- 
-    /* Transmit data is there is any */
-    if (data->tx_len > 0) {
-        err = _transmit(dev, (const uint8_t *) data->tx_buf, data->tx_len);
-    }
+    if (data != NULL) {
+        struct i2c_msg msgs[2];
 
-    /* Receive data is there is any */
-    if ((err == 0) && (data->rx_len > 0)) {
-        err = _receive(dev, (uint8_t *) data->rx_buf, data->rx_len);
-    } else {
-        /* No bytes to receive send the stop condition */
-        UCB0CTL1 |= UCTXSTP; 
+        err = i2c_transfer_msgs(dev, msgs, _data_to_msgs(data, msgs));
     }
-            
+
     return err;
 }
 
 /**
- * \brief Check for ACK/NACK and handle NACK condition if occured
+ * \brief Start an I2C transfer
  * \param[in] dev - the I2C slave device
- * \return 0 if slave ACK'd, -1 if slave NACK'd
+ * \param[in/out] data - data structure containing the buffers
+ * \param[in] callback - function called from interrupt context on completion
+ * \param[in] arg - callback function private data
+ * \return 0 if the transfer was started, -1 otherwise
+ *
+ * The data is sent as a write message joined to a read message.
  */
-static int _check_ack(const struct i2c_device *dev)
+int i2c_transfer_async(const struct i2c_device *dev, struct i2c_data *data,
+                       void (*callback)(int err, void *arg), void *arg)
 {
-    int err = 0;
-    IGNORE(dev);
- 
-    /* Check for ACK */
-    if (UCB0STAT & UCNACKIFG) {    
-        /* Stop the I2C transmission */
-        UCB0CTL1 |= UCTXSTP;
+    int err = -1;
 
-        /* Clear the interrupt flag */
-        UCB0STAT &= ~UCNACKIFG;
+    /* The messages are shared, so only build them if the bus is free */
+    if ((data != NULL) && (_xfer.busy == 0) && (_job == NULL)) {
+        const size_t count = _data_to_msgs(data, _data_msgs);
 
-        /* Set the error code */
-        err = -1;
+        err = i2c_transfer_msgs_async(dev, _data_msgs, count, callback, arg);
     }
 
     return err;
 }
 
 /**
- * \brief Transmit data to the slave device
+ * \brief Perform an I2C transfer made of several messages
  * \param[in] dev - the I2C slave device
- * \param[in] buf - the buffer of data to transmit
- * \param[in] nbytes - the number of bytes to transmit
+ * \param[in/out] msgs - array of messages
+ * \param[in] count - number of messages
  * \return 0 on success, -1 otherwise
  */
-static int _transmit(const struct i2c_device *dev, const uint8_t *buf, size_t nbytes)
+int i2c_transfer_msgs(const struct i2c_device *dev, const struct i2c_msg *msgs, size_t count)
 {
-    int err = 0;
-    IGNORE(dev);
+    struct i2c_job job;
+    int err;
+
+    job.dev = dev;
+    job.msgs = msgs;
+    job.count = count;
+    job.timeout_ms = 0;
 
-    /* Send the start condition */
-    UCB0CTL1 |= UCTR | UCTXSTT;        
+    err = i2c_submit(&job);
 
-    /* Wait for the start condition to be sent and ready to transmit interrupt */
-    while ((UCB0CTL1 & UCTXSTT) && ((IFG2 & UCB0TXIFG) == 0));
+    return (err == 0) ? i2c_wait(&job) : err;
+}
 
-    /* Check for ACK */
-    err = _check_ack(dev);
-    
-    /* If no error and bytes left to send, transmit the data */
-    while ((err == 0) && (nbytes > 0)) {
-        UCB0TXBUF = *buf;
-        while ((IFG2 & UCB0TXIFG) == 0) {
-            err = _check_ack(dev);
-            if (err < 0) {
-                break;
+/**
+ * \brief Start an I2C transfer made of several messages
+ * \param[in] dev - the I2C slave device
+ * \param[in/out] msgs - array of messages
+ * \param[in] count - number of messages
+ * \param[in] callback - function called from interrupt context on completion
+ * \param[in] arg - callback function private data
+ * \return 0 if the transfer was started, -1 otherwise
+ */
+int i2c_transfer_msgs_async(const struct i2c_device *dev, const struct i2c_msg *msgs, size_t count,
+                            void (*callback)(int err, void *arg), void *arg)
+{
+    return _start_transfer(dev, msgs, count, I2C_TIMEOUT_MS, callback, arg);
+}
+
+/**
+ * \brief Submit a job to the queue
+ * \param[in/out] job - the job, status is set to I2C_JOB_PENDING
+ * \return 0 if the job was queued, -1 otherwise
+ */
+int i2c_submit(struct i2c_job *job)
+{
+    int err = -1;
+
+    if (job != NULL) {
+        SR_ALLOC();
+
+        job->status = I2C_JOB_PENDING;
+
+        /**
+         * The queue is also drained from interrupt context. Taking the
+         * timestamp inside keeps interrupts off the stack of the call.
+         */
+        ENTER_CRITICAL();
+
+        job->submitted = timer_timestamp_us();
+
+        if (_jobs_put(job) == 0) {
+            const unsigned int depth = _jobs_count() + ((_job != NULL) ? 1 : 0);
+
+            if (depth > _stats.peak) {
+                _stats.peak = depth;
             }
+
+            /* Start the job straight away if the queue is idle */
+            _job_next();
+
+            err = 0;
         }
 
-        buf++;
-        nbytes--;
+        EXIT_CRITICAL();
     }
-    
+
     return err;
 }
 
 /**
- * \brief Receive data from the slave device
- * \param[in] dev - the I2C slave device
- * \param[in] buf - the buffer to store the received data
- * \param[in] nbytes - the number of bytes to receive
+ * \brief Wait for a job to complete
+ * \param[in] job - the job
+ * \return the status of the job, 0 on success, -1 otherwise
+ */
+int i2c_wait(struct i2c_job *job)
+{
+    /* Check with interrupts disabled so the completion cannot be missed */
+    __disable_interrupt();
+
+    while (job->status == I2C_JOB_PENDING) {
+        /* Enter LPM0 and enable interrupts atomically */
+        __bis_SR_register(LPM0_bits | GIE);
+        __disable_interrupt();
+    }
+
+    __enable_interrupt();
+
+    return job->status;
+}
+
+/**
+ * \brief Get the job queue statistics
+ * \param[out] stats - the statistics
+ * \param[in] reset - non-zero to reset the statistics after reading
  * \return 0 on success, -1 otherwise
  */
-static int _receive(const struct i2c_device *dev, uint8_t *buf, size_t nbytes)
+int i2c_get_stats(struct i2c_stats *stats, int reset)
 {
-    int err = 0;
-    IGNORE(dev);
+    int err = -1;
 
-    /* Send the start and wait */
-    UCB0CTL1 &= ~UCTR;
-    UCB0CTL1 |= UCTXSTT;
+    if (stats != NULL) {
+        SR_ALLOC();
+        ENTER_CRITICAL();
 
-    /* Wait for the start condition to be sent */
-    while (UCB0CTL1 & UCTXSTT);
-    
-    /* 
-     * If there is only one byte to receive, then set the stop
-     * bit as soon as start condition has been sent
-     */
-    if (nbytes == 1) {
-        UCB0CTL1 |= UCTXSTP;
+        _stats.depth = _jobs_count() + ((_job != NULL) ? 1 : 0);
+        *stats = _stats;
+
+        if (reset != 0) {
+            memset(&_stats, 0, sizeof(_stats));
+
+            /* The peak starts over from the current depth */
+            _stats.peak = stats->depth;
+        }
+
+        EXIT_CRITICAL();
+        err = 0;
+    }
+
+    return err;
+}
+
+/**
+ * \brief Get the bus rate achieved for a device
+ * \param[in] dev - the I2C slave device, NULL for the rate set by i2c_init()
+ * \return the bus rate in Hz
+ */
+uint32_t i2c_bus_hz(const struct i2c_device *dev)
+{
+    uint16_t prescaler = _rate.prescaler;
+
+    if ((dev != NULL) && (dev->bus_hz > 0)) {
+        prescaler = _prescaler_compute(dev->bus_hz);
+    }
+
+    return _rate.smclk / prescaler;
+}
+
+/**
+ * \brief Recover the bus from a slave holding SDA low
+ * \return 0 if the bus is free afterwards, -1 otherwise
+ */
+int i2c_recover(void)
+{
+    int err = -1;
+    SR_ALLOC();
+    ENTER_CRITICAL();
+
+    if (_xfer.busy == 0) {
+        err = _recover();
+    }
+
+    EXIT_CRITICAL();
+
+    return err;
+}
+
+/**
+ * \brief Check whether an I2C transfer is in progress
+ * \return non-zero if a transfer is in progress, 0 otherwise
+ */
+int i2c_busy(void)
+{
+    return _xfer.busy;
+}
+
+/**
+ * \brief I2C data (transmit and receive) interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int i2c_data_isr(void)
+{
+    int wake = 0;
+
+    if ((IE2 & UCB0TXIE) && (IFG2 & UCB0TXIFG)) {
+        /* The first byte only leaves the buffer once the address is ACKed */
+        if (_xfer.phase == I2C_PHASE_LOADED) {
+            _xfer.phase = I2C_PHASE_ACKED;
+        }
+
+        /* Continue with the following write messages joined to this one */
+        while ((_xfer.len == 0) && _joined() && ((_xfer.msg[1].flags & I2C_MSG_READ) == 0)) {
+            _next_msg();
+        }
+
+        if (_xfer.len > 0) {
+            /* Transmit the next byte, which clears the interrupt flag */
+            UCB0TXBUF = *_xfer.buf++;
+            _xfer.len--;
+
+            if (_xfer.phase == I2C_PHASE_ADDRESS) {
+                _xfer.phase = I2C_PHASE_LOADED;
+            }
+        } else {
+            IE2 &= ~UCB0TXIE;
+            IFG2 &= ~UCB0TXIFG;
+
+            if (_joined()) {
+                /* Repeated start in receive mode */
+                _next_msg();
+                _start_receive();
+            } else {
+                /**
+                 * Send the stop condition after the last byte. The slave
+                 * only ACKs or NACKs the last byte once it has been shifted
+                 * out, so wait for the stop (about one byte time) before
+                 * reporting the result. A slave stretching the clock
+                 * indefinitely aborts the transfer
+                 */
+                UCB0CTL1 |= UCTXSTP;
+
+                if (_wait_clear(UCTXSTP) != 0) {
+                    wake = _abort(I2C_ERR_TIMEOUT);
+                } else if (UCB0STAT & UCNACKIFG) {
+                    wake = _complete(_nack_error());
+                } else {
+                    wake = _msg_end();
+                }
+            }
+        }
     }
 
-    /* Check for ACK */
-    err = _check_ack(dev);
+    if ((IE2 & UCB0RXIE) && (IFG2 & UCB0RXIFG)) {
+        /* Continue with the next read message joined to this one */
+        if (_xfer.len == 0) {
+            _next_msg();
+        }
+
+        _xfer.phase = I2C_PHASE_ACKED;
+
+        /* Reading the data clears the interrupt flag */
+        *_xfer.buf++ = UCB0RXBUF;
+        _xfer.len--;
+        _xfer.rx_run--;
 
-    /* If no error and bytes left to receive, receive the data */
-    while ((err == 0) && (nbytes > 0)) {
-        /* Wait for the data */
-        while ((IFG2 & UCB0RXIFG) == 0);
+        if (_xfer.rx_run == 1) {
+            /* The stop condition is sent after the last byte is received */
+            UCB0CTL1 |= UCTXSTP;
+        } else if (_xfer.rx_run == 0) {
+            wake = _msg_end();
+        } else {
+            /* More bytes to receive */
+        }
+    }
 
-        *buf = UCB0RXBUF;
-        buf++;
-        nbytes--;
+    return wake;
+}
 
-        /* 
-         * If there is only one byte left to receive
-         * send the stop condition
+/**
+ * \brief I2C state (NACK, arbitration lost) interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int i2c_state_isr(void)
+{
+    int wake = 0;
+
+    if (UCB0STAT & UCALIFG) {
+        /**
+         * The USCI has switched to slave mode and the other master owns the
+         * bus, so restore master mode without touching the bus
          */
-        if (nbytes == 1) {
-            UCB0CTL1 |= UCTXSTP; 
+        _reset();
+
+        if (_xfer.busy != 0) {
+            wake = _complete(I2C_ERR_ARB_LOST);
+        }
+    } else if (UCB0STAT & UCNACKIFG) {
+        if (_xfer.busy != 0) {
+            /* Stop the I2C transmission */
+            UCB0CTL1 |= UCTXSTP;
+            IFG2 &= ~UCB0TXIFG;
+
+            wake = _complete(_nack_error());
+        } else {
+            /* NACK of a transfer which has already been completed */
+            UCB0STAT &= ~UCNACKIFG;
+        }
+    }
+
+    return wake;
+}
+
+/**
+ * \brief Convert a struct i2c_data to messages
+ * \param[in] data - the transaction data
+ * \param[out] msgs - array of at least two messages
+ * \return the number of messages
+ *
+ * The data is sent as a write message joined to a read message.
+ */
+static size_t _data_to_msgs(const struct i2c_data *data, struct i2c_msg *msgs)
+{
+    size_t count = 0;
+
+    if ((data->tx_len > 0) || (data->rx_len == 0)) {
+        msgs[count].buf = (void *) data->tx_buf;
+        msgs[count].len = data->tx_len;
+        msgs[count].flags = (data->rx_len > 0) ? I2C_MSG_NOSTOP : 0;
+        count++;
+    }
+
+    if (data->rx_len > 0) {
+        msgs[count].buf = data->rx_buf;
+        msgs[count].len = data->rx_len;
+        msgs[count].flags = I2C_MSG_READ;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * \brief Start an I2C transfer made of several messages
+ * \param[in] dev - the I2C slave device
+ * \param[in/out] msgs - array of messages
+ * \param[in] count - number of messages
+ * \param[in] timeout_ms - transfer timeout
+ * \param[in] callback - function called from interrupt context on completion
+ * \param[in] arg - callback function private data
+ * \return 0 if the transfer was started, -1 otherwise
+ */
+static int _start_transfer(const struct i2c_device *dev, const struct i2c_msg *msgs, size_t count,
+                           uint16_t timeout_ms, void (*callback)(int err, void *arg), void *arg)
+{
+    int err = -1;
+
+    if ((dev != NULL) && (msgs != NULL) && (count > 0) && (_xfer.busy == 0)) {
+        size_t i;
+
+        /* Zero length reads cannot be generated by the USCI */
+        for (i = 0; (i < count) && (((msgs[i].flags & I2C_MSG_READ) == 0) || (msgs[i].len > 0)); i++);
+
+        if (timeout_ms < I2C_TIMEOUT_MIN_MS) {
+            timeout_ms = I2C_TIMEOUT_MIN_MS;
+        }
+
+        /* The timeout bounds the transfer, so do not start without one */
+        if ((i == count) && ((_xfer.timer = timer_create(timeout_ms, 0, _timeout, NULL)) >= 0)) {
+            _xfer.msg = msgs;
+            _xfer.count = count;
+            _xfer.buf = (uint8_t *) msgs->buf;
+            _xfer.len = msgs->len;
+            _xfer.callback = callback;
+            _xfer.arg = arg;
+            _xfer.busy = 1;
+
+            /* Switch to the bus rate of the device */
+            _prescaler_set(_prescaler(dev));
+
+            /* Set the slave device address */
+            UCB0I2CSA = dev->address;
+
+            _start();
+
+            err = 0;
         }
     }
 
     return err;
 }
 
+/**
+ * \brief Compute the prescaler for a bus rate
+ * \param[in] bus_hz - the bus rate, non-zero
+ * \return the prescaler
+ *
+ * Rounded up so the bus never runs faster than requested.
+ */
+static uint16_t _prescaler_compute(uint32_t bus_hz)
+{
+    uint32_t prescaler = (_rate.smclk + bus_hz - 1) / bus_hz;
+
+    if (prescaler < I2C_PRESCALER_MIN) {
+        prescaler = I2C_PRESCALER_MIN;
+    } else if (prescaler > 0xFFFF) {
+        prescaler = 0xFFFF;
+    } else {
+        /* Within the range of the baud rate registers */
+    }
+
+    return (uint16_t) prescaler;
+}
+
+/**
+ * \brief Get the prescaler for a device
+ * \param[in] dev - the I2C slave device
+ * \return the prescaler
+ *
+ * The prescaler of the last device rate is kept, so the division is only
+ * done when devices with different rates take turns on the bus.
+ */
+static uint16_t _prescaler(const struct i2c_device *dev)
+{
+    uint16_t prescaler = _rate.prescaler;
+
+    if (dev->bus_hz > 0) {
+        if (dev->bus_hz != _rate.last_hz) {
+            _rate.last_prescaler = _prescaler_compute(dev->bus_hz);
+            _rate.last_hz = dev->bus_hz;
+        }
+
+        prescaler = _rate.last_prescaler;
+    }
+
+    return prescaler;
+}
+
+/**
+ * \brief Set the prescaler of USCI_B0
+ * \param[in] prescaler - the prescaler
+ *
+ * The USCI is held in reset while the prescaler is changed.
+ */
+static void _prescaler_set(uint16_t prescaler)
+{
+    if (prescaler != _rate.current) {
+        /* Let the stop condition of the previous transfer complete */
+        (void) _wait_clear(UCTXSTP);
+
+        UCB0CTL1 |= UCSWRST;
+        UCB0BR0 = prescaler & 0xFF;
+        UCB0BR1 = prescaler >> 8;
+        _rate.current = prescaler;
+
+        _reset();
+    }
+}
+
+/**
+ * \brief Start the next queued job if the bus is free
+ *
+ * Called with interrupts disabled. Jobs which cannot be started complete
+ * with an error straight away.
+ */
+static void _job_next(void)
+{
+    while ((_job == NULL) && (_xfer.busy == 0) && (_jobs_get(&_job) == 0)) {
+        const uint16_t timeout_ms = (_job->timeout_ms > 0) ? _job->timeout_ms : I2C_TIMEOUT_MS;
+
+        if (_start_transfer(_job->dev, _job->msgs, _job->count, timeout_ms, _job_done, _job) != 0) {
+            _job_finish(_job, -1);
+        }
+    }
+}
+
+/**
+ * \brief Completion callback of the queued jobs
+ * \param[in] err - the result of the transfer
+ * \param[in] arg - the job
+ */
+static void _job_done(int err, void *arg)
+{
+    _job_finish((struct i2c_job *) arg, err);
+}
+
+/**
+ * \brief Update the statistics and report the result of a job
+ * \param[in] job - the job
+ * \param[in] err - the result of the transfer
+ */
+static void _job_finish(struct i2c_job *job, int err)
+{
+    const uint32_t latency = timer_timestamp_us() - job->submitted;
+
+    _stats.completed++;
+
+    if (err != 0) {
+        _stats.errors++;
+    }
+
+    _stats.latency_total_us += latency;
+
+    if (latency > _stats.latency_max_us) {
+        _stats.latency_max_us = latency;
+    }
+
+    /* The owner may reuse the job as soon as the status is set */
+    _job = NULL;
+    job->status = err;
+}
+
+/**
+ * \brief Move on to the next message
+ */
+static void _next_msg(void)
+{
+    _xfer.msg++;
+    _xfer.count--;
+    _xfer.buf = (uint8_t *) _xfer.msg->buf;
+    _xfer.len = _xfer.msg->len;
+}
+
+/**
+ * \brief Check whether the next message is joined to the current one
+ * \return non-zero if joined, 0 otherwise
+ */
+static int _joined(void)
+{
+    return (_xfer.count > 1) && (_xfer.msg->flags & I2C_MSG_NOSTOP);
+}
+
+/**
+ * \brief Send the start condition for the current message
+ */
+static void _start(void)
+{
+    /**
+     * Wait for the stop condition of the previous message to be sent. If the
+     * bus hangs, recover it and try anyway, the transfer timeout catches a
+     * start condition which never completes
+     */
+    if (_wait_clear(UCTXSTP) != 0) {
+        (void) _recover();
+    }
+
+    if (_xfer.msg->flags & I2C_MSG_READ) {
+        _start_receive();
+    } else {
+        /**
+         * Send the start condition in transmit mode. A message without any
+         * data only addresses the slave, which is useful to poll it
+         */
+        _xfer.phase = I2C_PHASE_ADDRESS;
+        UCB0CTL1 |= UCTR | UCTXSTT;
+        IE2 |= UCB0TXIE;
+    }
+}
+
+/**
+ * \brief Send a (repeated) start condition in receive mode
+ *
+ * The read messages joined to the current one are received in one go, the
+ * stop condition is requested while the last byte is received. If only one
+ * byte is to be received, wait for the address to be sent first. If that
+ * wait expires, the transfer timeout aborts the transfer.
+ */
+static void _start_receive(void)
+{
+    size_t i;
+
+    _xfer.rx_run = _xfer.len;
+
+    for (i = 1; (i < _xfer.count) && (_xfer.msg[i - 1].flags & I2C_MSG_NOSTOP) &&
+                (_xfer.msg[i].flags & I2C_MSG_READ); i++) {
+        _xfer.rx_run += _xfer.msg[i].len;
+    }
+
+    _xfer.phase = I2C_PHASE_ADDRESS;
+    UCB0CTL1 &= ~UCTR;
+    UCB0CTL1 |= UCTXSTT;
+    IE2 |= UCB0RXIE;
+
+    if ((_xfer.rx_run == 1) && (_wait_clear(UCTXSTT) == 0)) {
+        UCB0CTL1 |= UCTXSTP;
+    }
+}
+
+/**
+ * \brief Handle the stop condition at the end of a message
+ * \return non-zero to wake the CPU, 0 otherwise
+ *
+ * Starts the next message if there is one, otherwise completes the transfer.
+ */
+static int _msg_end(void)
+{
+    int wake = 0;
+
+    if (_xfer.count > 1) {
+        IE2 &= ~(UCB0TXIE | UCB0RXIE);
+        _next_msg();
+        _start();
+    } else {
+        wake = _complete(0);
+    }
+
+    return wake;
+}
+
+/**
+ * \brief Get the error of a NACK received during the transfer
+ * \return I2C_ERR_NACK_DATA if the slave has acknowledged its address,
+ *         I2C_ERR_NACK_ADDR otherwise
+ */
+static int _nack_error(void)
+{
+    return (_xfer.phase == I2C_PHASE_ACKED) ? I2C_ERR_NACK_DATA : I2C_ERR_NACK_ADDR;
+}
+
+/**
+ * \brief Wait for bits of UCB0CTL1 to be cleared by the USCI
+ * \param[in] mask - the bits
+ * \return 0 if the bits were cleared, -1 if the wait expired
+ */
+static int _wait_clear(uint8_t mask)
+{
+    unsigned int i = I2C_SPIN_MAX;
+
+    while ((UCB0CTL1 & mask) && (--i > 0));
+
+    return (i > 0) ? 0 : -1;
+}
+
+/**
+ * \brief Transfer timeout callback
+ * \param[in] arg - unused
+ *
+ * Called from the timer interrupt.
+ */
+static void _timeout(void *arg)
+{
+    (void) arg;
+
+    /* The timer is deleted once the callback returns */
+    _xfer.timer = -1;
+
+    if (_xfer.busy != 0) {
+        (void) _abort(I2C_ERR_TIMEOUT);
+    }
+}
+
+/**
+ * \brief Abort the transfer in progress and recover the bus
+ * \param[in] err - the result of the transfer
+ * \return non-zero to wake the CPU
+ */
+static int _abort(int err)
+{
+    IE2 &= ~(UCB0TXIE | UCB0RXIE);
+    (void) _recover();
+
+    return _complete(err);
+}
+
+/**
+ * \brief Complete the transfer in progress and invoke the callback
+ * \param[in] err - the result of the transfer
+ * \return non-zero to wake the CPU
+ *
+ * The transfer is marked as complete before invoking the callback, so the
+ * callback may start the next transfer. Otherwise the next queued job is
+ * started, so the bus does not sit idle between jobs.
+ */
+static int _complete(int err)
+{
+    IE2 &= ~(UCB0TXIE | UCB0RXIE);
+    UCB0STAT &= ~(UCNACKIFG | UCALIFG);
+
+    if (_xfer.timer >= 0) {
+        (void) timer_delete(_xfer.timer);
+        _xfer.timer = -1;
+    }
+
+    _xfer.busy = 0;
+
+    if (_xfer.callback != NULL) {
+        _xfer.callback(err, _xfer.arg);
+    }
+
+    /* Start the next queued job, unless the callback started a transfer */
+    _job_next();
+
+    return 1;
+}
+
+/**
+ * \brief Reset USCI_B0 to I2C master mode
+ *
+ * The baud rate registers are not affected by the reset.
+ */
+static void _reset(void)
+{
+    UCB0CTL1 |= UCSWRST;
+
+    /* Set USCI_B0 to master mode I2C mode */
+    UCB0CTL0 = UCMST | UCMODE_3 | UCSYNC;
+
+    /* Take USCI_B0 out of reset and source clock from SMCLK */
+    UCB0CTL1 = UCSSEL_2;
+
+    /**
+     * Enable the NACK and arbitration lost interrupts, the data interrupts
+     * are enabled per transfer
+     */
+    UCB0I2CIE = UCNACKIE | UCALIE;
+}
+
+/**
+ * \brief Recover the bus from a slave holding SDA low
+ * \return 0 if the bus is free afterwards, -1 otherwise
+ *
+ * A slave which lost track of the clock, for example after a reset of the
+ * master in the middle of a read, keeps driving SDA until it has shifted
+ * out the rest of its byte. The pins are driven as open drain GPIOs.
+ */
+static int _recover(void)
+{
+    int err;
+    int i;
+
+    /* Hold USCI_B0 in reset and release the pins */
+    UCB0CTL1 |= UCSWRST;
+    P1OUT &= ~(I2C_SCL | I2C_SDA);
+    P1DIR &= ~(I2C_SCL | I2C_SDA);
+    P1SEL &= ~(I2C_SCL | I2C_SDA);
+    P1SEL2 &= ~(I2C_SCL | I2C_SDA);
+
+    /* Clock out up to 9 bits until the slave releases SDA */
+    for (i = 0; (i < 9) && ((P1IN & I2C_SDA) == 0); i++) {
+        P1DIR |= I2C_SCL;
+        __delay_cycles(I2C_RECOVER_DELAY);
+        P1DIR &= ~I2C_SCL;
+        __delay_cycles(I2C_RECOVER_DELAY);
+    }
+
+    /* Send a stop condition, SDA rising while SCL is high */
+    P1DIR |= I2C_SCL;
+    __delay_cycles(I2C_RECOVER_DELAY);
+    P1DIR |= I2C_SDA;
+    __delay_cycles(I2C_RECOVER_DELAY);
+    P1DIR &= ~I2C_SCL;
+    __delay_cycles(I2C_RECOVER_DELAY);
+    P1DIR &= ~I2C_SDA;
+    __delay_cycles(I2C_RECOVER_DELAY);
+
+    err = ((P1IN & (I2C_SCL | I2C_SDA)) == (I2C_SCL | I2C_SDA)) ? 0 : -1;
+
+    /* Hand the pins back to USCI_B0 */
+    P1SEL |= I2C_SCL | I2C_SDA;
+    P1SEL2 |= I2C_SCL | I2C_SDA;
+    _reset();
+
+    return err;
+}
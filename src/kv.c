@@ -0,0 +1,566 @@
+/**
+ * \file kv.c
+ * \author Chris Karaplis
+ * \brief Log-structured key-value store on the EEPROM
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "kv.h"
+#include "eeprom_cache.h"
+#include "crc16.h"
+#include <string.h>
+
+/**
+ * Record header: key, value length, sequence number and CRC-16 of the
+ * header fields before it and the value, multi-byte fields little endian
+ */
+#define KV_HEADER_SIZE  6
+#define KV_RECORD_MAX   (KV_HEADER_SIZE + KV_VALUE_MAX)
+
+/* First byte of erased space, which ends the records of a sector */
+#define KV_KEY_ERASED   0xFF
+
+/* Index entry of a key without a value */
+#define KV_NONE         0xFFFF
+
+/**
+ * Maximum number of bytes of live records. A record never spans sectors,
+ * so a full sector holds at least KV_SECTOR_SIZE - KV_RECORD_MAX + 1 bytes
+ * of records. Keeping the live records within all but two sectors leaves
+ * a sector free for compaction and one to make progress with
+ */
+#define KV_LIVE_MAX     ((KV_SECTORS - 2) * (KV_SECTOR_SIZE - KV_RECORD_MAX + 1))
+
+/* The free and used sectors are tracked in a bitmask */
+typedef char _kv_sectors_invalid[((KV_SECTORS >= 3) && (KV_SECTORS <= 8)) ? 1 : -1];
+
+/* Sectors are erased 8 bytes at a time and must hold the largest record */
+typedef char _kv_sector_size_invalid[(((KV_SECTOR_SIZE % 8) == 0) && (KV_SECTOR_SIZE >= KV_RECORD_MAX)) ? 1 : -1];
+
+/* Keys must not be confused with erased space */
+typedef char _kv_keys_invalid[(KV_KEYS < KV_KEY_ERASED) ? 1 : -1];
+
+/* Header of a record read from the log */
+struct kv_record
+{
+    uint8_t key;
+    uint8_t len;
+    uint16_t seq;
+};
+
+/* Address of the newest record of each key */
+static uint16_t _index[KV_KEYS];
+
+/* Bytes of live records in each sector */
+static uint16_t _sector_live[KV_SECTORS];
+
+/* Sectors holding records, or garbage, which must be erased before reuse */
+static uint8_t _used = 0;
+
+/* Sector and offset the next record is appended at */
+static uint8_t _head = 0;
+static uint16_t _pos = 0;
+
+/* Sequence number of the next record */
+static uint16_t _seq = 0;
+
+static int _ready = 0;
+
+static int _record_read(uint16_t addr, uint16_t space, struct kv_record *rec, uint8_t *value);
+static int _append(uint8_t key, const void *value, size_t len);
+static int _compact(void);
+static int _erase(uint8_t sector);
+static void _supersede(uint8_t key, uint16_t size);
+static int _tail(void);
+static unsigned int _free(void);
+static uint16_t _live(void);
+static uint16_t _addr(uint8_t sector, uint16_t pos);
+static uint8_t _sector(uint16_t addr);
+static int _newer(uint16_t seq, uint16_t than);
+
+/**
+ * \brief Initialize the store
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * Each sector is scanned up to its first invalid record. The newest record
+ * of each key is indexed, and records are appended after the newest record
+ * overall. If the store holds no records, it starts in the first erased
+ * sector, or sector 0 once erased.
+ */
+int kv_init(void)
+{
+    uint16_t seqs[KV_KEYS];
+    uint8_t value[KV_VALUE_MAX];
+    int found = 0;
+    int err = 0;
+    uint8_t s;
+
+    _ready = 0;
+    _used = 0;
+    memset(_index, 0xFF, sizeof(_index));
+    memset(_sector_live, 0, sizeof(_sector_live));
+
+    for (s = 0; (err == 0) && (s < KV_SECTORS); s++) {
+        struct kv_record rec;
+        uint16_t pos = 0;
+        int newest = 0;
+        int ret;
+
+        while ((ret = _record_read(_addr(s, pos), KV_SECTOR_SIZE - pos, &rec, value)) == 0) {
+            if ((found == 0) || _newer(rec.seq, _seq)) {
+                _seq = rec.seq;
+                newest = 1;
+                found = 1;
+            }
+
+            if ((_index[rec.key] == KV_NONE) || _newer(rec.seq, seqs[rec.key])) {
+                _index[rec.key] = _addr(s, pos);
+                seqs[rec.key] = rec.seq;
+            }
+
+            pos += KV_HEADER_SIZE + rec.len;
+        }
+
+        if (ret < 0) {
+            err = ret;
+        } else if ((pos > 0) || (rec.key != KV_KEY_ERASED)) {
+            _used |= 1 << s;
+        } else {
+            /* Erased */
+        }
+
+        if (newest != 0) {
+            _head = s;
+            _pos = pos;
+        }
+    }
+
+    if ((err == 0) && (found != 0)) {
+        uint8_t key;
+
+        _seq++;
+
+        /* Account for the live records */
+        for (key = 0; (err == 0) && (key < KV_KEYS); key++) {
+            if (_index[key] != KV_NONE) {
+                struct kv_record rec;
+
+                err = (_record_read(_index[key], KV_RECORD_MAX, &rec, value) == 0) ? 0 : -1;
+                _sector_live[_sector(_index[key])] += KV_HEADER_SIZE + rec.len;
+            }
+        }
+    } else if (err == 0) {
+        for (_head = 0; (_head < KV_SECTORS) && (_used & (1 << _head)); _head++);
+
+        if (_head == KV_SECTORS) {
+            _head = 0;
+            err = _erase(_head);
+        }
+
+        _pos = 0;
+        _used |= 1 << _head;
+    } else {
+        /* Failed to read the EEPROM */
+    }
+
+    _ready = (err == 0) ? 1 : 0;
+
+    return err;
+}
+
+/**
+ * \brief Get the value of a key
+ * \param[in] key - the key
+ * \param[out] buf - the buffer to store the value
+ * \param[in] len - the size of the buffer
+ * \return the length of the value on success, -1 or I2C_ERR_* otherwise
+ *
+ * The record is located through the index, its CRC was checked when it
+ * was scanned or written.
+ */
+int kv_get(uint8_t key, void *buf, size_t len)
+{
+    int ret = -1;
+
+    if ((_ready != 0) && (key < KV_KEYS) && (buf != NULL) && (_index[key] != KV_NONE)) {
+        uint8_t header[2];
+
+        ret = eeprom_cache_read(_index[key], header, sizeof(header));
+
+        if ((ret == 0) && (header[1] > len)) {
+            ret = -1;
+        }
+
+        if (ret == 0) {
+            ret = eeprom_cache_read(_index[key] + KV_HEADER_SIZE, buf, header[1]);
+        }
+
+        if (ret == 0) {
+            ret = header[1];
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * \brief Set the value of a key
+ * \param[in] key - the key
+ * \param[in] value - the value
+ * \param[in] len - the length of the value, at most KV_VALUE_MAX
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * If the record does not fit in the head sector and moving on would use up
+ * the last free sector, the oldest sectors are compacted first.
+ */
+int kv_set(uint8_t key, const void *value, size_t len)
+{
+    int err = -1;
+
+    if ((_ready != 0) && (key < KV_KEYS) && ((value != NULL) || (len == 0)) && (len <= KV_VALUE_MAX)) {
+        const uint16_t size = KV_HEADER_SIZE + len;
+        uint16_t live = _live() + size;
+        uint8_t header[2];
+
+        err = 0;
+
+        if (_index[key] != KV_NONE) {
+            err = eeprom_cache_read(_index[key], header, sizeof(header));
+            live -= KV_HEADER_SIZE + header[1];
+        }
+
+        if ((err == 0) && (live > KV_LIVE_MAX)) {
+            err = -1;
+        }
+
+        if (err == 0) {
+            unsigned int i;
+
+            for (i = 0; (err == 0) && (i < KV_SECTORS) && ((_pos + size) > KV_SECTOR_SIZE) && (_free() < 2); i++) {
+                err = _compact();
+            }
+
+            if ((err == 0) && ((_pos + size) > KV_SECTOR_SIZE) && (_free() < 2)) {
+                err = -1;
+            }
+        }
+
+        if (err == 0) {
+            if (_index[key] != KV_NONE) {
+                _supersede(key, KV_HEADER_SIZE + header[1]);
+            }
+
+            err = _append(key, value, len);
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Compact the store in the background
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The oldest sector is only compacted if that frees more space than a
+ * record can waste at the end of a sector, so a store full of live records
+ * is not rewritten over and over.
+ */
+int kv_poll(void)
+{
+    int err = 0;
+
+    if ((_ready != 0) && (_free() < 2)) {
+        const int tail = _tail();
+
+        if ((tail >= 0) && (_sector_live[tail] < (KV_SECTOR_SIZE - KV_RECORD_MAX))) {
+            err = _compact();
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Read and validate a record
+ * \param[in] addr - the address of the record
+ * \param[in] space - the number of bytes left in the sector
+ * \param[out] rec - the record header, key is set even if invalid
+ * \param[out] value - buffer of KV_VALUE_MAX bytes for the value
+ * \return 0 if the record is valid, 1 if not, I2C_ERR_* on error
+ */
+static int _record_read(uint16_t addr, uint16_t space, struct kv_record *rec, uint8_t *value)
+{
+    uint8_t header[KV_HEADER_SIZE];
+    int ret = 1;
+
+    rec->key = KV_KEY_ERASED;
+
+    if (space >= KV_HEADER_SIZE) {
+        ret = eeprom_cache_read(addr, header, sizeof(header));
+
+        if (ret == 0) {
+            rec->key = header[0];
+            rec->len = header[1];
+            rec->seq = header[2] | ((uint16_t) header[3] << 8);
+            ret = 1;
+
+            if ((rec->key < KV_KEYS) && (rec->len <= KV_VALUE_MAX) && ((KV_HEADER_SIZE + rec->len) <= space)) {
+                ret = eeprom_cache_read(addr + KV_HEADER_SIZE, value, rec->len);
+
+                if ((ret == 0) &&
+                    (crc16(crc16(CRC16_INIT, header, 4), value, rec->len) != (header[4] | ((uint16_t) header[5] << 8)))) {
+                    ret = 1;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * \brief Append a record to the log
+ * \param[in] key - the key
+ * \param[in] value - the value
+ * \param[in] len - the length of the value
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * Moves on to the next sector if the record does not fit in the head
+ * sector, which fails if the next sector is not free.
+ */
+static int _append(uint8_t key, const void *value, size_t len)
+{
+    const uint16_t size = KV_HEADER_SIZE + len;
+    int err = -1;
+
+    if ((_pos + size) > KV_SECTOR_SIZE) {
+        const uint8_t next = (_head + 1) % KV_SECTORS;
+
+        if ((_used & (1 << next)) == 0) {
+            _head = next;
+            _pos = 0;
+            _used |= 1 << next;
+        }
+    }
+
+    if ((_pos + size) <= KV_SECTOR_SIZE) {
+        const uint16_t addr = _addr(_head, _pos);
+        uint8_t header[KV_HEADER_SIZE];
+        uint16_t crc;
+
+        header[0] = key;
+        header[1] = len;
+        header[2] = _seq & 0xFF;
+        header[3] = _seq >> 8;
+
+        crc = crc16(crc16(CRC16_INIT, header, 4), value, len);
+        header[4] = crc & 0xFF;
+        header[5] = crc >> 8;
+
+        err = eeprom_cache_write(addr, header, sizeof(header));
+
+        if ((err == 0) && (len > 0)) {
+            err = eeprom_cache_write(addr + KV_HEADER_SIZE, value, len);
+        }
+
+        if (err == 0) {
+            _index[key] = addr;
+            _sector_live[_head] += size;
+            _pos += size;
+            _seq++;
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Compact the oldest sector
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * The live records are appended to the log again, then the sector is
+ * erased. The copies are flushed to the EEPROM before the erase, so an
+ * interruption cannot lose them.
+ */
+static int _compact(void)
+{
+    const int tail = _tail();
+    int err = -1;
+
+    if (tail >= 0) {
+        uint8_t value[KV_VALUE_MAX];
+        struct kv_record rec;
+        uint16_t pos = 0;
+        int ret;
+
+        err = 0;
+
+        while ((err == 0) &&
+               ((ret = _record_read(_addr(tail, pos), KV_SECTOR_SIZE - pos, &rec, value)) == 0)) {
+            if (_index[rec.key] == _addr(tail, pos)) {
+                _supersede(rec.key, KV_HEADER_SIZE + rec.len);
+                err = _append(rec.key, value, rec.len);
+            }
+
+            pos += KV_HEADER_SIZE + rec.len;
+        }
+
+        if ((err == 0) && (ret < 0)) {
+            err = ret;
+        }
+
+        if (err == 0) {
+            err = eeprom_cache_flush();
+        }
+
+        if (err == 0) {
+            err = _erase(tail);
+        }
+
+        if (err == 0) {
+            _used &= ~(1 << tail);
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Erase a sector
+ * \param[in] sector - the sector
+ * \return 0 on success, -1 or I2C_ERR_* otherwise
+ *
+ * An interrupted erase may leave old records behind an erased first byte.
+ * Their keys all have newer records, which win when the sector is scanned.
+ */
+static int _erase(uint8_t sector)
+{
+    uint8_t erased[8];
+    uint16_t pos;
+    int err = 0;
+
+    memset(erased, KV_KEY_ERASED, sizeof(erased));
+
+    for (pos = 0; (err == 0) && (pos < KV_SECTOR_SIZE); pos += sizeof(erased)) {
+        err = eeprom_cache_write(_addr(sector, pos), erased, sizeof(erased));
+    }
+
+    return err;
+}
+
+/**
+ * \brief Remove the current record of a key from the live data
+ * \param[in] key - the key, which must have a record
+ * \param[in] size - the size of the record
+ */
+static void _supersede(uint8_t key, uint16_t size)
+{
+    _sector_live[_sector(_index[key])] -= size;
+    _index[key] = KV_NONE;
+}
+
+/**
+ * \brief Get the oldest sector
+ * \return the first used sector after the head, -1 if there is none
+ */
+static int _tail(void)
+{
+    uint8_t sector = (_head + 1) % KV_SECTORS;
+
+    while ((sector != _head) && ((_used & (1 << sector)) == 0)) {
+        sector = (sector + 1) % KV_SECTORS;
+    }
+
+    return (sector != _head) ? sector : -1;
+}
+
+/**
+ * \brief Count the free sectors
+ * \return the number of erased sectors
+ */
+static unsigned int _free(void)
+{
+    unsigned int count = 0;
+    uint8_t s;
+
+    for (s = 0; s < KV_SECTORS; s++) {
+        if ((_used & (1 << s)) == 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * \brief Get the size of the live records
+ * \return the number of bytes of live records
+ */
+static uint16_t _live(void)
+{
+    uint16_t live = 0;
+    uint8_t s;
+
+    for (s = 0; s < KV_SECTORS; s++) {
+        live += _sector_live[s];
+    }
+
+    return live;
+}
+
+/**
+ * \brief Get the EEPROM address of a position in a sector
+ * \param[in] sector - the sector
+ * \param[in] pos - the offset in the sector
+ * \return the address
+ */
+static uint16_t _addr(uint8_t sector, uint16_t pos)
+{
+    return KV_BASE + (sector * KV_SECTOR_SIZE) + pos;
+}
+
+/**
+ * \brief Get the sector of an EEPROM address
+ * \param[in] addr - the address
+ * \return the sector
+ */
+static uint8_t _sector(uint16_t addr)
+{
+    return (addr - KV_BASE) / KV_SECTOR_SIZE;
+}
+
+/**
+ * \brief Compare sequence numbers, which wrap around
+ * \param[in] seq - the sequence number
+ * \param[in] than - the sequence number to compare with
+ * \return non-zero if seq is newer, 0 otherwise
+ */
+static int _newer(uint16_t seq, uint16_t than)
+{
+    return (int16_t) (seq - than) > 0;
+}
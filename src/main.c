@@ -36,6 +36,12 @@
 #include "menu.h"
 #include "uart.h"
 #include "i2c.h"
+#include "eeprom.h"
+#include "eeprom_cache.h"
+#include "kv.h"
+#include "ring_buffer.h"
+#include "proto.h"
+#include "format.h"
 #include "defines.h"
 #include <stddef.h>
 #include <string.h>
@@ -44,19 +50,50 @@
 static volatile int _blink_enable = 0;
 static uint16_t _timer_ms = 0;
 
-static char *_uint_to_ascii(unsigned int value);
+/* The blink period changed and is yet to be persisted */
+static int _timer_ms_dirty = 0;
+
+/* 24C02 EEPROM on the I2C bus, which supports Fast-mode */
+static const struct eeprom _eeprom = {{0x50, 400000}, 256, 8, 1};
+
+/* Keys of the persistent settings */
+#define KEY_BLINK_MS    0
+
 static void blink_led(void *arg);
+static int blink_freq_update(unsigned int freq);
 static int set_blink_freq(void);
 static int stopwatch(void);
-static int eeprom_read(void);
-static int eeprom_write(void);
+static int read_eeprom(void);
+static int write_eeprom(void);
+static int ring_buffer_info(void);
+static int i2c_info(void);
+static int eeprom_cache_info(void);
+static int binary_mode(void);
+static int cmd_ping(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+static int cmd_set_blink_freq(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+static int cmd_stopwatch(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+static int cmd_eeprom_read(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+static int cmd_eeprom_write(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
 
 static const struct menu_item main_menu[] = 
 {
     {"Set LED blinking frequency", set_blink_freq},
     {"Stopwatch", stopwatch},
-    {"EEPROM Read Byte", eeprom_read},
-    {"EEPROM Write Byte", eeprom_write}
+    {"EEPROM Read Byte", read_eeprom},
+    {"EEPROM Write Byte", write_eeprom},
+    {"Ring buffer statistics", ring_buffer_info},
+    {"I2C statistics", i2c_info},
+    {"EEPROM cache statistics", eeprom_cache_info},
+    {"Binary protocol mode", binary_mode}
+};
+
+static const struct proto_cmd binary_cmds[] =
+{
+    {0x01, cmd_ping},
+    {0x02, cmd_set_blink_freq},
+    {0x03, cmd_stopwatch},
+    {0x04, cmd_eeprom_read},
+    {0x05, cmd_eeprom_write}
 };
 
 int main(int argc, char *argv[])
@@ -75,7 +112,15 @@ int main(int argc, char *argv[])
         uart_puts("\n**********************************************");
 
         menu_init(main_menu, ARRAY_SIZE(main_menu));
-        
+
+        /* All EEPROM accesses go through the cache */
+        (void) eeprom_cache_init(&_eeprom);
+
+        /* Restore the settings from the upper half of the EEPROM */
+        if (kv_init() == 0) {
+            (void) kv_get(KEY_BLINK_MS, &_timer_ms, sizeof(_timer_ms));
+        }
+
         while (1) {
             watchdog_pet();
             menu_run();
@@ -94,6 +139,25 @@ int main(int argc, char *argv[])
                     timer_handle = -1;
                 }
             }
+
+            /* Compact the settings before they run out of space */
+            (void) kv_poll();
+
+            /**
+             * Persist a changed setting from here rather than from the
+             * command, the EEPROM write is the deepest call chain and
+             * would otherwise stack on top of the menu or the protocol
+             */
+            if (_timer_ms_dirty != 0) {
+                _timer_ms_dirty = 0;
+                (void) kv_set(KEY_BLINK_MS, &_timer_ms, sizeof(_timer_ms));
+            }
+
+            /* Write back the cached EEPROM pages once writes have stopped */
+            (void) eeprom_cache_poll();
+
+            /* Sleep until a line is received or the next timer tick */
+            uart_wait_line();
         }
     }
 
@@ -108,115 +172,247 @@ static void blink_led(void *arg)
     P1OUT ^= 0x01;
 }
 
-static int set_blink_freq(void)
+static int blink_freq_update(unsigned int freq)
 {
-    const unsigned int value = menu_read_uint("Enter the LED blinking frequency (Hz): ");
+    int err = -1;
 
-    if (value > 0) {
-        _timer_ms = 1000 / (2 * value);
+    if (freq > 0) {
+        _timer_ms = 1000 / (2 * freq);
+
+        /* The main loop persists the setting */
+        _timer_ms_dirty = 1;
+        err = 0;
     }
 
-    return (value > 0) ? 0 : -1;
+    return err;
+}
+
+static int set_blink_freq(void)
+{
+    const unsigned int value = menu_read_uint("Enter the LED blinking frequency (Hz): ");
+
+    return blink_freq_update(value);
 }
 
 static int stopwatch(void)
 {
     struct time start_time;
     struct time end_time;
+    char line[2];
     
-    uart_puts("\nPress any key to start/stop the stopwatch: ");
+    uart_puts("\nPress enter to start/stop the stopwatch: ");
     
     /* Wait to start */
-    while (uart_getchar() == -1) {watchdog_pet();}
+    while (uart_getline(line, sizeof(line)) < 0) {watchdog_pet(); uart_wait_line();}
     
     if (timer_capture(&start_time) == 0) {
-        uart_puts("\nRunning...");
+        uart_puts("Running...");
 
         /* Wait to stop */
-        while (uart_getchar() == -1) {watchdog_pet();}
+        while (uart_getline(line, sizeof(line)) < 0) {watchdog_pet(); uart_wait_line();}
         
         if (timer_capture(&end_time) == 0) {
             unsigned int sec = end_time.sec - start_time.sec;
             unsigned int ms = end_time.ms - start_time.ms;            
 
             /* Display the result */
-            uart_puts("\nTime: ");
-            uart_puts(_uint_to_ascii(sec));
-            uart_putchar('.');
-            uart_puts(_uint_to_ascii(ms));
-            uart_putchar('\n');
+            format_printf("Time: %u.%03u\n", sec, ms);
         }
     }
 
     return 0;
 }
 
-static int eeprom_read(void)
+static int read_eeprom(void)
 {
     int err;
-    struct i2c_device dev;
-    struct i2c_data data;    
-    uint8_t rx_data[1];
-    uint8_t address;
+    uint8_t data;
+    uint16_t address;
 
-    dev.address = 0x50;
-    
-    address = (uint8_t) menu_read_uint("Enter the address to read: ");
+    address = menu_read_uint("Enter the address to read: ");
+
+    err = eeprom_cache_read(address, &data, sizeof(data));
+
+    if (err == 0) {
+        format_printf("\nData: %u\n", data);
+    }
 
-    data.tx_buf = &address;
-    data.tx_len = sizeof(address);
-    data.rx_len = ARRAY_SIZE(rx_data);
-    data.rx_buf = (uint8_t *) rx_data;
+    return err;
+}
+
+static int write_eeprom(void)
+{
+    uint16_t address;
+    uint8_t data;
+
+    address = menu_read_uint("Enter the address to write: ");
+    data = menu_read_uint("Enter the data to write: ");
 
-    err = i2c_transfer(&dev, &data);
+    /* The settings store owns the EEPROM from KV_BASE */
+    return (address < KV_BASE) ? eeprom_cache_write(address, &data, sizeof(data)) : -1;
+}
+
+static int ring_buffer_info(void)
+{
+    const unsigned int reset = menu_read_uint("Reset statistics after reading (0/1): ");
+    rb_stats_t stats;
+    rbd_t rbd;
+
+    if (uart_rx_stats(&stats, (int) reset) == 0) {
+        format_printf("\nUART RX: peak %u/%u, puts %u, gets %u, drops %u",
+                      (unsigned int) stats.peak, (unsigned int) stats.size,
+                      stats.puts, stats.gets, stats.drops);
+    }
+
+    for (rbd = 0; rbd < RING_BUFFER_MAX; rbd++) {
+        /* Only descriptors which are in use report statistics */
+        if (ring_buffer_stats(rbd, &stats, (int) reset) == 0) {
+            format_printf("\nRing buffer %u: peak %u/%u, puts %u, gets %u, drops %u",
+                          (unsigned int) rbd, (unsigned int) stats.peak, (unsigned int) stats.size,
+                          stats.puts, stats.gets, stats.drops);
+        }
+    }
+
+    format_printf("\nArena: %u/%u\n", (unsigned int) ring_buffer_arena_used(),
+                  (unsigned int) RING_BUFFER_ARENA_SIZE);
+
+    return 0;
+}
+
+static int i2c_info(void)
+{
+    const unsigned int reset = menu_read_uint("Reset statistics after reading (0/1): ");
+    struct i2c_stats stats;
+    int err = i2c_get_stats(&stats, (int) reset);
 
     if (err == 0) {
-        uart_puts("\nData: ");
-        uart_puts(_uint_to_ascii(rx_data[0]));
-        uart_putchar('\n');
+        const uint32_t avg = (stats.completed > 0) ? (stats.latency_total_us / stats.completed) : 0;
+
+        format_printf("\nI2C bus: %lu Hz, EEPROM %lu Hz", (unsigned long) i2c_bus_hz(NULL),
+                      (unsigned long) i2c_bus_hz(&_eeprom.dev));
+        format_printf("\nI2C queue: depth %u, peak %u, completed %u, errors %u",
+                      stats.depth, stats.peak, stats.completed, stats.errors);
+        format_printf("\nLatency: max %lu us, avg %lu us\n",
+                      (unsigned long) stats.latency_max_us, (unsigned long) avg);
     }
 
     return err;
 }
 
-static int eeprom_write(void)
+static int eeprom_cache_info(void)
 {
-    int err;
-    struct i2c_device dev;
-    struct i2c_data data;    
-    uint8_t write_cmd[2];
+    const unsigned int reset = menu_read_uint("Reset statistics after reading (0/1): ");
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    unsigned int line;
+
+    for (line = 0; line < EEPROM_CACHE_LINES; line++) {
+        struct eeprom_cache_stats stats;
+
+        if (eeprom_cache_stats(line, &stats, (int) reset) == 0) {
+            format_printf("\nLine %u: page %u%s, hits %u, misses %u, writebacks %u", line,
+                          stats.page, (stats.valid != 0) ? "" : " (empty)",
+                          stats.hits, stats.misses, stats.writebacks);
+            hits += stats.hits;
+            misses += stats.misses;
+        }
+    }
 
-    dev.address = 0x50;
-    
-    write_cmd[0] = menu_read_uint("Enter the address to write: ");
-    write_cmd[1] = menu_read_uint("Enter the data to write: ");
+    format_printf("\nTotal: hits %u, misses %u\n", hits, misses);
 
-    data.tx_buf = write_cmd;
-    data.tx_len = ARRAY_SIZE(write_cmd);
-    data.rx_len = 0;
+    return 0;
+}
+
+static int binary_mode(void)
+{
+    uart_puts("Binary mode, send command 0x7F to exit\n");
+
+    /* Frames are binary, so disable the line editing */
+    uart_set_mode(UART_MODE_RAW);
+    proto_run(binary_cmds, ARRAY_SIZE(binary_cmds));
+    uart_set_mode(UART_MODE_LINE);
 
-    err = i2c_transfer(&dev, &data);
+    /* The main loop did not get to flush the EEPROM writes meanwhile */
+    return eeprom_cache_flush();
+}
+
+static int cmd_ping(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
+{
+    /* Echo the payload back, the response may share the request buffer */
+    memmove(rsp, req, req_len);
+    *rsp_len = req_len;
+
+    return 0;
+}
+
+static int cmd_set_blink_freq(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
+{
+    int err = -1;
+    IGNORE(rsp);
+    IGNORE(rsp_len);
+
+    /* Frequency in Hz, 16-bit little endian */
+    if (req_len == 2) {
+        const unsigned int value = req[0] | ((unsigned int) req[1] << 8);
+
+        err = blink_freq_update(value);
+    }
+
+    return err;
+}
+
+static int cmd_stopwatch(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
+{
+    int err = -1;
+    struct time time;
+    IGNORE(req);
+    IGNORE(req_len);
+
+    /* Respond with the captured seconds and milliseconds, 16-bit little endian */
+    if (timer_capture(&time) == 0) {
+        rsp[0] = time.sec & 0xFF;
+        rsp[1] = time.sec >> 8;
+        rsp[2] = time.ms & 0xFF;
+        rsp[3] = time.ms >> 8;
+        *rsp_len = 4;
+        err = 0;
+    }
 
     return err;
 }
 
-static char *_uint_to_ascii(unsigned int value)
+static int cmd_eeprom_read(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
 {
-    static char str[7];
-    char *ptr = &str[sizeof(str) - 1];
+    int err = -1;
 
-    /* NULL terminate the string */
-    *ptr = '\0';
+    /* Address followed by the number of bytes to read sequentially */
+    if ((req_len == 2) && (req[1] > 0) && (req[1] <= PROTO_MAX_PAYLOAD)) {
+        /* The data overwrites the request */
+        const uint8_t len = req[1];
 
-    do {
-        ptr--;
-        *ptr = (value % 10) + '0';
-        value /= 10;
-    } while (value > 0);
+        err = eeprom_cache_read(req[0], rsp, len);
 
-    return ptr;
+        if (err == 0) {
+            *rsp_len = len;
+        }
+    }
+
+    return err;
 }
 
+static int cmd_eeprom_write(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
+{
+    int err = -1;
+    IGNORE(rsp);
+    IGNORE(rsp_len);
+
+    /* Address followed by the data, below the settings store */
+    if ((req_len >= 2) && ((req[0] + req_len - 1) <= KV_BASE)) {
+        err = eeprom_cache_write(req[0], &req[1], req_len - 1);
+    }
+
+    return err;
+}
 
 __attribute__((interrupt(PORT1_VECTOR))) void port1_isr(void)
 {
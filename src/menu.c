@@ -41,6 +41,8 @@ static const struct menu_item *_current_menu = NULL;
 static size_t _current_menu_size = 0;
 
 static void display_menu(void);
+static int _read_selection(unsigned int *value) __attribute__((noinline));
+static unsigned int _parse_uint(const char *str);
 
 /**
  * \brief Initialize and display the current menu
@@ -57,26 +59,25 @@ void menu_init(const struct menu_item *menu, size_t count)
     _current_menu = menu;
     _current_menu_size = count;
 
+    /* Let the UART driver assemble and echo the input lines */
+    uart_set_mode(UART_MODE_LINE);
+
     display_menu();
 }
 
 /**
  * \brief Read user input and execute menu selection
+ *
+ * Returns immediately unless a complete line has been received.
  */
 void menu_run(void)
 {
-    static unsigned int value = 0;
-    int c = uart_getchar();
-
-    if ((c >= '0') && (c <= '9')) {
-        value *= 10;
-        value += c - '0';
-        uart_putchar(c);
-    } else if ((c == '\n') || (c == '\r')) {
+    unsigned int value;
+
+    if (_read_selection(&value) == 0) {
         if ((value > 0) && (value <= _current_menu_size)) {
             /* Invoke the callback */
             if (_current_menu[value - 1].handler != NULL) {
-                uart_puts("\n");
                 if (_current_menu[value - 1].handler() != 0) {
                     uart_puts("\nError\n");
                 }
@@ -86,12 +87,29 @@ void menu_run(void)
         }
 
         display_menu();
-        value = 0;
-    } else {
-       /* Not a valid character */ 
     }
 }
 
+/**
+ * \brief Parse the selection from a complete input line
+ * \param[out] value - the selection
+ * \return 0 if a line has been received, -1 otherwise
+ *
+ * Kept out of line so the line buffer is released before the handler runs
+ * and the deep handler call chains do not carry it on the stack.
+ */
+static int _read_selection(unsigned int *value)
+{
+    char line[UART_LINE_MAX + 1];
+
+    if (uart_getline(line, sizeof(line)) < 0) {
+        return -1;
+    }
+
+    *value = _parse_uint(line);
+
+    return 0;
+}
 
 /**
  * \brief Read an unsigned integer from the menu prompt
@@ -100,25 +118,32 @@ void menu_run(void)
  */
 unsigned int menu_read_uint(const char *prompt)
 {
-    unsigned int value = 0;
+    char line[UART_LINE_MAX + 1];
  
     uart_puts(prompt);
     
-    while (1) {
-        int c = uart_getchar();
-
+    /* Sleep until the line has been entered */
+    while (uart_getline(line, sizeof(line)) < 0) {
         watchdog_pet();
-     
-        if ((c >= '0') && (c <= '9')) {
-            value *= 10;
-            value += c - '0';
-            uart_putchar(c);
-        } else if ((c == '\n') || (c == '\r')) {
-            uart_puts("\n");
-            break;
-        } else {
-            /* Not a valid character */
-        }
+        uart_wait_line();
+    }
+
+    return _parse_uint(line);
+}
+
+/**
+ * \brief Parse the leading decimal digits of a line
+ * \param[in] str - the line
+ * \return the value of the digits, characters after the digits are ignored
+ */
+static unsigned int _parse_uint(const char *str)
+{
+    unsigned int value = 0;
+
+    while ((*str >= '0') && (*str <= '9')) {
+        /* 10x = 8x + 2x, avoids the software multiply */
+        value = (value << 3) + (value << 1) + (unsigned int) (*str - '0');
+        str++;
     }
 
     return value;
@@ -0,0 +1,187 @@
+/**
+ * \file proto.c
+ * \author Chris Karaplis
+ * \brief Binary command protocol
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "proto.h"
+#include "uart.h"
+#include "cobs.h"
+#include "crc16.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* Command ID and sequence number */
+#define PROTO_HEADER_LEN    2
+#define PROTO_CRC_LEN       2
+
+/* Largest unencoded packet, a response with a full payload */
+#define PROTO_RAW_MAX       (PROTO_HEADER_LEN + 1 + PROTO_MAX_PAYLOAD + PROTO_CRC_LEN)
+
+/* Largest encoded packet including the zero delimiter */
+#define PROTO_FRAME_MAX     (COBS_ENCODED_MAX(PROTO_RAW_MAX) + 1)
+
+/**
+ * Requests are received this far into the buffer, which lines the request
+ * payload up with the response payload and leaves a byte in front of the
+ * response to encode it in place
+ */
+#define PROTO_RX_OFFSET     2
+
+/* The response is encoded in place, which only works for a single COBS block */
+typedef char _proto_raw_max_invalid[(PROTO_RAW_MAX < 254) ? 1 : -1];
+
+/* Time to wait for data before checking again */
+#define PROTO_POLL_MS       500
+
+static int _process(const struct proto_cmd *cmds, size_t count, uint8_t *buf, size_t len);
+static int _dispatch(const struct proto_cmd *cmds, size_t count, uint8_t id, uint8_t *payload, size_t *len);
+
+/**
+ * \brief Run the binary protocol until the exit command is received
+ * \param[in] cmds - array of commands
+ * \param[in] count - number of commands
+ */
+void proto_run(const struct proto_cmd *cmds, size_t count)
+{
+    uint8_t buf[PROTO_RX_OFFSET + PROTO_FRAME_MAX];
+    uint8_t *const frame = &buf[PROTO_RX_OFFSET];
+    size_t fill = 0;
+    int discard = 0;
+    int running = 1;
+
+    while (running != 0) {
+        /* Accumulate encoded bytes up to the frame delimiter */
+        const int n = uart_read(&frame[fill], PROTO_FRAME_MAX - fill, PROTO_POLL_MS, 0);
+
+        if (n > 0) {
+            fill += n;
+
+            if (frame[fill - 1] == 0) {
+                if ((discard == 0) && (fill > 1)) {
+                    running = _process(cmds, count, buf, fill - 1);
+                }
+
+                fill = 0;
+                discard = 0;
+            } else if (fill == PROTO_FRAME_MAX) {
+                /* Too long to be valid, drop everything up to the next delimiter */
+                fill = 0;
+                discard = 1;
+            }
+        }
+    }
+}
+
+/**
+ * \brief Decode and execute a request, then send the response
+ * \param[in] cmds - array of commands
+ * \param[in] count - number of commands
+ * \param[in/out] buf - the encoded request from PROTO_RX_OFFSET, reused for the response
+ * \param[in] len - the length of the encoded request
+ * \return 0 if the exit command was received, 1 otherwise
+ *
+ * The request is decoded in place. The response header is written over
+ * the request header, so the handler finds the request payload where the
+ * response payload goes. The response starts at the second byte and is
+ * COBS encoded into the first, which only ever moves bytes backwards.
+ */
+static int _process(const struct proto_cmd *cmds, size_t count, uint8_t *buf, size_t len)
+{
+    uint8_t *const req = &buf[PROTO_RX_OFFSET];
+    int running = 1;
+    const int n = cobs_decode(req, len, req);
+
+    /* The CRC over the packet including its own CRC is zero if valid */
+    if ((n >= (PROTO_HEADER_LEN + PROTO_CRC_LEN)) && (n <= (PROTO_HEADER_LEN + PROTO_MAX_PAYLOAD + PROTO_CRC_LEN)) &&
+        (crc16(CRC16_INIT, req, n) == 0)) {
+        uint8_t *const rsp = &buf[1];
+        const uint8_t id = req[0];
+        size_t rsp_len = n - PROTO_HEADER_LEN - PROTO_CRC_LEN;
+        uint16_t crc;
+
+        /* Command ID and sequence number, the sequence number is moved down */
+        rsp[0] = id | 0x80;
+        rsp[1] = req[1];
+
+        if (id == PROTO_CMD_EXIT) {
+            rsp[2] = PROTO_STATUS_OK;
+            rsp_len = 0;
+            running = 0;
+        } else {
+            rsp[2] = _dispatch(cmds, count, id, &rsp[PROTO_HEADER_LEN + 1], &rsp_len);
+        }
+
+        rsp_len += PROTO_HEADER_LEN + 1;
+        crc = crc16(CRC16_INIT, rsp, rsp_len);
+        rsp[rsp_len++] = crc >> 8;
+        rsp[rsp_len++] = crc & 0xFF;
+
+        /* Encode the response one byte down and send it */
+        len = cobs_encode(rsp, rsp_len, buf);
+        buf[len++] = 0;
+        (void) uart_write_all(buf, len);
+    }
+
+    return running;
+}
+
+/**
+ * \brief Invoke the handler for a request
+ * \param[in] cmds - array of commands
+ * \param[in] count - number of commands
+ * \param[in] id - the command ID
+ * \param[in/out] payload - the request payload, replaced by the response payload
+ * \param[in/out] len - the length of the request payload, then of the response payload
+ * \return the response status code
+ */
+static int _dispatch(const struct proto_cmd *cmds, size_t count, uint8_t id, uint8_t *payload, size_t *len)
+{
+    int status = PROTO_STATUS_UNKNOWN;
+    const size_t req_len = *len;
+
+    *len = 0;
+
+    while (count-- > 0) {
+        if ((cmds->id == id) && (cmds->handler != NULL)) {
+            const int err = cmds->handler(payload, req_len, payload, len);
+
+            if (*len > PROTO_MAX_PAYLOAD) {
+                *len = PROTO_MAX_PAYLOAD;
+            }
+
+            status = (err == 0) ? PROTO_STATUS_OK : PROTO_STATUS_ERROR;
+            break;
+        }
+
+        cmds++;
+    }
+
+    return status;
+}
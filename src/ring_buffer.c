@@ -33,23 +33,104 @@
 #include "ring_buffer.h"
 #include <string.h>
 #include <stdint.h>
-#include <stdio.h>
 
-#define RING_BUFFER_MAX  1
+#ifdef __MSP430__
+#include <msp430.h>
+
+#define SR_ALLOC() uint16_t __sr
+#define ENTER_CRITICAL() __sr = _get_interrupt_state(); __disable_interrupt()
+#define EXIT_CRITICAL() __set_interrupt_state(__sr)
+#else
+/**
+ * Native builds (e.g. host side tools) have no interrupts to disable, so only
+ * a single producer and a single consumer with RB_DROP_NEWEST are supported
+ */
+#define SR_ALLOC()
+#define ENTER_CRITICAL()
+#define EXIT_CRITICAL()
+#endif
+
+#ifdef RING_BUFFER_ATOMIC
+#include <stdatomic.h>
+
+#ifndef RING_BUFFER_CACHE_LINE
+#define RING_BUFFER_CACHE_LINE 64
+#endif
+
+/**
+ * Multicore builds publish the indices with release stores and observe them
+ * with acquire loads, and keep the producer and consumer state on separate
+ * cache lines. Requires C11.
+ */
+#define RB_ALIGN _Alignas(RING_BUFFER_CACHE_LINE)
+#define RB_INDEX _Atomic size_t
+#define RB_LOAD(index) atomic_load_explicit(&(index), memory_order_acquire)
+#define RB_ADVANCE(index, count) \
+    atomic_store_explicit(&(index), atomic_load_explicit(&(index), memory_order_relaxed) + (count), \
+                          memory_order_release)
+
+/* Overwriting moves the tail from the producer, which is not SPSC safe */
+#define RB_POLICY_SUPPORTED(policy) ((policy) != RB_OVERWRITE_OLDEST)
+#else
+#define RB_ALIGN
+#define RB_INDEX volatile size_t
+#define RB_LOAD(index) (index)
+#define RB_ADVANCE(index, count) ((index) += (count))
+#define RB_POLICY_SUPPORTED(policy) 1
+#endif
 
 struct ring_buffer
 {
     size_t s_elem;
     size_t n_elem;
     uint8_t *buf;
-    volatile size_t head;
-    volatile size_t tail;
+    size_t arena_size;
+    rb_policy_t policy;
+    size_t high_water;
+    void (*callback)(void *);
+    void *arg;
+
+    /* Producer state */
+    RB_ALIGN RB_INDEX head;
+#ifdef RING_BUFFER_ATOMIC
+    size_t tail_cache;
+#endif
+    size_t peak;
+    unsigned int puts;
+    unsigned int drops;
+
+    /* Consumer state */
+    RB_ALIGN RB_INDEX tail;
+#ifdef RING_BUFFER_ATOMIC
+    size_t head_cache;
+#endif
+    unsigned int gets;
 };
 
 static struct ring_buffer _rb[RING_BUFFER_MAX];
 
-static int _ring_buffer_full(struct ring_buffer *rb);
-static int _ring_buffer_empty(struct ring_buffer *rb);
+#if RING_BUFFER_ARENA_SIZE > 0
+/* Backing storage for ring buffers initialized without a buffer */
+static union
+{
+    uint8_t mem[RING_BUFFER_ARENA_SIZE];
+    void *align;
+} _arena;
+
+static size_t _arena_used = 0;
+
+static void *_arena_alloc(size_t size);
+static void _arena_free(void *ptr, size_t size);
+#endif
+
+static size_t _ring_buffer_count(struct ring_buffer *rb);
+static size_t _ring_buffer_space(struct ring_buffer *rb, size_t count);
+static size_t _ring_buffer_available(struct ring_buffer *rb, size_t count);
+static void _ring_buffer_store(struct ring_buffer *rb, const void *data);
+static void _ring_buffer_load(struct ring_buffer *rb, void *data);
+static size_t _ring_buffer_write(struct ring_buffer *rb, const void *data, size_t count);
+static size_t _ring_buffer_read(struct ring_buffer *rb, void *data, size_t count);
+static void _ring_buffer_produced(struct ring_buffer *rb, size_t count, size_t added);
 
 /**
  * \brief Initialize a ring buffer
@@ -59,33 +140,98 @@ static int _ring_buffer_empty(struct ring_buffer *rb);
  *
  * The attributes must contain a ring buffer which is sized
  * to an even power of 2. This should be reflected by the
- * attribute n_elem.
+ * attribute n_elem. If the buffer is NULL, the memory is
+ * allocated from the ring buffer arena.
  */
 int ring_buffer_init(rbd_t *rbd, rb_attr_t *attr)
 {
-    static int idx = 0;
     int err = -1;
 
-    if ((idx < RING_BUFFER_MAX) && (rbd != NULL) && (attr != NULL)) {
-        if ((attr->buffer != NULL) && (attr->s_elem > 0)) {
-            /* Check that the size of the ring buffer is a power of 2 */
-            if (((attr->n_elem - 1) & attr->n_elem) == 0) {
-                /* Initialize the ring buffer internal variables */
-                _rb[idx].head = 0;
-                _rb[idx].tail = 0;
-                _rb[idx].buf = attr->buffer;
-                _rb[idx].s_elem = attr->s_elem;
-                _rb[idx].n_elem = attr->n_elem;
+    if ((rbd != NULL) && (attr != NULL) && (attr->s_elem > 0) && (attr->n_elem > 0) &&
+        RB_POLICY_SUPPORTED(attr->policy)) {
+        /* Check that the size of the ring buffer is a power of 2 */
+        if (((attr->n_elem - 1) & attr->n_elem) == 0) {
+            size_t i;
+
+            /* Find a free descriptor */
+            for (i = 0; i < RING_BUFFER_MAX; i++) {
+                if (_rb[i].buf == NULL) {
+                    break;
+                }
+            }
+
+            if (i < RING_BUFFER_MAX) {
+                uint8_t *buf = attr->buffer;
+                size_t arena_size = 0;
+
+#if RING_BUFFER_ARENA_SIZE > 0
+                /* Carve the memory out of the arena if none was provided */
+                if (buf == NULL) {
+                    arena_size = attr->s_elem * attr->n_elem;
+                    buf = _arena_alloc(arena_size);
+                }
+#endif
+
+                if (buf != NULL) {
+                    /* Initialize the ring buffer internal variables */
+                    memset(&_rb[i], 0, sizeof(_rb[i]));
+                    _rb[i].buf = buf;
+                    _rb[i].arena_size = arena_size;
+                    _rb[i].s_elem = attr->s_elem;
+                    _rb[i].n_elem = attr->n_elem;
+                    _rb[i].policy = attr->policy;
+                    _rb[i].high_water = attr->high_water;
+                    _rb[i].callback = attr->callback;
+                    _rb[i].arg = attr->arg;
+
+                    *rbd = i;
+                    err = 0;
+                }
+            }
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Deinitialize a ring buffer and release the descriptor
+ * \param[in] rbd - the ring buffer descriptor
+ * \return 0 on success, -1 otherwise
+ *
+ * Memory allocated from the arena is returned only if it is the most
+ * recent allocation, otherwise it remains committed.
+ */
+int ring_buffer_deinit(rbd_t rbd)
+{
+    int err = -1;
 
-                *rbd = idx++;
-                err= 0;
-            } 
+    if ((rbd < RING_BUFFER_MAX) && (_rb[rbd].buf != NULL)) {
+#if RING_BUFFER_ARENA_SIZE > 0
+        if (_rb[rbd].arena_size > 0) {
+            _arena_free(_rb[rbd].buf, _rb[rbd].arena_size);
         }
+#endif
+        memset(&_rb[rbd], 0, sizeof(_rb[rbd]));
+        err = 0;
     }
 
     return err;
 }
 
+/**
+ * \brief Get the number of bytes committed from the ring buffer arena
+ * \return the number of bytes in use, including alignment padding
+ */
+size_t ring_buffer_arena_used(void)
+{
+#if RING_BUFFER_ARENA_SIZE > 0
+    return _arena_used;
+#else
+    return 0;
+#endif
+}
+
 /**
  * \brief Add an element to the ring buffer
  * \param[in] rbd - the ring buffer descriptor
@@ -94,14 +240,36 @@ int ring_buffer_init(rbd_t *rbd, rb_attr_t *attr)
  */
 int ring_buffer_put(rbd_t rbd, const void *data)
 {
-    int err = 0;
+    int err = -1;
 
-    if ((rbd < RING_BUFFER_MAX) && (_ring_buffer_full(&_rb[rbd]) == 0)) {
-        const size_t offset = (_rb[rbd].head & (_rb[rbd].n_elem - 1)) * _rb[rbd].s_elem;
-        memcpy(&(_rb[rbd].buf[offset]), data, _rb[rbd].s_elem);
-        _rb[rbd].head++;
-    } else {
-        err = -1;
+    if (rbd < RING_BUFFER_MAX) {
+        struct ring_buffer *rb = &_rb[rbd];
+        const size_t count = rb->n_elem - _ring_buffer_space(rb, 1);
+
+        if (rb->policy == RB_OVERWRITE_OLDEST) {
+            SR_ALLOC();
+            ENTER_CRITICAL();
+
+            /* Discard the oldest element to make room for the new one */
+            if (_ring_buffer_space(rb, 1) == 0) {
+                RB_ADVANCE(rb->tail, 1);
+                rb->drops++;
+            }
+
+            _ring_buffer_store(rb, data);
+
+            EXIT_CRITICAL();
+            err = 0;
+        } else if (count < rb->n_elem) {
+            _ring_buffer_store(rb, data);
+            err = 0;
+        } else {
+            rb->drops++;
+        }
+
+        if (err == 0) {
+            _ring_buffer_produced(rb, count, 1);
+        }
     }
 
     return err;
@@ -115,26 +283,468 @@ int ring_buffer_put(rbd_t rbd, const void *data)
  */
 int ring_buffer_get(rbd_t rbd, void *data)
 {
-    int err = 0;
+    int err = -1;
 
-    if ((rbd < RING_BUFFER_MAX) && (_ring_buffer_empty(&_rb[rbd]) == 0)) {
-        const size_t offset = (_rb[rbd].tail & (_rb[rbd].n_elem - 1)) * _rb[rbd].s_elem;
-        memcpy(data, &(_rb[rbd].buf[offset]), _rb[rbd].s_elem);
-        _rb[rbd].tail++;
-    } else {
-        err = -1;
+    if (rbd < RING_BUFFER_MAX) {
+        struct ring_buffer *rb = &_rb[rbd];
+
+        if (rb->policy == RB_OVERWRITE_OLDEST) {
+            SR_ALLOC();
+
+            /* The producer may move the tail, so read it atomically */
+            ENTER_CRITICAL();
+
+            if (_ring_buffer_available(rb, 1) > 0) {
+                _ring_buffer_load(rb, data);
+                err = 0;
+            }
+
+            EXIT_CRITICAL();
+        } else if (_ring_buffer_available(rb, 1) > 0) {
+            _ring_buffer_load(rb, data);
+            err = 0;
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Add multiple elements to the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[in] data - the elements to add
+ * \param[in] count - the number of elements to add
+ * \return the number of elements added
+ *
+ * The elements are copied in at most two blocks, one up to the end of
+ * the buffer memory and one from the start of it if the write wraps.
+ */
+size_t ring_buffer_write(rbd_t rbd, const void *data, size_t count)
+{
+    size_t written = 0;
+
+    if (rbd < RING_BUFFER_MAX) {
+        struct ring_buffer *rb = &_rb[rbd];
+
+        if (rb->policy == RB_OVERWRITE_OLDEST) {
+            SR_ALLOC();
+
+            /* The oldest elements are discarded atomically with respect to the consumer */
+            ENTER_CRITICAL();
+            written = _ring_buffer_write(rb, data, count);
+            EXIT_CRITICAL();
+        } else {
+            written = _ring_buffer_write(rb, data, count);
+        }
+    }
+
+    return written;
+}
+
+/**
+ * \brief Get (and remove) multiple elements from the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] data - pointer to store the elements
+ * \param[in] count - the maximum number of elements to get
+ * \return the number of elements read
+ *
+ * The elements are copied out in at most two blocks, one up to the end of
+ * the buffer memory and one from the start of it if the read wraps.
+ */
+size_t ring_buffer_read(rbd_t rbd, void *data, size_t count)
+{
+    size_t read = 0;
+
+    if (rbd < RING_BUFFER_MAX) {
+        struct ring_buffer *rb = &_rb[rbd];
+
+        if (rb->policy == RB_OVERWRITE_OLDEST) {
+            SR_ALLOC();
+
+            /* The producer may move the tail, so read it atomically */
+            ENTER_CRITICAL();
+            read = _ring_buffer_read(rb, data, count);
+            EXIT_CRITICAL();
+        } else {
+            read = _ring_buffer_read(rb, data, count);
+        }
+    }
+
+    return read;
+}
+
+/**
+ * \brief Get the number of elements in the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \return the number of elements available to read
+ */
+size_t ring_buffer_count(rbd_t rbd)
+{
+    return (rbd < RING_BUFFER_MAX) ? _ring_buffer_count(&_rb[rbd]) : 0;
+}
+
+/**
+ * \brief Get the free space in the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \return the number of elements which can be added
+ */
+size_t ring_buffer_space(rbd_t rbd)
+{
+    size_t space = 0;
+
+    if (rbd < RING_BUFFER_MAX) {
+        space = _rb[rbd].n_elem - _ring_buffer_count(&_rb[rbd]);
+    }
+
+    return space;
+}
+
+/**
+ * \brief Reserve contiguous space in the ring buffer for writing in place
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] data - pointer to the start of the reserved space
+ * \param[in] count - the maximum number of elements to reserve
+ * \return the number of contiguous elements reserved
+ */
+size_t ring_buffer_reserve(rbd_t rbd, void **data, size_t count)
+{
+    size_t reserved = 0;
+
+    if ((rbd < RING_BUFFER_MAX) && (data != NULL) && (_rb[rbd].policy != RB_OVERWRITE_OLDEST)) {
+        struct ring_buffer *rb = &_rb[rbd];
+        const size_t offset = rb->head & (rb->n_elem - 1);
+        const size_t space = _ring_buffer_space(rb, count);
+
+        /* Limit the span to the free space before the wrap point */
+        reserved = rb->n_elem - offset;
+
+        if (reserved > space) {
+            reserved = space;
+        }
+
+        if (reserved > count) {
+            reserved = count;
+        }
+
+        *data = &(rb->buf[offset * rb->s_elem]);
+    }
+
+    return reserved;
+}
+
+/**
+ * \brief Commit elements written in place to the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[in] count - the number of elements to commit
+ * \return 0 on success, -1 otherwise
+ */
+int ring_buffer_commit(rbd_t rbd, size_t count)
+{
+    int err = -1;
+
+    if ((rbd < RING_BUFFER_MAX) && (_rb[rbd].policy != RB_OVERWRITE_OLDEST)) {
+        struct ring_buffer *rb = &_rb[rbd];
+        const size_t space = _ring_buffer_space(rb, count);
+
+        if (count <= space) {
+            RB_ADVANCE(rb->head, count);
+            _ring_buffer_produced(rb, rb->n_elem - space, count);
+            err = 0;
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Peek at the contiguous elements at the front of the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] data - pointer to the first element
+ * \return the number of contiguous elements which can be read in place
+ */
+size_t ring_buffer_peek(rbd_t rbd, void **data)
+{
+    size_t available = 0;
+
+    if ((rbd < RING_BUFFER_MAX) && (data != NULL)) {
+        struct ring_buffer *rb = &_rb[rbd];
+        const size_t offset = rb->tail & (rb->n_elem - 1);
+        const size_t used = _ring_buffer_available(rb, rb->n_elem);
+
+        /* Limit the span to the elements before the wrap point */
+        available = rb->n_elem - offset;
+
+        if (available > used) {
+            available = used;
+        }
+
+        *data = &(rb->buf[offset * rb->s_elem]);
+    }
+
+    return available;
+}
+
+/**
+ * \brief Remove elements from the front of the ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[in] count - the number of elements to remove
+ * \return 0 on success, -1 otherwise
+ */
+int ring_buffer_consume(rbd_t rbd, size_t count)
+{
+    int err = -1;
+
+    if (rbd < RING_BUFFER_MAX) {
+        SR_ALLOC();
+        ENTER_CRITICAL();
+
+        /* Checked atomically in case the producer is overwriting */
+        if (count <= _ring_buffer_available(&_rb[rbd], count)) {
+            RB_ADVANCE(_rb[rbd].tail, count);
+            _rb[rbd].gets += count;
+            err = 0;
+        }
+
+        EXIT_CRITICAL();
+    }
+
+    return err;
+}
+
+/**
+ * \brief Get the usage statistics of a ring buffer
+ * \param[in] rbd - the ring buffer descriptor
+ * \param[out] stats - the statistics structure to fill
+ * \param[in] reset - non-zero to reset the statistics once read
+ * \return 0 on success, -1 otherwise
+ */
+int ring_buffer_stats(rbd_t rbd, rb_stats_t *stats, int reset)
+{
+    int err = -1;
+
+    if ((rbd < RING_BUFFER_MAX) && (_rb[rbd].buf != NULL) && (stats != NULL)) {
+        struct ring_buffer *rb = &_rb[rbd];
+        SR_ALLOC();
+
+        /* Take a consistent snapshot with respect to an ISR producer */
+        ENTER_CRITICAL();
+
+        stats->size = rb->n_elem;
+        stats->peak = rb->peak;
+        stats->puts = rb->puts;
+        stats->gets = rb->gets;
+        stats->drops = rb->drops;
+
+        if (reset != 0) {
+            rb->peak = _ring_buffer_count(rb);
+            rb->puts = 0;
+            rb->gets = 0;
+            rb->drops = 0;
+        }
+
+        EXIT_CRITICAL();
+        err = 0;
     }
 
     return err;
 }
 
-static int _ring_buffer_full(struct ring_buffer *rb)
+static size_t _ring_buffer_count(struct ring_buffer *rb)
+{
+    return (RB_LOAD(rb->head) - RB_LOAD(rb->tail));
+}
+
+static size_t _ring_buffer_space(struct ring_buffer *rb, size_t count)
+{
+#ifdef RING_BUFFER_ATOMIC
+    const size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+    /* Only reload the consumer's index if the cached copy shows too little space */
+    if ((rb->n_elem - (head - rb->tail_cache)) < count) {
+        rb->tail_cache = RB_LOAD(rb->tail);
+    }
+
+    return rb->n_elem - (head - rb->tail_cache);
+#else
+    (void) count;
+    return rb->n_elem - (rb->head - rb->tail);
+#endif
+}
+
+static size_t _ring_buffer_available(struct ring_buffer *rb, size_t count)
+{
+#ifdef RING_BUFFER_ATOMIC
+    const size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+    /* Only reload the producer's index if the cached copy shows too few elements */
+    if ((rb->head_cache - tail) < count) {
+        rb->head_cache = RB_LOAD(rb->head);
+    }
+
+    return rb->head_cache - tail;
+#else
+    (void) count;
+    return (rb->head - rb->tail);
+#endif
+}
+
+static void _ring_buffer_store(struct ring_buffer *rb, const void *data)
+{
+    const size_t idx = rb->head & (rb->n_elem - 1);
+
+    /* Byte sized elements are stored directly without scaling the index */
+    if (rb->s_elem == 1) {
+        rb->buf[idx] = *((const uint8_t *) data);
+    } else {
+        memcpy(&(rb->buf[idx * rb->s_elem]), data, rb->s_elem);
+    }
+
+    RB_ADVANCE(rb->head, 1);
+}
+
+static void _ring_buffer_load(struct ring_buffer *rb, void *data)
+{
+    const size_t idx = rb->tail & (rb->n_elem - 1);
+
+    /* Byte sized elements are loaded directly without scaling the index */
+    if (rb->s_elem == 1) {
+        *((uint8_t *) data) = rb->buf[idx];
+    } else {
+        memcpy(data, &(rb->buf[idx * rb->s_elem]), rb->s_elem);
+    }
+
+    RB_ADVANCE(rb->tail, 1);
+    rb->gets++;
+}
+
+static size_t _ring_buffer_write(struct ring_buffer *rb, const void *data, size_t count)
+{
+    const uint8_t *src = data;
+    const size_t space = _ring_buffer_space(rb, count);
+    size_t written = count;
+
+    if (count > space) {
+        rb->drops += count - space;
+
+        if (rb->policy == RB_OVERWRITE_OLDEST) {
+            /* Skip the elements which the newer ones would overwrite straight away */
+            if (count > rb->n_elem) {
+                src = &src[(count - rb->n_elem) * rb->s_elem];
+                rb->puts += count - rb->n_elem;
+                count = rb->n_elem;
+            }
+
+            /* Discard the oldest elements to make room for the rest */
+            RB_ADVANCE(rb->tail, count - space);
+        } else {
+            count = space;
+            written = space;
+        }
+    }
+
+    if (count > 0) {
+        const size_t offset = rb->head & (rb->n_elem - 1);
+        size_t chunk = rb->n_elem - offset;
+
+        if (chunk > count) {
+            chunk = count;
+        }
+
+        /* Copy up to the end of the buffer, then the wrapped remainder */
+        memcpy(&(rb->buf[offset * rb->s_elem]), src, chunk * rb->s_elem);
+        memcpy(rb->buf, &src[chunk * rb->s_elem], (count - chunk) * rb->s_elem);
+
+        /* Publish all the elements at once */
+        RB_ADVANCE(rb->head, count);
+
+        _ring_buffer_produced(rb, rb->n_elem - space, count);
+    }
+
+    return written;
+}
+
+static size_t _ring_buffer_read(struct ring_buffer *rb, void *data, size_t count)
+{
+    const size_t used = _ring_buffer_available(rb, count);
+
+    if (count > used) {
+        count = used;
+    }
+
+    if (count > 0) {
+        uint8_t *dst = data;
+        const size_t offset = rb->tail & (rb->n_elem - 1);
+        size_t chunk = rb->n_elem - offset;
+
+        if (chunk > count) {
+            chunk = count;
+        }
+
+        /* Copy up to the end of the buffer, then the wrapped remainder */
+        memcpy(dst, &(rb->buf[offset * rb->s_elem]), chunk * rb->s_elem);
+        memcpy(&dst[chunk * rb->s_elem], rb->buf, (count - chunk) * rb->s_elem);
+
+        /* Release all the elements at once */
+        RB_ADVANCE(rb->tail, count);
+        rb->gets += count;
+    }
+
+    return count;
+}
+
+static void _ring_buffer_produced(struct ring_buffer *rb, size_t count, size_t added)
 {
-    return ((rb->head - rb->tail) == rb->n_elem) ? 1 : 0;
+    size_t used;
+
+#ifdef RING_BUFFER_ATOMIC
+    /**
+     * The cached tail lags the consumer and overstates the occupancy, which
+     * only matters for space checks when it runs short. The statistics need
+     * the current tail, and the occupancy before the elements were added
+     * follows from it rather than from the caller's stale count.
+     */
+    rb->tail_cache = RB_LOAD(rb->tail);
+    used = rb->n_elem - _ring_buffer_space(rb, 0);
+    count = (used > added) ? (used - added) : 0;
+#else
+    used = rb->n_elem - _ring_buffer_space(rb, 0);
+#endif
+
+    rb->puts += added;
+
+    if (used > rb->peak) {
+        rb->peak = used;
+    }
+
+    /* Notify the producer when the occupancy crosses the high water mark */
+    if ((rb->callback != NULL) && (count < rb->high_water) && (used >= rb->high_water)) {
+        rb->callback(rb->arg);
+    }
 }
 
-static int _ring_buffer_empty(struct ring_buffer *rb)
+#if RING_BUFFER_ARENA_SIZE > 0
+static void *_arena_alloc(size_t size)
 {
-    return ((rb->head - rb->tail) == 0U) ? 1 : 0;
+    void *ptr = NULL;
+
+    /* Round up so that the next allocation remains aligned */
+    size = (size + sizeof(_arena.align) - 1) & ~(sizeof(_arena.align) - 1);
+
+    if (size <= (sizeof(_arena.mem) - _arena_used)) {
+        ptr = &_arena.mem[_arena_used];
+        _arena_used += size;
+    }
+
+    return ptr;
 }
 
+static void _arena_free(void *ptr, size_t size)
+{
+    size = (size + sizeof(_arena.align) - 1) & ~(sizeof(_arena.align) - 1);
+
+    /* Only the top of the arena can be returned */
+    if ((uint8_t *) ptr + size == &_arena.mem[_arena_used]) {
+        _arena_used -= size;
+    }
+}
+#endif
@@ -34,7 +34,9 @@
 #include <string.h>
 #include <msp430.h>
 
+#ifndef MAX_TIMERS
 #define MAX_TIMERS  10
+#endif
 #define TIMER_RESOLUTION_MS    100
 
 #define SR_ALLOC() uint16_t __sr
@@ -51,6 +53,7 @@ struct timer
 
 static struct timer _timer[MAX_TIMERS];
 static volatile uint16_t _timer_tick = 0;
+static volatile uint32_t _timer_us = 0;
 static volatile uint16_t _capture_tick = 0;
 static volatile uint16_t _capture_ta1ccr1 = 0;
 static volatile int _capture_flag = 0;
@@ -96,7 +99,12 @@ int timer_init(void)
 int timer_create(uint16_t timeout_ms, int periodic, void (*callback)(void *), void *arg)
 {
     int handle = -1;
+    const uint16_t ticks = (timeout_ms < TIMER_RESOLUTION_MS) ? 1 : (timeout_ms / TIMER_RESOLUTION_MS);
     size_t i;
+    SR_ALLOC();
+
+    /* Timers are also created from interrupts, so claim the slot atomically */
+    ENTER_CRITICAL();
 
     /* Find a free timer */
     for (i = 0; i < MAX_TIMERS; i++) {
@@ -107,24 +115,22 @@ int timer_create(uint16_t timeout_ms, int periodic, void (*callback)(void *), vo
 
     /* Make sure a valid timer is found */
     if (i < MAX_TIMERS) {
-        SR_ALLOC();
-        ENTER_CRITICAL();
-
         /* Set up the timer */
         if (periodic != 0) {
-            _timer[i].periodic = (timeout_ms < 100) ? 1 : (timeout_ms / TIMER_RESOLUTION_MS);
+            _timer[i].periodic = ticks;
         } else {
             _timer[i].periodic = 0;
         }
 
         _timer[i].callback = callback;
         _timer[i].arg = arg;
-        _timer[i].expiry = _timer_tick + _timer[i].periodic; 
+        _timer[i].expiry = _timer_tick + ticks;
 
-        EXIT_CRITICAL();
         handle = i;
     } 
 
+    EXIT_CRITICAL();
+
     return handle;
 }
 
@@ -137,7 +143,7 @@ int timer_delete(int handle)
 {
     int status = -1;
 
-    if (handle < MAX_TIMERS) {
+    if ((handle >= 0) && (handle < MAX_TIMERS)) {
         SR_ALLOC();
         ENTER_CRITICAL();
 
@@ -192,6 +198,32 @@ int timer_capture(struct time *time)
     return err;
 }
 
+/**
+ * \brief Get a microsecond timestamp
+ * \return the time since the timer module was initialized in us
+ */
+uint32_t timer_timestamp_us(void)
+{
+    uint32_t us;
+    uint16_t count;
+    SR_ALLOC();
+
+    ENTER_CRITICAL();
+
+    us = _timer_us;
+    count = TA1R;
+
+    /* The counter has wrapped but the tick interrupt has not been handled yet */
+    if ((TA1CCTL0 & CCIFG) && (count < (TA1CCR0 >> 1))) {
+        us += TIMER_RESOLUTION_MS * 1000UL;
+    }
+
+    EXIT_CRITICAL();
+
+    /* Each count is 2us */
+    return us + ((uint32_t) count << 1);
+}
+
 __attribute__((interrupt(TIMER1_A0_VECTOR))) void timer1_isr(void)
 {
     size_t i;
@@ -202,6 +234,9 @@ __attribute__((interrupt(TIMER1_A0_VECTOR))) void timer1_isr(void)
     /* Increment the timer tick */ 
     _timer_tick++;
 
+    /* Free running us count of timer_timestamp_us(), wraps modulo 2^32 */
+    _timer_us += TIMER_RESOLUTION_MS * 1000UL;
+
     for (i = 0; i < MAX_TIMERS; i++) {
         /* If the timer is enabled and expired, invoke the callback */
         if ((_timer[i].callback != NULL) && (_timer[i].expiry == _timer_tick)) {
@@ -216,6 +251,9 @@ __attribute__((interrupt(TIMER1_A0_VECTOR))) void timer1_isr(void)
             }
         }
     }
+
+    /* Wake the main loop every tick so it can service its own events */
+    __bic_SR_register_on_exit(LPM0_bits);
 }
 
 __attribute__((interrupt(TIMER1_A1_VECTOR))) void timer1_taiv_isr(void)
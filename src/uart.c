@@ -31,33 +31,115 @@
  */
 
 #include "uart.h"
+#include "board.h"
+#include "timer.h"
+#include "watchdog.h"
 #include "defines.h"
 #include "ring_buffer.h"
+#include "usci.h"
 #include <stdint.h>
 #include <stddef.h>
 #include <msp430.h>
 
+/* Maximum acceptable baud rate error in tenths of a percent */
+#define UART_BAUD_MAX_ERROR 20
+
+/* Falling edges of the sync character 'U' (0x55), spanning 8 bit times */
+#define UART_SYNC_EDGES         5
+#define UART_SYNC_BITS_SHIFT    3
+
+/* Standard baud rates a detected baud rate is rounded to */
+static const uint32_t _baud_rates[] = {1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200};
+
 struct baud_value
 {
-    uint32_t baud;
-    uint16_t UCAxBR0;
-    uint16_t UCAxBR1;
-    uint16_t UCAxMCTL;
+    uint16_t UCAxBR;
+    uint8_t UCAxMCTL;
+    int error;
 };
 
-/* Table of baud rate register values from reference manual (SLAU144) */
-static const struct baud_value _baud_tbl[] = {
-    {9600, 104, 0, 0x2}
-};
+/* Critical section management */
+#define SR_ALLOC() uint16_t __sr
+#define ENTER_CRITICAL() __sr = _get_interrupt_state(); __disable_interrupt()
+#define EXIT_CRITICAL() __set_interrupt_state(__sr)
 
-/* RX ring bufer */
-static rbd_t _rbd;
-static char _rbmem[8];
+/**
+ * RX ring bufer, large enough to hold type-ahead of complete lines. It is
+ * specialized for chars so that the RX ISR stores a byte in a few instructions.
+ */
+#define UART_RX_BUFFER_SIZE 32
+RING_BUFFER_DEFINE(_rx, char, UART_RX_BUFFER_SIZE)
+
+/* RX ring buffer statistics, the free running indices count puts and gets */
+static size_t _rx_peak = 0;
+static unsigned int _rx_drops = 0;
+static size_t _rx_puts_base = 0;
+static size_t _rx_gets_base = 0;
+
+/**
+ * Length of the line being edited. The line is assembled in the free space
+ * of the RX ring buffer, after its head, and committed once complete.
+ */
+static size_t _line_len = 0;
+static volatile unsigned int _lines = 0;
+static volatile uart_mode_t _mode = UART_MODE_RAW;
+
+/* Echo of the line editing, sent by the TX ISR ahead of the TX ring buffer */
+RING_BUFFER_DEFINE(_echo, char, 8)
+
+/* TX ring buffer, taken from the ring buffer arena */
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 32
+#endif
+static rbd_t _tx_rbd;
+
+/* Flow control thresholds of the RX ring buffer */
+#define UART_RX_HIGH_WATER  ((UART_RX_BUFFER_SIZE * 3) / 4)
+#define UART_RX_LOW_WATER   (UART_RX_BUFFER_SIZE / 4)
+
+/* Time to wait for the TX ISR to make progress before giving up */
+#define UART_TX_TIMEOUT_MS  500
+
+/* Software flow control characters */
+#define UART_XON    0x11
+#define UART_XOFF   0x13
+
+/* Hardware flow control pins on port 2, both active low */
+#define UART_RTS_PIN    BIT0
+#define UART_CTS_PIN    BIT1
+
+static uart_flow_t _flow = UART_FLOW_NONE;
+static volatile int _rx_stopped = 0;
+static volatile int _tx_xoff = 0;
+static volatile char _flow_char = 0;
+
+/* Set while the main loop sleeps in _tx_wait(), so that the TX ISR wakes it */
+static volatile int _tx_waiting = 0;
+
+static int _tx_wait(void);
+static size_t _tx_queued(void);
+static void _flow_init(void);
+static void _rx_stored(void);
+static void _flow_rx_stop(void);
+static void _flow_rx_resume(void);
+static int _flow_tx_paused(void);
+static int _line_input(char c);
+static void _line_echo(const char *str, size_t len);
+static uint32_t _baud_detect(uint32_t clk);
+static uint32_t _baud_measure(uint32_t clk);
+static int _baud_expired(uint16_t start, uint16_t count);
+static int _baud_compute(uint32_t clk, uint32_t baud, struct baud_value *value);
+static int _baud_error(uint32_t clk, uint32_t baud, uint32_t divider);
 
 /**
  * \brief Initialize the UART peripheral
  * \param[in] config - the UART configuration
  * \return 0 on success, -1 otherwise
+ *
+ * The baud rate registers are computed from the current SMCLK frequency.
+ * The resulting baud rate error is stored in the configuration and the
+ * baud rate is rejected if the error is too large. A baud rate of
+ * UART_BAUD_AUTO is detected first and replaced with the detected rate.
  */
 int uart_init(uart_config_t *config)
 {
@@ -65,32 +147,37 @@ int uart_init(uart_config_t *config)
 
     /* USCI should be in reset before configuring - only configure once */
     if (UCA0CTL1 & UCSWRST) {
-        size_t i;
+        struct baud_value value;
 
         /* Set clock source to SMCLK */
         UCA0CTL1 |= UCSSEL_2;
 
-        /* Find the settings from the baud rate table */
-        for (i = 0; i < ARRAY_SIZE(_baud_tbl); i++) {
-            if (_baud_tbl[i].baud == config->baud) {
-                break;
-            }
+        if (config->baud == UART_BAUD_AUTO) {
+            config->baud = _baud_detect(board_get_smclk());
         }
 
-        if (i < ARRAY_SIZE(_baud_tbl)) {
-            rb_attr_t attr = {sizeof(_rbmem[0]), ARRAY_SIZE(_rbmem), _rbmem};
+        /* Calculate the baud rate register values */
+        if (_baud_compute(board_get_smclk(), config->baud, &value) == 0) {
+            rb_attr_t tx_attr = {sizeof(char), UART_TX_BUFFER_SIZE, NULL, RB_DROP_NEWEST, 0, NULL, NULL};
 
             /* Set the baud rate */
-            UCA0BR0 = _baud_tbl[i].UCAxBR0;
-            UCA0BR1 = _baud_tbl[i].UCAxBR1;
-            UCA0MCTL = _baud_tbl[i].UCAxMCTL;
-                           
-            /* Initialize the ring buffer */
-            if (ring_buffer_init(&_rbd, &attr) == 0) {                 
+            UCA0BR0 = value.UCAxBR & 0xFF;
+            UCA0BR1 = value.UCAxBR >> 8;
+            UCA0MCTL = value.UCAxMCTL;
+            config->error = value.error;
+
+            _flow = config->flow;
+            _flow_init();
+
+            /* Initialize the TX ring buffer */
+            if (ring_buffer_init(&_tx_rbd, &tx_attr) == 0) {
                 /* Enable the USCI peripheral (take it out of reset) */
                 UCA0CTL1 &= ~UCSWRST;
 
-                /* Enable rx interrupts */
+                /**
+                 * Enable rx interrupts. The tx interrupt is only enabled
+                 * while there is data queued for transmission
+                 */
                 IE2 |= UCA0RXIE;
 
                 status = 0;
@@ -101,6 +188,30 @@ int uart_init(uart_config_t *config)
     return status;
 }
 
+/**
+ * \brief Set the receive mode
+ * \param[in] mode - the receive mode
+ *
+ * Any received data which has not been read yet is discarded.
+ */
+void uart_set_mode(uart_mode_t mode)
+{
+    char c;
+    SR_ALLOC();
+
+    ENTER_CRITICAL();
+
+    _mode = mode;
+    _line_len = 0;
+    _lines = 0;
+
+    while (_rx_get(&c) == 0);
+
+    EXIT_CRITICAL();
+
+    _flow_rx_resume();
+}
+
 /**
  * \brief Read a character from UART
  * \return the character read on success, -1 if nothing was read
@@ -110,32 +221,98 @@ int uart_getchar(void)
     int retval = -1;
     char c = -1;
     
-    if (ring_buffer_get(_rbd, &c) == 0) {
-        retval = (int) c;
+    if (_rx_get(&c) == 0) {
+        retval = (int) ((uint8_t) c);
+
+        _flow_rx_resume();
+
+        /* Reading the line-feed consumes the line */
+        if ((_mode == UART_MODE_LINE) && (c == '\n')) {
+            SR_ALLOC();
+
+            ENTER_CRITICAL();
+            _lines--;
+            EXIT_CRITICAL();
+        }
     }
 
     return retval;
 }
 
+/**
+ * \brief Read a complete line from UART
+ * \param[out] buf - the buffer to store the line
+ * \param[in] len - the size of the buffer
+ * \return the length of the line on success, -1 if no line is ready
+ */
+int uart_getline(char *buf, size_t len)
+{
+    int status = -1;
+
+    if ((buf != NULL) && (len > 0) && (_mode == UART_MODE_LINE) && (_lines > 0)) {
+        size_t count = 0;
+        int c;
+
+        /* The line is complete, but never spin if the buffer runs dry */
+        while (((c = uart_getchar()) >= 0) && (c != '\n')) {
+            if (count < (len - 1)) {
+                buf[count++] = (char) c;
+            }
+        }
+
+        buf[count] = '\0';
+        status = (int) count;
+    }
+
+    return status;
+}
+
+/**
+ * \brief Get the number of complete lines waiting to be read
+ * \return the number of lines
+ */
+unsigned int uart_line_ready(void)
+{
+    return _lines;
+}
+
+/**
+ * \brief Sleep until a line is ready or another interrupt wakes the CPU
+ */
+void uart_wait_line(void)
+{
+    /* Check with interrupts disabled so a line cannot complete unnoticed */
+    __disable_interrupt();
+
+    if (_lines == 0) {
+        /* Enter LPM0 and enable interrupts atomically */
+        __bis_SR_register(LPM0_bits | GIE);
+    } else {
+        __enable_interrupt();
+    }
+}
+
 /**
  * \brief Write a character to UART
  * \param[in] c - the character to write
  * \return 0 on sucess, -1 otherwise
+ *
+ * The character is queued for transmission. This only blocks if the
+ * transmit buffer is full.
  */
 int uart_putchar(int c)
 {
-    /* Wait for the transmit buffer to be ready */
-    while (!(IFG2 & UCA0TXIFG));
+    const char tx = (char) c;
 
-    /* Transmit data */
-    UCA0TXBUF = (char ) c; 
-    
-    return 0;
+    return (uart_write_all(&tx, sizeof(tx)) == sizeof(tx)) ? 0 : -1;
 }
 
 /**
  * \brief Write a string to UART
- * \return 0 on sucesss, -1 otherwise
+ * \return the number of bytes queued on success, -1 otherwise
+ *
+ * Line-feeds are followed by a carriage return. The string is queued for
+ * transmission, blocking only while the transmit buffer is full.
  */
 int uart_puts(const char *str)
 {
@@ -145,34 +322,697 @@ int uart_puts(const char *str)
         status = 0;
 
         while (*str != '\0') {
-            /* Wait for the transmit buffer to be ready */
-            while (!(IFG2 & UCA0TXIFG));
+            size_t len = 0;
+
+            /* Queue everything up to the next line-feed in one go */
+            while ((str[len] != '\0') && (str[len] != '\n')) {
+                len++;
+            }
 
-            /* Transmit data */
-            UCA0TXBUF = *str; 
+            status += uart_write_all(str, len);
+            str += len;
 
             /*  If there is a line-feed, add a carriage return */
             if (*str == '\n') {
-                /* Wait for the transmit buffer to be ready */
-                while (!(IFG2 & UCA0TXIFG));
-                UCA0TXBUF = '\r';
+                status += uart_write_all("\n\r", 2);
+                str++;
             }
+        }
+    }
+
+    return status;
+}
+
+/**
+ * \brief Wait for all queued data to be transmitted
+ * \return 0 on success, -1 if transmission stalled
+ */
+int uart_flush(void)
+{
+    int status = 0;
+
+    while ((status == 0) && (_tx_queued() > 0)) {
+        status = _tx_wait();
+    }
+
+    /* Wait for the last character to leave the shift register */
+    while ((status == 0) && (UCA0STAT & UCBUSY));
 
-            str++;
+    return status;
+}
+
+/**
+ * \brief Write a block of data to UART
+ * \param[in] buf - the data to write
+ * \param[in] len - the number of bytes to write
+ * \return the number of bytes queued on success, -1 otherwise
+ *
+ * Never blocks. Only as much data as fits in the transmit buffer is queued,
+ * which may be less than len or even nothing.
+ */
+int uart_write(const void *buf, size_t len)
+{
+    int status = -1;
+
+    if (buf != NULL) {
+        const size_t n = ring_buffer_write(_tx_rbd, buf, len);
+
+        if (n > 0) {
+            /* Kick the tx interrupt to start draining the buffer */
+            IE2 |= UCA0TXIE;
         }
+
+        status = (int) n;
     }
 
     return status;
 }
 
-__attribute__((interrupt(USCIAB0RX_VECTOR))) void rx_isr(void)
+/**
+ * \brief Write a block of data to UART, waiting for room as needed
+ * \param[in] buf - the data to write
+ * \param[in] len - the number of bytes to write
+ * \return the number of bytes queued on success, -1 otherwise
+ *
+ * Gives up once the TX ISR has not made room for UART_TX_TIMEOUT_MS, for
+ * instance while the host holds off transmission.
+ */
+int uart_write_all(const void *buf, size_t len)
+{
+    int status = -1;
+
+    if (buf != NULL) {
+        const char *ptr = buf;
+        size_t count = 0;
+        int stalled = 0;
+
+        while ((count < len) && (stalled == 0)) {
+            const int n = uart_write(&ptr[count], len - count);
+
+            if (n > 0) {
+                count += (size_t) n;
+            } else {
+                stalled = _tx_wait();
+            }
+        }
+
+        status = (int) count;
+    }
+
+    return status;
+}
+
+/**
+ * \brief Read a block of data from UART
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the maximum number of bytes to read
+ * \param[in] timeout_ms - the time to wait for data in ms, 0 to not wait
+ * \param[in] delim - the character to stop at, or -1 for none
+ * \return the number of bytes read on success, -1 otherwise
+ *
+ * Returns when len bytes have been read, the delimiter has been read (it is
+ * stored in the buffer) or the timeout expires. The timeout has the
+ * resolution of the timer module.
+ */
+int uart_read(void *buf, size_t len, uint16_t timeout_ms, int delim)
+{
+    int status = -1;
+
+    if (buf != NULL) {
+        const uint32_t start = timer_timestamp_us();
+        const uint32_t timeout_us = (uint32_t) timeout_ms * 1000UL;
+        uint8_t *ptr = buf;
+        size_t count = 0;
+        int done = (len == 0);
+
+        while (done == 0) {
+            /* Read through uart_getchar() to keep the line count in step */
+            const int c = uart_getchar();
+
+            if (c >= 0) {
+                ptr[count++] = (uint8_t) c;
+
+                if ((count == len) || ((delim >= 0) && ((uint8_t) c == delim))) {
+                    done = 1;
+                }
+            } else if ((timer_timestamp_us() - start) >= timeout_us) {
+                /* No more data and the timeout has expired */
+                done = 1;
+            } else {
+                SR_ALLOC();
+
+                watchdog_pet();
+
+                /**
+                 * Sleep until the RX ISR stores data or the next timer tick.
+                 * Interrupts are enabled as the CPU sleeps, so no wake up is
+                 * missed.
+                 */
+                ENTER_CRITICAL();
+
+                if (_rx_count() == 0) {
+                    __bis_SR_register(LPM0_bits | GIE);
+                }
+
+                EXIT_CRITICAL();
+            }
+        }
+
+        status = (int) count;
+    }
+
+    return status;
+}
+
+/**
+ * \brief Wait for the TX ISR to send some of the queued data
+ * \return 0 on success, -1 if nothing was sent within UART_TX_TIMEOUT_MS
+ *
+ * The CPU sleeps in LPM0 until the TX ISR sends a byte or the next timer
+ * tick. The wait needs no timer, so data is never dropped for lack of one.
+ * The watchdog is pet on every wake up, so that a host which holds off
+ * transmission cannot reset the device, but cannot hang it either.
+ */
+static int _tx_wait(void)
+{
+    const size_t queued = _tx_queued();
+    const uint32_t start = timer_timestamp_us();
+    int status = -1;
+    SR_ALLOC();
+
+    ENTER_CRITICAL();
+    _tx_waiting = 1;
+
+    while ((status != 0) && ((timer_timestamp_us() - start) < (UART_TX_TIMEOUT_MS * 1000UL))) {
+        watchdog_pet();
+
+        if (_tx_queued() < queued) {
+            status = 0;
+        } else {
+            /* Interrupts are enabled as the CPU sleeps, so no wake up is missed */
+            __bis_SR_register(LPM0_bits | GIE);
+            __disable_interrupt();
+        }
+    }
+
+    _tx_waiting = 0;
+    EXIT_CRITICAL();
+
+    return status;
+}
+
+/**
+ * \brief Get the number of bytes waiting for the TX ISR
+ * \return the number of bytes in the echo and TX ring buffers
+ */
+static size_t _tx_queued(void)
+{
+    return ring_buffer_count(_tx_rbd) + _echo_count();
+}
+
+/**
+ * \brief Get the usage statistics of the RX ring buffer
+ * \param[out] stats - the statistics structure to fill
+ * \param[in] reset - non-zero to reset the statistics once read
+ * \return 0 on success, -1 otherwise
+ */
+int uart_rx_stats(rb_stats_t *stats, int reset)
+{
+    int err = -1;
+
+    if (stats != NULL) {
+        SR_ALLOC();
+
+        /* Take a consistent snapshot with respect to the RX ISR */
+        ENTER_CRITICAL();
+
+        stats->size = UART_RX_BUFFER_SIZE;
+        stats->peak = _rx_peak;
+        stats->puts = _rx.head - _rx_puts_base;
+        stats->gets = _rx.tail - _rx_gets_base;
+        stats->drops = _rx_drops;
+
+        if (reset != 0) {
+            _rx_peak = _rx_count();
+            _rx_drops = 0;
+            _rx_puts_base = _rx.head;
+            _rx_gets_base = _rx.tail;
+        }
+
+        EXIT_CRITICAL();
+        err = 0;
+    }
+
+    return err;
+}
+
+/**
+ * \brief UART transmit interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int uart_tx_isr(void)
 {
+    if ((IE2 & UCA0TXIE) && (IFG2 & UCA0TXIFG)) {
+        char c;
+
+        if (_flow_char != 0) {
+            /* XON/XOFF is sent even while transmission is paused */
+            UCA0TXBUF = _flow_char;
+            _flow_char = 0;
+        } else if ((_flow_tx_paused() == 0) &&
+                   ((_echo_get(&c) == 0) || (ring_buffer_get(_tx_rbd, &c) == 0))) {
+            /* Echo of the line editing goes first, writing TXBUF clears the flag */
+            UCA0TXBUF = c;
+        } else {
+            /* Nothing left to send, or the host has paused transmission */
+            IE2 &= ~UCA0TXIE;
+        }
+    }
+
+    return _tx_waiting;
+}
+
+/**
+ * \brief UART receive interrupt handler
+ * \return non-zero to wake the CPU, 0 otherwise
+ */
+int uart_rx_isr(void)
+{
+    int wake = 0;
+
     if (IFG2 & UCA0RXIFG) {
         const char c = UCA0RXBUF;
         
         /* Clear the interrupt flag */
         IFG2 &= ~UCA0RXIFG;
 
-        ring_buffer_put(_rbd, &c);
+        if ((_flow == UART_FLOW_XONXOFF) && ((c == UART_XON) || (c == UART_XOFF))) {
+            _tx_xoff = (c == UART_XOFF);
+
+            /* Resume transmission of anything queued in the meantime */
+            if (_tx_xoff == 0) {
+                IE2 |= UCA0TXIE;
+            }
+        } else if (_mode == UART_MODE_LINE) {
+            /* Wake the main loop once a line is ready */
+            wake = _line_input(c);
+        } else if (_rx_put(c) == 0) {
+            _rx_stored();
+            wake = 1;
+        } else {
+            _rx_drops++;
+        }
+    }
+
+    return wake;
+}
+
+__attribute__((interrupt(PORT2_VECTOR))) void port2_isr(void)
+{
+    if (P2IFG & UART_CTS_PIN) {
+        /* Clear the interrupt flag */
+        P2IFG &= ~UART_CTS_PIN;
+
+        /* CTS asserted, resume transmission */
+        IE2 |= UCA0TXIE;
+    }
+}
+
+/**
+ * \brief Configure the flow control pins
+ *
+ * RTS is asserted straight away. CTS has a pull-down so that an unconnected
+ * CTS does not stall transmission, and interrupts on assertion to resume.
+ */
+static void _flow_init(void)
+{
+    if (_flow == UART_FLOW_RTSCTS) {
+        P2SEL &= ~(UART_RTS_PIN | UART_CTS_PIN);
+        P2SEL2 &= ~(UART_RTS_PIN | UART_CTS_PIN);
+
+        P2OUT &= ~(UART_RTS_PIN | UART_CTS_PIN);
+        P2DIR |= UART_RTS_PIN;
+        P2DIR &= ~UART_CTS_PIN;
+        P2REN |= UART_CTS_PIN;
+
+        /* Interrupt on the falling edge of CTS */
+        P2IES |= UART_CTS_PIN;
+        P2IFG &= ~UART_CTS_PIN;
+        P2IE |= UART_CTS_PIN;
+    }
+}
+
+/**
+ * \brief Account for data stored in the RX ring buffer
+ *
+ * Called from the RX ISR. Tracks the peak occupancy and stops the host once
+ * the RX ring buffer fills up past the high water mark.
+ */
+static void _rx_stored(void)
+{
+    const size_t count = _rx_count();
+
+    if (count > _rx_peak) {
+        _rx_peak = count;
+    }
+
+    if ((_flow != UART_FLOW_NONE) && (_rx_stopped == 0) && (count >= UART_RX_HIGH_WATER)) {
+        _flow_rx_stop();
     }
 }
+
+/**
+ * \brief Stop the host from sending
+ *
+ * Called from the RX ISR.
+ */
+static void _flow_rx_stop(void)
+{
+    _rx_stopped = 1;
+
+    if (_flow == UART_FLOW_XONXOFF) {
+        _flow_char = UART_XOFF;
+        IE2 |= UCA0TXIE;
+    } else {
+        P2OUT |= UART_RTS_PIN;
+    }
+}
+
+/**
+ * \brief Let the host send again once the RX ring buffer has drained
+ *
+ * Called after data has been read from the RX ring buffer.
+ */
+static void _flow_rx_resume(void)
+{
+    if (_rx_stopped != 0) {
+        SR_ALLOC();
+
+        /* The RX ISR may stop the host again while this is checked */
+        ENTER_CRITICAL();
+
+        if ((_rx_stopped != 0) && (_rx_count() <= UART_RX_LOW_WATER)) {
+            _rx_stopped = 0;
+
+            if (_flow == UART_FLOW_XONXOFF) {
+                _flow_char = UART_XON;
+                IE2 |= UCA0TXIE;
+            } else {
+                P2OUT &= ~UART_RTS_PIN;
+            }
+        }
+
+        EXIT_CRITICAL();
+    }
+}
+
+/**
+ * \brief Check whether the host has paused transmission
+ * \return non-zero if paused, 0 otherwise
+ */
+static int _flow_tx_paused(void)
+{
+    int paused = 0;
+
+    if (_flow == UART_FLOW_XONXOFF) {
+        paused = _tx_xoff;
+    } else if (_flow == UART_FLOW_RTSCTS) {
+        paused = ((P2IN & UART_CTS_PIN) != 0);
+    } else {
+        /* No flow control */
+    }
+
+    return paused;
+}
+
+/**
+ * \brief Add a received character to the line being edited
+ * \param[in] c - the received character
+ * \return 1 if a line was completed, 0 otherwise
+ *
+ * Called from the RX ISR. Printable characters are echoed and appended,
+ * backspace and delete remove the last character, and a carriage return or
+ * line-feed commits the line to the RX ring buffer. The line-feed of a
+ * CR/LF pair is ignored. The line is written past the head of the ring
+ * buffer, which only the consumer's tail limits, so committing it is a
+ * single update of the head. A line which does not fit is dropped.
+ */
+static int _line_input(char c)
+{
+    static char last = '\0';
+    static int overflow = 0;
+    int ready = 0;
+
+    if ((c == '\r') || (c == '\n')) {
+        if ((c == '\r') || (last != '\r')) {
+            if ((overflow == 0) && ((_rx_count() + _line_len) < UART_RX_BUFFER_SIZE)) {
+                _rx.buf[(_rx.head + _line_len) & (UART_RX_BUFFER_SIZE - 1)] = '\n';
+                _rx.head += _line_len + 1;
+                _rx_stored();
+                _lines++;
+                ready = 1;
+            } else {
+                _rx_drops += _line_len + 1;
+            }
+
+            _line_len = 0;
+            overflow = 0;
+            _line_echo("\n\r", 2);
+        }
+    } else if ((c == '\b') || (c == 0x7F)) {
+        if (_line_len > 0) {
+            _line_len--;
+            _line_echo("\b \b", 3);
+        }
+    } else if ((c >= ' ') && (c <= '~') && (_line_len < UART_LINE_MAX)) {
+        /* Keep room for the terminator */
+        if ((_rx_count() + _line_len + 1) < UART_RX_BUFFER_SIZE) {
+            _rx.buf[(_rx.head + _line_len++) & (UART_RX_BUFFER_SIZE - 1)] = c;
+            _line_echo(&c, 1);
+        } else {
+            /* The rest of the line is dropped along with it */
+            _rx_drops++;
+            overflow = 1;
+        }
+    } else {
+        /* Not a valid character, or the line is full */
+    }
+
+    last = c;
+
+    return ready;
+}
+
+/**
+ * \brief Queue characters to echo for the TX ISR
+ * \param[in] str - the characters to echo
+ * \param[in] len - the number of characters
+ *
+ * Called from the RX ISR, so this never blocks. Characters which do not fit
+ * in the echo buffer are dropped.
+ */
+static void _line_echo(const char *str, size_t len)
+{
+    while (len-- > 0) {
+        _echo_put(*str++);
+    }
+
+    /* Kick the tx interrupt to start sending */
+    IE2 |= UCA0TXIE;
+}
+
+/**
+ * \brief Detect the baud rate of the host
+ * \param[in] clk - the SMCLK frequency in Hz
+ * \return the detected baud rate
+ *
+ * Blocks until the host sends a 'U' (0x55) which can be measured. The RX
+ * pin P1.1 doubles as the Timer0_A CCR0 capture input CCI0A, so the pin is
+ * taken from the USCI while measuring. Measurements which are inconsistent
+ * or too far from a standard rate are discarded and the next characters are
+ * measured instead.
+ */
+static uint32_t _baud_detect(uint32_t clk)
+{
+    uint32_t baud = 0;
+    unsigned int shift = 0;
+
+    /* Prescale Timer0_A so that the sync bits at the lowest rate span less than 16 bits */
+    while ((shift < 3) && (((clk >> shift) / _baud_rates[0]) > (0xFFFFUL >> UART_SYNC_BITS_SHIFT))) {
+        shift++;
+    }
+
+    /* Route P1.1 to CCI0A instead of UCA0RXD */
+    P1SEL2 &= ~BIT1;
+
+    /**
+     * Timer0_A continuous mode from SMCLK divided by 2^shift (the IDx field),
+     * capture falling edges of CCI0A
+     */
+    TA0CTL = TASSEL_2 | (shift << 6) | MC_2 | TACLR;
+
+    while (baud == 0) {
+        const uint32_t measured = _baud_measure(clk >> shift);
+        size_t i;
+
+        /* Round to the nearest standard rate, if it is within 1/16 */
+        for (i = 0; (i < ARRAY_SIZE(_baud_rates)) && (measured > 0); i++) {
+            const uint32_t rate = _baud_rates[i];
+            const uint32_t diff = (measured > rate) ? (measured - rate) : (rate - measured);
+
+            if (diff <= (rate >> 4)) {
+                baud = rate;
+            }
+        }
+    }
+
+    /* Stop the timer and give the pin back to the USCI */
+    TA0CCTL0 = 0;
+    TA0CTL = MC_0;
+    P1SEL2 |= BIT1;
+
+    return baud;
+}
+
+/**
+ * \brief Measure the baud rate of one sync character
+ * \param[in] clk - the Timer0_A clock frequency in Hz
+ * \return the measured baud rate, 0 if the measurement is invalid
+ *
+ * In 'U' the start bit and data bits alternate, so the falling edges are
+ * two bit times apart and the first and fifth edge span eight bit times.
+ * Back to back 'U' characters keep the same spacing. The edges after the
+ * first are read in a tight loop, an overrun (COV) means that the edges
+ * came too fast to be read. The span must be shorter than a timer period,
+ * so the waits give up once the timer has wrapped past the first edge, for
+ * instance after a glitch on the line, and the measurement is discarded.
+ */
+static uint32_t _baud_measure(uint32_t clk)
+{
+    uint32_t baud = 0;
+    uint16_t edge[UART_SYNC_EDGES];
+    uint16_t span;
+    uint16_t avg;
+    int expired = 0;
+    size_t i;
+
+    /* Restart the capture, discarding any stale edge */
+    TA0CCTL0 = CM_2 | CCIS_0 | SCS | CAP;
+
+    /* The host may take a while to send the first character */
+    while ((TA0CCTL0 & CCIFG) == 0) {
+        watchdog_pet();
+    }
+
+    edge[0] = TA0CCR0;
+    TA0CCTL0 &= ~CCIFG;
+    TA0CTL &= ~TAIFG;
+
+    for (i = 1; (i < UART_SYNC_EDGES) && (expired == 0); i++) {
+        while (((TA0CCTL0 & CCIFG) == 0) && (expired == 0)) {
+            expired = _baud_expired(edge[0], TA0R);
+        }
+
+        edge[i] = TA0CCR0;
+        TA0CCTL0 &= ~CCIFG;
+    }
+
+    /* An edge captured a full period after the first is not valid either */
+    expired |= _baud_expired(edge[0], edge[UART_SYNC_EDGES - 1]);
+
+    span = edge[UART_SYNC_EDGES - 1] - edge[0];
+    avg = span / (UART_SYNC_EDGES - 1);
+
+    if ((expired == 0) && ((TA0CCTL0 & COV) == 0) && (span > 0)) {
+        baud = (clk << UART_SYNC_BITS_SHIFT) / span;
+
+        /* Every edge must be two bit times from the previous one, +/- 25% */
+        for (i = 1; i < UART_SYNC_EDGES; i++) {
+            const uint16_t interval = edge[i] - edge[i - 1];
+            const uint16_t diff = (interval > avg) ? (interval - avg) : (avg - interval);
+
+            if (diff > (avg >> 2)) {
+                baud = 0;
+            }
+        }
+    }
+
+    return baud;
+}
+
+/**
+ * \brief Check whether Timer0_A has run a full period since a count
+ * \param[in] start - the count when TAIFG was cleared
+ * \param[in] count - a later count or capture
+ * \return non-zero if the timer has wrapped and reached start again
+ */
+static int _baud_expired(uint16_t start, uint16_t count)
+{
+    return ((TA0CTL & TAIFG) != 0) && (count >= start);
+}
+
+/**
+ * \brief Calculate the baud rate register values
+ * \param[in] clk - the BRCLK frequency in Hz
+ * \param[in] baud - the baud rate
+ * \param[out] value - the register values and resulting error
+ * \return 0 on success, -1 if the baud rate cannot be generated accurately
+ *
+ * Uses the formulas from the reference manual (SLAU144). With the divider
+ * N = clk / baud, low-frequency mode uses UCBRx = INT(N) and UCBRSx =
+ * round((N - INT(N)) * 8), and oversampling mode uses UCBRx = INT(N / 16)
+ * and UCBRFx = round(((N / 16) - INT(N / 16)) * 16). Oversampling is
+ * preferred when N >= 16 unless its coarser divider is off by more than
+ * half of the acceptable error.
+ */
+static int _baud_compute(uint32_t clk, uint32_t baud, struct baud_value *value)
+{
+    int err = -1;
+
+    if ((baud > 0) && (baud <= (clk / 3))) {
+        /* N in units of 1/16 and 1/8 of BRCLK, rounded to the nearest */
+        const uint32_t n16 = ((clk << 4) + (baud >> 1)) / baud;
+        const uint32_t n8 = ((clk << 3) + (baud >> 1)) / baud;
+        const int error_lf = _baud_error(clk << 3, baud, n8);
+        int error_os = 0;
+
+        /* The oversampling divider is N rounded to the nearest integer */
+        if (n16 >= (16 << 4)) {
+            error_os = _baud_error(clk, baud, (n16 + 8) >> 4);
+        }
+
+        if ((n16 >= (16 << 4)) && (error_os <= (UART_BAUD_MAX_ERROR / 2)) &&
+            (error_os >= -(UART_BAUD_MAX_ERROR / 2))) {
+            const uint32_t n = (n16 + 8) >> 4;
+
+            value->UCAxBR = n >> 4;
+            value->UCAxMCTL = ((n & 0xF) << 4) | UCOS16;
+            value->error = error_os;
+        } else {
+            value->UCAxBR = n8 >> 3;
+            value->UCAxMCTL = (n8 & 0x7) << 1;
+            value->error = error_lf;
+        }
+
+        if ((value->error <= UART_BAUD_MAX_ERROR) && (value->error >= -UART_BAUD_MAX_ERROR)) {
+            err = 0;
+        }
+    }
+
+    return err;
+}
+
+/**
+ * \brief Calculate the baud rate error of a divider
+ * \param[in] clk - the BRCLK frequency in Hz, scaled to the divider units
+ * \param[in] baud - the requested baud rate
+ * \param[in] divider - the divider
+ * \return the error in tenths of a percent
+ */
+static int _baud_error(uint32_t clk, uint32_t baud, uint32_t divider)
+{
+    const int32_t product = (int32_t) (divider * baud);
+
+    /* A divider which is too small results in a baud rate which is too high */
+    return (int) ((((int32_t) clk - product) * 1000) / product);
+}
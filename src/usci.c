@@ -0,0 +1,65 @@
+/**
+ * \file usci.c
+ * \author Chris Karaplis
+ * \brief USCI interrupt dispatch
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "usci.h"
+#include <msp430.h>
+
+/**
+ * USCIAB0TX is shared by the UART transmit interrupt and the I2C data
+ * interrupts (UCB0TXIFG and UCB0RXIFG)
+ */
+__attribute__((interrupt(USCIAB0TX_VECTOR))) void usci_tx_isr(void)
+{
+    int wake = uart_tx_isr();
+
+    wake |= i2c_data_isr();
+
+    if (wake != 0) {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
+
+/**
+ * USCIAB0RX is shared by the UART receive interrupt and the I2C state
+ * interrupts
+ */
+__attribute__((interrupt(USCIAB0RX_VECTOR))) void usci_rx_isr(void)
+{
+    int wake = uart_rx_isr();
+
+    wake |= i2c_state_isr();
+
+    if (wake != 0) {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
@@ -0,0 +1,336 @@
+/**
+ * \file eeprom_cache_test.c
+ * \author Chris Karaplis
+ * \brief EEPROM cache tests against the simulated bus and 24xx EEPROM
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "test.h"
+#include "eeprom_cache.h"
+#include "i2c.h"
+#include "usci_b0.h"
+#include "eeprom_24xx.h"
+#include <stdint.h>
+#include <string.h>
+#include <msp430.h>
+
+/* Base address of the EEPROM */
+#define EEPROM_ADDRESS  0x50
+
+/* Write cycle of a 24C02 */
+#define WRITE_TIME_US   5000
+
+/* From timer.h, which clashes with the POSIX timers declared by <time.h> */
+int timer_init(void);
+
+/* Timer tick interrupt handler, every 100ms */
+void timer1_isr(void);
+
+static const struct eeprom _24c02 = {{EEPROM_ADDRESS, 0}, 256, 8, 1};
+
+static uint8_t _image[256];
+
+static void _test_args(void);
+static void _test_read(void);
+static void _test_write(void);
+static void _test_evict(void);
+static void _test_poll(void);
+static void _test_stats(void);
+static int _line_of(uint16_t page, struct eeprom_cache_stats *stats);
+static void _device(void);
+
+int main(void)
+{
+    struct i2c_config config = {100000, 0};
+    size_t i;
+
+    sim_sleep = sim_ucb0_run;
+    sim_timer1_a0 = timer1_isr;
+    sim_ucb0_attach(&sim_24xx);
+    __enable_interrupt();
+    (void) timer_init();
+    (void) i2c_init(&config);
+
+    for (i = 0; i < sizeof(_image); i++) {
+        _image[i] = (uint8_t) ((i * 7) + 3);
+    }
+
+    _test_args();
+    _test_read();
+    _test_write();
+    _test_evict();
+    _test_poll();
+    _test_stats();
+
+    return test_result("eeprom_cache_test");
+}
+
+/**
+ * \brief SMCLK frequency, as set by the board
+ */
+uint32_t board_get_smclk(void)
+{
+    return 1000000;
+}
+
+/**
+ * \brief The watchdog is not simulated
+ */
+void watchdog_pet(void)
+{
+}
+
+/**
+ * \brief Check the argument validation
+ */
+static void _test_args(void)
+{
+    struct eeprom bad = {{EEPROM_ADDRESS, 0}, 256, 16, 1};
+    uint8_t buf[2];
+
+    /* Pages must fit in a line and be a power of 2 */
+    TEST_CHECK(eeprom_cache_init(NULL) == -1);
+    TEST_CHECK(eeprom_cache_init(&bad) == -1);
+    bad.page_size = 6;
+    TEST_CHECK(eeprom_cache_init(&bad) == -1);
+
+    _device();
+    TEST_CHECK(eeprom_cache_read(255, buf, 2) == -1);
+    TEST_CHECK(eeprom_cache_write(255, buf, 2) == -1);
+    TEST_CHECK(eeprom_cache_read(0, NULL, 1) == -1);
+    TEST_CHECK(eeprom_cache_write(0, NULL, 1) == -1);
+    TEST_CHECK(eeprom_cache_stats(EEPROM_CACHE_LINES, NULL, 0) == -1);
+    sim_ucb0_idle();
+    TEST_CHECK(sim_ucb0_stats.starts == 0);
+}
+
+/**
+ * \brief Pages are read once, later reads are served from the cache
+ */
+static void _test_read(void)
+{
+    uint8_t buf[16];
+
+    _device();
+    memcpy(sim_24xx_mem, _image, sizeof(_image));
+
+    /* An unaligned read loads both pages it spans */
+    TEST_CHECK(eeprom_cache_read(4, buf, 8) == 0);
+    TEST_CHECK(memcmp(buf, &_image[4], 8) == 0);
+    TEST_CHECK(sim_24xx_stats.read == 16);
+
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(eeprom_cache_read(0, buf, 16) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK(memcmp(buf, _image, 16) == 0);
+    TEST_CHECK((sim_24xx_stats.read == 16) && (sim_ucb0_stats.starts == 0));
+}
+
+/**
+ * \brief Writes are merged into one page program, flushed on demand
+ */
+static void _test_write(void)
+{
+    uint8_t buf[8];
+    size_t i;
+
+    _device();
+
+    /* Whole pages are not read first, partial ones are */
+    TEST_CHECK(eeprom_cache_write(16, _image, 8) == 0);
+    TEST_CHECK(sim_24xx_stats.read == 0);
+    TEST_CHECK(eeprom_cache_write(26, _image, 2) == 0);
+    TEST_CHECK(sim_24xx_stats.read == 8);
+
+    for (i = 0; i < 4; i++) {
+        TEST_CHECK(eeprom_cache_write((uint16_t) (28 + i), &_image[i], 1) == 0);
+    }
+
+    /* Nothing is programmed until the flush, then once per page */
+    TEST_CHECK(sim_24xx_stats.write_cycles == 0);
+    TEST_CHECK(eeprom_cache_read(26, buf, 6) == 0);
+    TEST_CHECK((memcmp(buf, _image, 2) == 0) && (memcmp(&buf[2], _image, 4) == 0));
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 2) && (sim_24xx_stats.written == 16));
+    TEST_CHECK((memcmp(&sim_24xx_mem[16], _image, 8) == 0) && (sim_24xx_mem[24] == 0xFF));
+    TEST_CHECK((memcmp(&sim_24xx_mem[26], _image, 2) == 0) && (memcmp(&sim_24xx_mem[28], _image, 4) == 0));
+
+    /* Clean lines are not programmed again */
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK(sim_24xx_stats.write_cycles == 2);
+}
+
+/**
+ * \brief The least recently used line is evicted, dirty ones written back
+ */
+static void _test_evict(void)
+{
+    struct eeprom_cache_stats stats;
+    uint8_t buf[1];
+    uint16_t page;
+    int line;
+
+    _device();
+    memcpy(sim_24xx_mem, _image, sizeof(_image));
+
+    /* Fill every line, page 0 is dirty and used the longest ago */
+    TEST_CHECK(eeprom_cache_write(0, "x", 1) == 0);
+
+    for (page = 8; page < (8 * EEPROM_CACHE_LINES); page += 8) {
+        TEST_CHECK(eeprom_cache_read(page, buf, 1) == 0);
+    }
+
+    TEST_CHECK(sim_24xx_stats.write_cycles == 0);
+
+    /* Touching page 8 leaves page 0 the least recently used */
+    TEST_CHECK(eeprom_cache_read(8, buf, 1) == 0);
+    line = _line_of(0, &stats);
+    TEST_CHECK(line >= 0);
+
+    /* The next page takes over its line and writes it back */
+    TEST_CHECK(eeprom_cache_read(8 * EEPROM_CACHE_LINES, buf, 1) == 0);
+    TEST_CHECK(_line_of(0, &stats) == -1);
+    TEST_CHECK(_line_of(8 * EEPROM_CACHE_LINES, &stats) == line);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 1) && (sim_24xx_mem[0] == 'x'));
+    TEST_CHECK(memcmp(&sim_24xx_mem[1], &_image[1], 7) == 0);
+
+    /* Evicting a clean line writes nothing, the most recent page stays */
+    TEST_CHECK(eeprom_cache_read(8 * (EEPROM_CACHE_LINES + 1), buf, 1) == 0);
+    TEST_CHECK(_line_of(8 * EEPROM_CACHE_LINES, &stats) >= 0);
+    TEST_CHECK(sim_24xx_stats.write_cycles == 1);
+}
+
+/**
+ * \brief Dirty lines are flushed once the cache has been idle
+ */
+static void _test_poll(void)
+{
+    unsigned int i;
+
+    _device();
+
+    /* Nothing to flush */
+    TEST_CHECK(eeprom_cache_poll() == 0);
+
+    TEST_CHECK(eeprom_cache_write(40, _image, 3) == 0);
+    TEST_CHECK(eeprom_cache_poll() == 0);
+
+    /* Each write restarts the idle time */
+    for (i = 0; i < 9; i++) {
+        sim_advance_us(100000);
+    }
+
+    TEST_CHECK(eeprom_cache_write(43, _image, 1) == 0);
+
+    for (i = 0; i < 9; i++) {
+        sim_advance_us(100000);
+        TEST_CHECK(eeprom_cache_poll() == 0);
+    }
+
+    TEST_CHECK(sim_24xx_stats.write_cycles == 0);
+    sim_advance_us(100000);
+    TEST_CHECK(eeprom_cache_poll() == 0);
+    TEST_CHECK(sim_24xx_stats.write_cycles == 1);
+    TEST_CHECK((memcmp(&sim_24xx_mem[40], _image, 3) == 0) && (sim_24xx_mem[43] == _image[0]));
+
+    /* Once clean, polling does nothing */
+    sim_advance_us(2000000);
+    TEST_CHECK(eeprom_cache_poll() == 0);
+    TEST_CHECK(sim_24xx_stats.write_cycles == 1);
+}
+
+/**
+ * \brief Per line hits, misses and write backs
+ */
+static void _test_stats(void)
+{
+    struct eeprom_cache_stats stats;
+    uint8_t buf[8];
+    int line;
+
+    _device();
+
+    TEST_CHECK(eeprom_cache_stats(0, &stats, 0) == 0);
+    TEST_CHECK((stats.valid == 0) && (stats.hits == 0) && (stats.misses == 0) && (stats.writebacks == 0));
+
+    TEST_CHECK(eeprom_cache_read(64, buf, 8) == 0);
+    TEST_CHECK(eeprom_cache_read(66, buf, 2) == 0);
+    TEST_CHECK(eeprom_cache_write(64, buf, 8) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK(eeprom_cache_write(70, buf, 1) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+
+    line = _line_of(64, &stats);
+    TEST_CHECK(line >= 0);
+    TEST_CHECK((stats.hits == 3) && (stats.misses == 1) && (stats.writebacks == 2));
+
+    /* Resetting clears the counters, the line keeps its page */
+    TEST_CHECK(eeprom_cache_stats((unsigned int) line, &stats, 1) == 0);
+    TEST_CHECK(eeprom_cache_stats((unsigned int) line, &stats, 0) == 0);
+    TEST_CHECK((stats.valid != 0) && (stats.page == 64));
+    TEST_CHECK((stats.hits == 0) && (stats.misses == 0) && (stats.writebacks == 0));
+}
+
+/**
+ * \brief Find the cache line holding a page
+ * \param[in] page - the address of the page
+ * \param[out] stats - the statistics of the line
+ * \return the cache line, -1 if the page is not cached
+ */
+static int _line_of(uint16_t page, struct eeprom_cache_stats *stats)
+{
+    unsigned int line;
+
+    for (line = 0; line < EEPROM_CACHE_LINES; line++) {
+        if ((eeprom_cache_stats(line, stats, 0) == 0) && (stats->valid != 0) && (stats->page == page)) {
+            return (int) line;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * \brief Reset the simulated 24C02 and the cache in front of it
+ */
+static void _device(void)
+{
+    struct sim_24xx_config config;
+
+    config.address = _24c02.dev.address;
+    config.size = _24c02.size;
+    config.page_size = _24c02.page_size;
+    config.addr_width = _24c02.addr_width;
+    config.write_time_us = WRITE_TIME_US;
+    sim_24xx_init(&config);
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+
+    TEST_CHECK(eeprom_cache_init(&_24c02) == 0);
+}
@@ -0,0 +1,387 @@
+/**
+ * \file eeprom_test.c
+ * \author Chris Karaplis
+ * \brief EEPROM driver tests and benchmarks on the simulated 24xx
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.h"
+#include "eeprom.h"
+#include "i2c.h"
+#include "usci_b0.h"
+#include "eeprom_24xx.h"
+#include <stdint.h>
+#include <string.h>
+#include <msp430.h>
+
+/* Base address of the EEPROMs */
+#define EEPROM_ADDRESS  0x50
+
+/* Worst case write cycle of a 24C02, the fixed wait of the old code */
+#define WRITE_TIME_US   5000
+
+/* From timer.h, which clashes with the POSIX timers declared by <time.h> */
+int timer_init(void);
+uint32_t timer_timestamp_us(void);
+
+/* Timer tick interrupt handler, every 100ms */
+void timer1_isr(void);
+
+static const struct eeprom _24c02 = {{EEPROM_ADDRESS, 0}, 256, 8, 1};
+static const struct eeprom _24c16 = {{EEPROM_ADDRESS, 0}, 2048, 16, 1};
+static const struct eeprom _24c256 = {{EEPROM_ADDRESS, 0}, 32768, 64, 2};
+
+static uint8_t _image[2048];
+static uint8_t _back[2048];
+
+static void _test_args(void);
+static void _test_24c02(void);
+static void _test_24c16(void);
+static void _test_24c256(void);
+static void _test_timeout(void);
+static void _test_wrap(void);
+static void _advance_to(double us);
+static void _bench(void);
+static void _bench_report(const char *name, size_t len, double start);
+static void _device(const struct eeprom *eeprom, double write_time_us);
+
+int main(void)
+{
+    struct i2c_config config = {100000, 0};
+    size_t i;
+
+    sim_sleep = sim_ucb0_run;
+    sim_timer1_a0 = timer1_isr;
+    sim_ucb0_attach(&sim_24xx);
+    (void) timer_init();
+    (void) i2c_init(&config);
+
+    for (i = 0; i < sizeof(_image); i++) {
+        _image[i] = (uint8_t) ((i * 7) + 3 + (i >> 8));
+    }
+
+    _test_args();
+    _test_24c02();
+    _test_24c16();
+    _test_24c256();
+    _test_timeout();
+    _test_wrap();
+    _bench();
+
+    return test_result("eeprom_test");
+}
+
+/**
+ * \brief SMCLK frequency, as set by the board
+ */
+uint32_t board_get_smclk(void)
+{
+    return 1000000;
+}
+
+/**
+ * \brief The watchdog is not simulated
+ */
+void watchdog_pet(void)
+{
+}
+
+/**
+ * \brief Check the argument validation
+ */
+static void _test_args(void)
+{
+    struct eeprom bad = {{EEPROM_ADDRESS, 0}, 256, 8, 1};
+
+    _device(&_24c02, 0);
+
+    TEST_CHECK(eeprom_read(NULL, 0, _back, 1) == -1);
+    TEST_CHECK(eeprom_read(&_24c02, 0, NULL, 1) == -1);
+    TEST_CHECK(eeprom_write(&_24c02, 0, NULL, 1) == -1);
+    TEST_CHECK(eeprom_read(&_24c02, 250, _back, 7) == -1);
+    TEST_CHECK(eeprom_write(&_24c02, 256, _image, 1) == -1);
+    TEST_CHECK(eeprom_read(&_24c02, 250, _back, 6) == 0);
+
+    bad.addr_width = 3;
+    TEST_CHECK(eeprom_read(&bad, 0, _back, 1) == -1);
+    bad.addr_width = 1;
+    bad.page_size = 12;
+    TEST_CHECK(eeprom_write(&bad, 0, _image, 1) == -1);
+    bad.page_size = 0;
+    TEST_CHECK(eeprom_write(&bad, 0, _image, 1) == -1);
+
+    /* Nothing reached the bus except the valid read */
+    TEST_CHECK(sim_ucb0_stats.starts == 2);
+}
+
+/**
+ * \brief Check page writes, ACK polling and sequential reads on a 24C02
+ */
+static void _test_24c02(void)
+{
+    _device(&_24c02, WRITE_TIME_US);
+
+    /* One page program per page, each polled until it completes */
+    TEST_CHECK(eeprom_write(&_24c02, 0, _image, 256) == 0);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 32) && (sim_24xx_stats.written == 256));
+    TEST_CHECK((sim_24xx_stats.rollovers == 0) && (sim_24xx_stats.busy_nacks > 0));
+    TEST_CHECK(memcmp(sim_24xx_mem, _image, 256) == 0);
+
+    /* The read is a single transaction */
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(eeprom_read(&_24c02, 0, _back, 256) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK(memcmp(_back, _image, 256) == 0);
+    TEST_CHECK((sim_ucb0_stats.starts == 2) && (sim_ucb0_stats.stops == 1));
+
+    /* Unaligned writes are split at the page boundaries */
+    _device(&_24c02, WRITE_TIME_US);
+    TEST_CHECK(eeprom_write(&_24c02, 5, _image, 21) == 0);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 4) && (sim_24xx_stats.rollovers == 0));
+    TEST_CHECK((sim_24xx_mem[4] == 0xFF) && (memcmp(sim_24xx_mem + 5, _image, 21) == 0) && (sim_24xx_mem[26] == 0xFF));
+    memset(_back, 0, 21);
+    TEST_CHECK((eeprom_read(&_24c02, 5, _back, 21) == 0) && (memcmp(_back, _image, 21) == 0));
+
+    /* A write which ends the first page */
+    TEST_CHECK(eeprom_write(&_24c02, 250, _image, 6) == 0);
+    TEST_CHECK((memcmp(sim_24xx_mem + 250, _image, 6) == 0) && (sim_24xx_stats.rollovers == 0));
+}
+
+/**
+ * \brief Check the block select of a 24C16 with 1 address byte
+ */
+static void _test_24c16(void)
+{
+    _device(&_24c16, WRITE_TIME_US);
+
+    TEST_CHECK(eeprom_write(&_24c16, 0, _image, 2048) == 0);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 128) && (sim_24xx_stats.rollovers == 0));
+    TEST_CHECK(memcmp(sim_24xx_mem, _image, 2048) == 0);
+
+    /* Reads are split at the 256 byte blocks */
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(eeprom_read(&_24c16, 100, _back, 1900) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK(memcmp(_back, _image + 100, 1900) == 0);
+    TEST_CHECK(sim_ucb0_stats.stops == 8);
+}
+
+/**
+ * \brief Check the 2 byte addressing of a 24C256
+ */
+static void _test_24c256(void)
+{
+    _device(&_24c256, WRITE_TIME_US);
+
+    TEST_CHECK(eeprom_write(&_24c256, 30000, _image, 1000) == 0);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 17) && (sim_24xx_stats.rollovers == 0));
+    TEST_CHECK((sim_24xx_mem[29999] == 0xFF) && (memcmp(sim_24xx_mem + 30000, _image, 1000) == 0));
+
+    /* One transaction for the whole read */
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(eeprom_read(&_24c256, 30000, _back, 1000) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK((memcmp(_back, _image, 1000) == 0) && (sim_ucb0_stats.stops == 1));
+}
+
+/**
+ * \brief Check that a write cycle longer than EEPROM_WRITE_TIME_US times out
+ */
+static void _test_timeout(void)
+{
+    double start;
+
+    _device(&_24c02, EEPROM_WRITE_TIME_US * 5.0);
+
+    start = sim_time_us;
+    TEST_CHECK(eeprom_write(&_24c02, 0, _image, 1) == I2C_ERR_TIMEOUT);
+    TEST_CHECK(((sim_time_us - start) >= EEPROM_WRITE_TIME_US) && ((sim_time_us - start) < (EEPROM_WRITE_TIME_US * 2.0)));
+
+    /* The data was still programmed */
+    TEST_CHECK(sim_24xx_mem[0] == _image[0]);
+}
+
+/**
+ * \brief Check writes started just before the timestamp and the tick wrap
+ *
+ * The us timestamp wraps after 2^32us and the 16-bit timer tick after
+ * 6553.6s. Write cycles which span either point complete, and the ones
+ * which are too long still time out after EEPROM_WRITE_TIME_US.
+ */
+static void _test_wrap(void)
+{
+    const double tick_wrap_us = 65536.0 * 100000;
+    double start;
+
+    /* Shortly before the timestamp wraps */
+    while (timer_timestamp_us() < (0xFFFFFFFFUL - 200000)) {
+        sim_advance_us(100000);
+    }
+
+    while (timer_timestamp_us() < (0xFFFFFFFFUL - 3000)) {
+        sim_advance_us(1000);
+    }
+
+    _device(&_24c02, WRITE_TIME_US);
+    TEST_CHECK(eeprom_write(&_24c02, 0, _image, 8) == 0);
+    TEST_CHECK(timer_timestamp_us() < 100000);
+    TEST_CHECK((memcmp(sim_24xx_mem, _image, 8) == 0) && (sim_24xx_stats.busy_nacks > 0));
+
+    /* Shortly before the tick counter wraps */
+    _advance_to(tick_wrap_us - 3000);
+    _device(&_24c02, WRITE_TIME_US);
+    TEST_CHECK(eeprom_write(&_24c02, 8, _image, 8) == 0);
+    TEST_CHECK(sim_time_us > tick_wrap_us);
+    TEST_CHECK((memcmp(sim_24xx_mem + 8, _image, 8) == 0) && (sim_24xx_stats.busy_nacks > 0));
+
+    /* A write cycle which is too long times out across the next wrap */
+    _advance_to((2 * tick_wrap_us) - 3000);
+    _device(&_24c02, EEPROM_WRITE_TIME_US * 5.0);
+    start = sim_time_us;
+    TEST_CHECK(eeprom_write(&_24c02, 0, _image, 1) == I2C_ERR_TIMEOUT);
+    TEST_CHECK(((sim_time_us - start) >= EEPROM_WRITE_TIME_US) && ((sim_time_us - start) < (EEPROM_WRITE_TIME_US * 2.0)));
+}
+
+/**
+ * \brief Advance the simulated time, one timer tick at most at a time
+ * \param[in] us - the simulated time to advance to
+ */
+static void _advance_to(double us)
+{
+    while (sim_time_us < (us - 100000)) {
+        sim_advance_us(100000);
+    }
+
+    while (sim_time_us < us) {
+        sim_advance_us(1000);
+    }
+}
+
+/**
+ * \brief Compare the old one byte per transaction accesses with the driver
+ *
+ * The old code wrote one byte per transaction and, not knowing when the
+ * write cycle ends, has to wait for the worst case after each one. The
+ * times are simulated bus time on a 24C02 with a 5ms write cycle.
+ */
+static void _bench(void)
+{
+    static const uint32_t rates[] = {100000, 250000};
+    struct i2c_device dev = {EEPROM_ADDRESS, 0};
+    struct eeprom eeprom = _24c02;
+    uint8_t cmd[2];
+    struct i2c_data data;
+    double start;
+    size_t i;
+    int err = 0;
+
+    _device(&_24c02, WRITE_TIME_US);
+
+    start = sim_time_us;
+
+    for (i = 0; i < 256; i++) {
+        cmd[0] = (uint8_t) i;
+        cmd[1] = (uint8_t) (_image[i] + 1);
+        data.tx_buf = cmd;
+        data.tx_len = 2;
+        data.rx_buf = NULL;
+        data.rx_len = 0;
+        err |= i2c_transfer(&dev, &data);
+        sim_advance_us(WRITE_TIME_US);
+    }
+
+    _bench_report("old write, 1 B per transaction", 256, start);
+    start = sim_time_us;
+
+    for (i = 0; i < 256; i++) {
+        cmd[0] = (uint8_t) i;
+        data.tx_buf = cmd;
+        data.tx_len = 1;
+        data.rx_buf = &_back[i];
+        data.rx_len = 1;
+        err |= i2c_transfer(&dev, &data);
+    }
+
+    _bench_report("old read, 1 B per transaction", 256, start);
+    TEST_CHECK(err == 0);
+
+    for (i = 0; i < 256; i++) {
+        err |= (_back[i] != (uint8_t) (_image[i] + 1));
+    }
+
+    TEST_CHECK(err == 0);
+
+    for (i = 0; i < (sizeof(rates) / sizeof(rates[0])); i++) {
+        char name[40];
+
+        eeprom.dev.bus_hz = rates[i];
+
+        sprintf(name, "eeprom_write at %lu Hz", (unsigned long) i2c_bus_hz(&eeprom.dev));
+        start = sim_time_us;
+        TEST_CHECK(eeprom_write(&eeprom, 0, _image, 256) == 0);
+        _bench_report(name, 256, start);
+
+        sprintf(name, "eeprom_read at %lu Hz", (unsigned long) i2c_bus_hz(&eeprom.dev));
+        start = sim_time_us;
+        TEST_CHECK(eeprom_read(&eeprom, 0, _back, 256) == 0);
+        _bench_report(name, 256, start);
+        TEST_CHECK(memcmp(_back, _image, 256) == 0);
+    }
+}
+
+/**
+ * \brief Print the time and throughput of a benchmark
+ * \param[in] name - the name of the benchmark
+ * \param[in] len - the number of bytes transferred
+ * \param[in] start - the simulated time at the start
+ */
+static void _bench_report(const char *name, size_t len, double start)
+{
+    const double us = sim_time_us - start;
+
+    printf("%-32s %u B  %8.1f ms  %7.0f B/s\n", name, (unsigned int) len, us / 1000, (len * 1e6) / us);
+}
+
+/**
+ * \brief Reset the simulated EEPROM to the geometry of a device
+ * \param[in] eeprom - the device
+ * \param[in] write_time_us - the duration of the write cycle
+ */
+static void _device(const struct eeprom *eeprom, double write_time_us)
+{
+    struct sim_24xx_config config;
+
+    config.address = eeprom->dev.address;
+    config.size = eeprom->size;
+    config.page_size = eeprom->page_size;
+    config.addr_width = eeprom->addr_width;
+    config.write_time_us = write_time_us;
+    sim_24xx_init(&config);
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+}
@@ -0,0 +1,272 @@
+/**
+ * \file format_test.c
+ * \author Chris Karaplis
+ * \brief Formatter tests and a benchmark against the division based conversion
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.h"
+#include "format.h"
+#include <stdint.h>
+#include <string.h>
+
+/* Conversions per benchmark run */
+#define BENCH_CONVERSIONS   3000000UL
+
+/* Characters written to the UART since the capture was last cleared */
+static char _out[256];
+static size_t _out_len = 0;
+
+static void _test_format(void);
+static void _test_values(void);
+static int _equals(int ret, const char *expected);
+static void _bench(void);
+static char *_uint_to_ascii(unsigned int value);
+static char *_uint_to_ascii_soft(uint16_t value);
+static uint16_t _udivmod(uint16_t num, uint16_t den, int mod) __attribute__((noinline));
+
+int main(void)
+{
+    _test_format();
+    _test_values();
+    _bench();
+
+    return test_result("format_test");
+}
+
+int uart_putchar(int c)
+{
+    _out[_out_len++ % sizeof(_out)] = (char) c;
+
+    return 0;
+}
+
+int uart_write_all(const void *buf, size_t len)
+{
+    const char *str = buf;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        (void) uart_putchar(str[i]);
+    }
+
+    return (int) len;
+}
+
+/**
+ * \brief Conversions, flags and widths with known output
+ */
+static void _test_format(void)
+{
+    TEST_CHECK(_equals(format_printf("%u %u %u", 0U, 7U, 65535U), "0 7 65535"));
+    TEST_CHECK(_equals(format_printf("%5u|%05u|%2u", 42U, 42U, 12345U), "   42|00042|12345"));
+    TEST_CHECK(_equals(format_printf("%d %d %05d %5d", -1, 0, -42, -42), "-1 0 -0042   -42"));
+    TEST_CHECK(_equals(format_printf("%ld %lu", -2147483647L - 1, 4294967295UL), "-2147483648 4294967295"));
+    TEST_CHECK(_equals(format_printf("%x %04x %lx", 0xBEEFU, 0xAU, 0xDEADBEEFUL), "beef 000a deadbeef"));
+    TEST_CHECK(_equals(format_printf("a%cb%sc%%%3s", 'x', "str", "ab"), "axbstrc% ab"));
+    TEST_CHECK(_equals(format_printf("Time: %u.%03u", 3U, 5U), "Time: 3.005"));
+
+    /* Newlines are followed by a carriage return, which is not counted */
+    TEST_CHECK(format_printf("1\n2") == 3);
+    TEST_CHECK((_out_len == 4) && (memcmp(_out, "1\n\r2", 4) == 0));
+    _out_len = 0;
+
+    /* The same goes for newlines in strings and characters */
+    TEST_CHECK(format_printf("%s|%c|%3s", "a\nb", '\n', "\n") == 9);
+    TEST_CHECK((_out_len == 12) && (memcmp(_out, "a\n\rb|\n\r|  \n\r", 12) == 0));
+    _out_len = 0;
+}
+
+/**
+ * \brief Every 16-bit value and a sweep of 32-bit values against the C library
+ */
+static void _test_values(void)
+{
+    char expected[16];
+    unsigned long value;
+    int failures = 0;
+
+    for (value = 0; value <= 0xFFFFUL; value++) {
+        sprintf(expected, "%u", (unsigned int) value);
+
+        if (!_equals(format_printf("%u", (unsigned int) value), expected)) {
+            failures++;
+        }
+    }
+
+    for (value = 0x10000UL; value < 0xFFFF0000UL; value += 0x10001UL) {
+        sprintf(expected, "%lu", value);
+
+        if (!_equals(format_printf("%lu", value), expected)) {
+            failures++;
+        }
+
+        sprintf(expected, "%ld", -(long) (value >> 1));
+
+        if (!_equals(format_printf("%ld", -(long) (value >> 1)), expected)) {
+            failures++;
+        }
+    }
+
+    TEST_CHECK(failures == 0);
+}
+
+/**
+ * \brief Check the captured output and the returned count, clearing the capture
+ * \param[in] ret - the value returned by format_printf()
+ * \param[in] expected - the expected output
+ * \return non-zero if the output and count match, 0 otherwise
+ */
+static int _equals(int ret, const char *expected)
+{
+    const size_t len = strlen(expected);
+    const int equal = (ret == (int) len) && (_out_len == len) && (memcmp(_out, expected, len) == 0);
+
+    _out_len = 0;
+
+    return equal;
+}
+
+/**
+ * \brief Time the conversion of 16-bit values
+ *
+ * The old _uint_to_ascii() is timed with the host's hardware divider and
+ * with _udivmod(), a shift and subtract division like the libgcc routines
+ * which the target calls for every '/' and '%' when built with
+ * -mhwmult=none. The latter is the closer model of the target.
+ */
+static void _bench(void)
+{
+    volatile char sink = 0;
+    unsigned long i;
+    double start;
+    double hw;
+    double soft;
+    double sub;
+
+    start = test_seconds();
+
+    for (i = 0; i < BENCH_CONVERSIONS; i++) {
+        sink = _uint_to_ascii((unsigned int) (i & 0xFFFF))[0];
+    }
+
+    hw = test_seconds() - start;
+    start = test_seconds();
+
+    for (i = 0; i < BENCH_CONVERSIONS; i++) {
+        sink = _uint_to_ascii_soft((uint16_t) (i & 0xFFFF))[0];
+    }
+
+    soft = test_seconds() - start;
+    start = test_seconds();
+
+    for (i = 0; i < BENCH_CONVERSIONS; i++) {
+        _out_len = 0;
+        (void) format_printf("%u", (unsigned int) (i & 0xFFFF));
+        sink = _out[0];
+    }
+
+    sub = test_seconds() - start;
+    (void) sink;
+
+    printf("ns per 16-bit conversion: _uint_to_ascii %.1f (hardware divide), "
+           "%.1f (software divide), format_printf %.1f\n",
+           (hw * 1e9) / BENCH_CONVERSIONS, (soft * 1e9) / BENCH_CONVERSIONS,
+           (sub * 1e9) / BENCH_CONVERSIONS);
+}
+
+/**
+ * \brief The conversion replaced by the formatter, as it was in main.c
+ */
+static char *_uint_to_ascii(unsigned int value)
+{
+    static char str[7];
+    char *ptr = &str[sizeof(str) - 1];
+
+    /* NULL terminate the string */
+    *ptr = '\0';
+
+    do {
+        ptr--;
+        *ptr = (value % 10) + '0';
+        value /= 10;
+    } while (value > 0);
+
+    return ptr;
+}
+
+/**
+ * \brief The same conversion with the division routines of the target
+ */
+static char *_uint_to_ascii_soft(uint16_t value)
+{
+    static char str[7];
+    char *ptr = &str[sizeof(str) - 1];
+
+    /* NULL terminate the string */
+    *ptr = '\0';
+
+    do {
+        ptr--;
+        *ptr = (char) (_udivmod(value, 10, 1) + '0');
+        value = _udivmod(value, 10, 0);
+    } while (value > 0);
+
+    return ptr;
+}
+
+/**
+ * \brief Divide by shifting and subtracting, one quotient bit per step
+ * \param[in] num - the dividend
+ * \param[in] den - the divisor, not zero
+ * \param[in] mod - non-zero to return the remainder instead of the quotient
+ * \return the quotient or the remainder
+ */
+static uint16_t _udivmod(uint16_t num, uint16_t den, int mod)
+{
+    uint16_t bit = 1;
+    uint16_t res = 0;
+
+    while ((den < num) && (bit != 0) && ((den & 0x8000) == 0)) {
+        den <<= 1;
+        bit <<= 1;
+    }
+
+    while (bit != 0) {
+        if (num >= den) {
+            num -= den;
+            res |= bit;
+        }
+
+        bit >>= 1;
+        den >>= 1;
+    }
+
+    return mod ? num : res;
+}
@@ -0,0 +1,602 @@
+/**
+ * \file i2c_test.c
+ * \author Chris Karaplis
+ * \brief I2C driver test on the simulated USCI_B0 and a 24xx EEPROM
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.h"
+#include "i2c.h"
+#include "usci_b0.h"
+#include "eeprom_24xx.h"
+#include <stdint.h>
+#include <string.h>
+#include <msp430.h>
+
+/* Address of the EEPROM and of a missing device */
+#define EEPROM_ADDRESS  0x50
+#define MISSING_ADDRESS 0x51
+
+/* Size of the transfers timed by _bench() */
+#define BENCH_LEN   16
+
+/* From timer.h, which clashes with the POSIX timers declared by <time.h> */
+int timer_init(void);
+
+/* Timer tick interrupt handler, every 100ms */
+void timer1_isr(void);
+
+static const struct i2c_device _dev = {EEPROM_ADDRESS, 0};
+static const struct i2c_device _missing = {MISSING_ADDRESS, 0};
+
+/* Result and number of calls of _callback() */
+static int _callback_err = 0;
+static unsigned int _callback_calls = 0;
+
+static void _test_init(void);
+static void _test_transfer(void);
+static void _test_nack(void);
+static void _test_busy(void);
+static void _test_async(void);
+static void _test_msgs(void);
+static void _test_jobs(void);
+static void _test_timeout(void);
+static void _test_arb_lost(void);
+static void _test_rates(void);
+static void _bench(void);
+static void _run(void);
+static void _callback(int err, void *arg);
+static void _eeprom(double write_time_us);
+static int _transfer(const struct i2c_device *dev, const void *tx, size_t tx_len, void *rx, size_t rx_len);
+
+int main(void)
+{
+    struct i2c_config config = {100000, 0};
+
+    sim_sleep = sim_ucb0_run;
+    sim_timer1_a0 = timer1_isr;
+    sim_ucb0_attach(&sim_24xx);
+    (void) timer_init();
+    (void) i2c_init(&config);
+
+    _test_init();
+    _test_transfer();
+    _test_nack();
+    _test_busy();
+    _test_async();
+    _test_msgs();
+    _test_jobs();
+    _test_timeout();
+    _test_arb_lost();
+    _test_rates();
+    _bench();
+
+    return test_result("i2c_test");
+}
+
+/**
+ * \brief SMCLK frequency, as set by the board
+ */
+uint32_t board_get_smclk(void)
+{
+    return 1000000;
+}
+
+/**
+ * \brief The watchdog is not simulated
+ */
+void watchdog_pet(void)
+{
+}
+
+/**
+ * \brief Check the bus rates and the prescalers
+ */
+static void _test_init(void)
+{
+    struct i2c_config config = {100000, 0};
+    const struct i2c_device fast = {EEPROM_ADDRESS, 400000};
+    const struct i2c_device slow = {EEPROM_ADDRESS, 30000};
+
+    TEST_CHECK(i2c_init(NULL) == -1);
+    config.bus_hz = 0;
+    TEST_CHECK(i2c_init(&config) == -1);
+
+    /* The rate is never faster than requested, at most SMCLK / 4 */
+    config.bus_hz = 100000;
+    TEST_CHECK(i2c_init(&config) == 0);
+    TEST_CHECK((config.actual_hz == 100000) && (UCB0BR0 == 10) && (UCB0BR1 == 0));
+    TEST_CHECK((UCB0CTL0 & UCMST) && (UCB0I2CIE & UCALIE) && (UCB0I2CIE & UCNACKIE));
+    TEST_CHECK(i2c_bus_hz(NULL) == 100000);
+    TEST_CHECK(i2c_bus_hz(&_dev) == 100000);
+    TEST_CHECK(i2c_bus_hz(&fast) == 250000);
+    TEST_CHECK(i2c_bus_hz(&slow) == 29411);
+}
+
+/**
+ * \brief Check writes, reads with a repeated start and current address reads
+ */
+static void _test_transfer(void)
+{
+    const uint8_t write[] = {0x10, 1, 2, 3};
+    uint8_t address = 0x10;
+    uint8_t read[3] = {0};
+
+    _eeprom(0);
+
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == 0);
+    TEST_CHECK((sim_24xx_mem[0x10] == 1) && (sim_24xx_mem[0x11] == 2) && (sim_24xx_mem[0x12] == 3));
+    TEST_CHECK((sim_ucb0_stats.starts == 1) && (sim_ucb0_stats.stops == 1) && (sim_ucb0_stats.bytes == 5));
+
+    /* Random read, the address followed by a repeated start */
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(_transfer(&_dev, &address, 1, read, 3) == 0);
+    TEST_CHECK((read[0] == 1) && (read[1] == 2) && (read[2] == 3));
+    TEST_CHECK((sim_ucb0_stats.starts == 2) && (sim_ucb0_stats.stops == 1) && (sim_ucb0_stats.bytes == 6));
+
+    /* Single byte read, which needs the stop before the byte is received */
+    address = 0x11;
+    TEST_CHECK(_transfer(&_dev, &address, 1, read, 1) == 0);
+    TEST_CHECK(read[0] == 2);
+
+    /* Current address read */
+    TEST_CHECK(_transfer(&_dev, NULL, 0, read, 2) == 0);
+    TEST_CHECK((read[0] == 3) && (read[1] == 0xFF));
+
+    /* Empty transfer, an address poll */
+    TEST_CHECK(_transfer(&_dev, NULL, 0, NULL, 0) == 0);
+    TEST_CHECK(i2c_transfer(&_dev, NULL) == -1);
+    TEST_CHECK(i2c_transfer(NULL, NULL) == -1);
+}
+
+/**
+ * \brief Check address and data NACKs
+ */
+static void _test_nack(void)
+{
+    const uint8_t write[] = {0x20, 4, 5, 6};
+    uint8_t read[2];
+    int i;
+
+    _eeprom(0);
+
+    /* Address NACK on a write, a read and a poll */
+    TEST_CHECK(_transfer(&_missing, write, sizeof(write), NULL, 0) == I2C_ERR_NACK_ADDR);
+    TEST_CHECK(_transfer(&_missing, NULL, 0, read, sizeof(read)) == I2C_ERR_NACK_ADDR);
+    TEST_CHECK(_transfer(&_missing, NULL, 0, NULL, 0) == I2C_ERR_NACK_ADDR);
+    TEST_CHECK(sim_ucb0_stats.stops == 3);
+    TEST_CHECK(_transfer(&_dev, NULL, 0, NULL, 0) == 0);
+
+    /* Data NACK on each byte, the write is aborted with a stop */
+    for (i = 0; i < (int) sizeof(write); i++) {
+        memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+        sim_ucb0_nack_at = i;
+        TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == I2C_ERR_NACK_DATA);
+        TEST_CHECK((sim_ucb0_stats.stops == 1) && (sim_ucb0_stats.bytes == (unsigned long) (i + 2)));
+    }
+
+    /* The bytes before the NACK were written */
+    TEST_CHECK((sim_24xx_mem[0x20] == 4) && (sim_24xx_mem[0x21] == 5) && (sim_24xx_mem[0x22] == 0xFF));
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == 0);
+    TEST_CHECK(sim_24xx_mem[0x22] == 6);
+}
+
+/**
+ * \brief Check that the EEPROM does not ACK during its write cycle
+ */
+static void _test_busy(void)
+{
+    const uint8_t write[] = {0x30, 0xA5};
+    const double write_time_us = 5000;
+    uint8_t read = 0;
+    unsigned int polls = 0;
+    double start;
+
+    _eeprom(write_time_us);
+
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == 0);
+    start = sim_time_us;
+
+    /* Poll until the write cycle has completed */
+    while ((_transfer(&_dev, NULL, 0, NULL, 0) == I2C_ERR_NACK_ADDR) && (polls < 1000)) {
+        polls++;
+    }
+
+    TEST_CHECK((polls > 0) && (polls == sim_24xx_stats.busy_nacks));
+    TEST_CHECK(((sim_time_us - start) >= write_time_us) && ((sim_time_us - start) < (write_time_us + 1000)));
+    TEST_CHECK((_transfer(&_dev, write, 1, &read, 1) == 0) && (read == 0xA5));
+}
+
+/**
+ * \brief Check that an asynchronous transfer runs from the interrupts
+ */
+static void _test_async(void)
+{
+    const uint8_t write[] = {0x40, 7, 8, 9};
+    uint8_t address = 0x40;
+    uint8_t read[3] = {0};
+    struct i2c_data data;
+    double start;
+
+    _eeprom(0);
+    _callback_calls = 0;
+
+    data.tx_buf = write;
+    data.tx_len = sizeof(write);
+    data.rx_buf = NULL;
+    data.rx_len = 0;
+
+    /* The call returns once the start condition is requested */
+    start = sim_time_us;
+    TEST_CHECK(i2c_transfer_async(&_dev, &data, _callback, &data) == 0);
+    TEST_CHECK((sim_time_us - start) < 100);
+    TEST_CHECK((i2c_busy() != 0) && (_callback_calls == 0));
+
+    /* Only one transfer at a time */
+    TEST_CHECK(i2c_transfer_async(&_dev, &data, _callback, &data) == -1);
+    TEST_CHECK(i2c_recover() == -1);
+
+    _run();
+    TEST_CHECK((_callback_calls == 1) && (_callback_err == 0));
+    TEST_CHECK((sim_24xx_mem[0x40] == 7) && (sim_24xx_mem[0x42] == 9));
+
+    /* One interrupt per byte, the CPU sleeps in between */
+    TEST_CHECK(sim_ucb0_stats.isrs <= (sim_ucb0_stats.bytes + 1));
+
+    data.tx_buf = &address;
+    data.tx_len = 1;
+    data.rx_buf = read;
+    data.rx_len = sizeof(read);
+    TEST_CHECK(i2c_transfer_async(&_dev, &data, _callback, &data) == 0);
+    _run();
+    TEST_CHECK((_callback_calls == 2) && (_callback_err == 0));
+    TEST_CHECK((read[0] == 7) && (read[1] == 8) && (read[2] == 9));
+
+    /* Errors are reported through the callback */
+    TEST_CHECK(i2c_transfer_async(&_missing, &data, _callback, &data) == 0);
+    _run();
+    TEST_CHECK((_callback_calls == 3) && (_callback_err == I2C_ERR_NACK_ADDR));
+
+    TEST_CHECK(i2c_transfer_async(&_dev, NULL, _callback, NULL) == -1);
+}
+
+/**
+ * \brief Check transfers made of several messages
+ */
+static void _test_msgs(void)
+{
+    static uint8_t reg = 0x20;
+    static uint8_t reg2 = 0x21;
+    static uint8_t p1[] = {7, 8};
+    static uint8_t p2[] = {9};
+    static uint8_t g[4] = {0};
+    static uint8_t x[1] = {0};
+    static const struct i2c_msg gather[] = {{&reg, 1, I2C_MSG_NOSTOP}, {p1, 2, I2C_MSG_NOSTOP}, {p2, 1, 0}};
+    static const struct i2c_msg scatter[] = {{&reg, 1, I2C_MSG_NOSTOP}, {g, 1, I2C_MSG_READ | I2C_MSG_NOSTOP},
+                                      {g + 1, 2, I2C_MSG_READ}};
+    static const struct i2c_msg mixed[] = {{&reg2, 1, 0}, {x, 1, I2C_MSG_READ | I2C_MSG_NOSTOP},
+                                    {&reg, 1, I2C_MSG_NOSTOP}, {g, 0, I2C_MSG_NOSTOP},
+                                    {g + 3, 1, I2C_MSG_READ}};
+    static const struct i2c_msg empty_read[] = {{g, 0, I2C_MSG_READ}};
+
+    _eeprom(0);
+
+    /* Writes joined without a new start */
+    TEST_CHECK(i2c_transfer_msgs(&_dev, gather, 3) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK((sim_24xx_mem[0x20] == 7) && (sim_24xx_mem[0x21] == 8) && (sim_24xx_mem[0x22] == 9));
+    TEST_CHECK((sim_ucb0_stats.starts == 1) && (sim_ucb0_stats.stops == 1));
+
+    /* Reads joined without a new start */
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(i2c_transfer_msgs(&_dev, scatter, 3) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK((g[0] == 7) && (g[1] == 8) && (g[2] == 9));
+    TEST_CHECK((sim_ucb0_stats.starts == 2) && (sim_ucb0_stats.stops == 1));
+
+    /* A read followed by a write ends with a stop */
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+    TEST_CHECK(i2c_transfer_msgs(&_dev, mixed, 5) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK((x[0] == 8) && (g[3] == 7));
+    TEST_CHECK((sim_ucb0_stats.starts == 4) && (sim_ucb0_stats.stops == 3));
+
+    TEST_CHECK(i2c_transfer_msgs(&_dev, empty_read, 1) == -1);
+    TEST_CHECK(i2c_transfer_msgs(&_dev, NULL, 1) == -1);
+    TEST_CHECK(i2c_transfer_msgs(&_dev, gather, 0) == -1);
+    TEST_CHECK(i2c_transfer_msgs(&_missing, scatter, 3) == I2C_ERR_NACK_ADDR);
+    sim_ucb0_idle();
+}
+
+/**
+ * \brief Check the job queue and its statistics
+ */
+static void _test_jobs(void)
+{
+    static const uint8_t init[] = {0x10, 1, 2};
+    static uint8_t address = 0x10;
+    static uint8_t read[2] = {0};
+    static uint8_t write[] = {0x30, 5};
+    static const struct i2c_msg m1[] = {{&address, 1, I2C_MSG_NOSTOP}, {read, 2, I2C_MSG_READ}};
+    static const struct i2c_msg m2[] = {{write, 2, 0}};
+    static const struct i2c_msg m3[] = {{write, 0, 0}};
+    struct i2c_job j1 = {NULL, NULL, 0, 0, 0, 0};
+    struct i2c_job j2 = {NULL, NULL, 0, 0, 0, 0};
+    struct i2c_job j3 = {NULL, NULL, 0, 0, 0, 0};
+    struct i2c_job j4 = {NULL, NULL, 0, 0, 0, 0};
+    struct i2c_data data;
+    struct i2c_stats stats;
+
+    _eeprom(0);
+    TEST_CHECK(_transfer(&_dev, init, sizeof(init), NULL, 0) == 0);
+    _callback_calls = 0;
+
+    j1.dev = &_dev;
+    j1.msgs = m1;
+    j1.count = 2;
+    j2 = j1;
+    j2.dev = &_missing;
+    j3.dev = &_dev;
+    j3.msgs = m2;
+    j3.count = 1;
+    j4 = j3;
+    j4.msgs = m3;
+
+    TEST_CHECK(i2c_get_stats(&stats, 1) == 0);
+    TEST_CHECK(i2c_get_stats(NULL, 0) == -1);
+    TEST_CHECK(i2c_submit(NULL) == -1);
+
+    /* Jobs run back to back in the order they were submitted */
+    TEST_CHECK((i2c_submit(&j1) == 0) && (i2c_submit(&j2) == 0) && (i2c_submit(&j3) == 0) && (i2c_submit(&j4) == 0));
+    TEST_CHECK((i2c_get_stats(&stats, 0) == 0) && (stats.depth == 4) && (stats.peak == 4));
+    TEST_CHECK((j1.status == I2C_JOB_PENDING) && (j4.status == I2C_JOB_PENDING));
+
+    data.tx_buf = write;
+    data.tx_len = sizeof(write);
+    data.rx_buf = NULL;
+    data.rx_len = 0;
+    TEST_CHECK(i2c_transfer_async(&_dev, &data, _callback, NULL) == -1);
+
+    TEST_CHECK(i2c_wait(&j4) == 0);
+    sim_ucb0_idle();
+    TEST_CHECK((j1.status == 0) && (read[0] == 1) && (read[1] == 2));
+    TEST_CHECK(j2.status == I2C_ERR_NACK_ADDR);
+    TEST_CHECK((j3.status == 0) && (sim_24xx_mem[0x30] == 5));
+
+    TEST_CHECK((i2c_get_stats(&stats, 1) == 0) && (stats.depth == 0) && (stats.completed == 4) && (stats.errors == 1));
+    TEST_CHECK((stats.latency_max_us > 0) && (stats.latency_total_us >= stats.latency_max_us));
+    TEST_CHECK((i2c_get_stats(&stats, 0) == 0) && (stats.completed == 0) && (stats.peak == 0));
+
+    /* A job submitted during an asynchronous transfer waits for it */
+    TEST_CHECK(i2c_transfer_async(&_dev, &data, _callback, NULL) == 0);
+    TEST_CHECK((i2c_submit(&j1) == 0) && (j1.status == I2C_JOB_PENDING));
+    TEST_CHECK(i2c_wait(&j1) == 0);
+    TEST_CHECK((_callback_calls == 1) && (_callback_err == 0));
+    sim_ucb0_idle();
+}
+
+/**
+ * \brief Check the timeout of a transfer on a hung bus and the recovery
+ */
+static void _test_timeout(void)
+{
+    static uint8_t write[] = {0x50, 1};
+    static const struct i2c_msg msgs[] = {{write, sizeof(write), 0}};
+    struct i2c_job job = {NULL, NULL, 0, 500, 0, 0};
+    double start;
+    double elapsed;
+
+    _eeprom(0);
+
+    /* The pins read high once the bus has been released */
+    P1IN = BIT6 | BIT7;
+    P1SEL = 0;
+    sim_ucb0_fault = SIM_UCB0_FAULT_HUNG;
+    start = sim_time_us;
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == I2C_ERR_TIMEOUT);
+    elapsed = sim_time_us - start;
+    TEST_CHECK((elapsed >= ((I2C_TIMEOUT_MS - 100) * 1000.0)) && (elapsed <= (I2C_TIMEOUT_MS * 1000.0)));
+
+    /* The bus was recovered and the driver keeps working */
+    TEST_CHECK(sim_ucb0_fault == SIM_UCB0_FAULT_NONE);
+    TEST_CHECK(((P1SEL & (BIT6 | BIT7)) == (BIT6 | BIT7)) && (UCB0CTL0 & UCMST) && (UCB0I2CIE & UCALIE));
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == 0);
+    TEST_CHECK(sim_24xx_mem[0x50] == 1);
+
+    /* A job with its own timeout */
+    job.dev = &_dev;
+    job.msgs = msgs;
+    job.count = 1;
+    sim_ucb0_fault = SIM_UCB0_FAULT_HUNG;
+    start = sim_time_us;
+    TEST_CHECK((i2c_submit(&job) == 0) && (i2c_wait(&job) == I2C_ERR_TIMEOUT));
+    elapsed = sim_time_us - start;
+    TEST_CHECK((elapsed >= 400000.0) && (elapsed <= 500000.0));
+    sim_ucb0_idle();
+
+    /* Recovery fails while a slave holds SDA low */
+    TEST_CHECK(i2c_recover() == 0);
+    P1IN = BIT6;
+    TEST_CHECK(i2c_recover() == -1);
+    P1IN = BIT6 | BIT7;
+}
+
+/**
+ * \brief Check that a transfer which loses arbitration fails and the driver recovers
+ */
+static void _test_arb_lost(void)
+{
+    const uint8_t write[] = {0x60, 1, 2};
+
+    _eeprom(0);
+
+    sim_ucb0_fault = SIM_UCB0_FAULT_ARB_LOST;
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == I2C_ERR_ARB_LOST);
+    TEST_CHECK((sim_ucb0_fault == SIM_UCB0_FAULT_NONE) && (UCB0CTL0 & UCMST) && (UCB0I2CIE & UCALIE));
+    TEST_CHECK(_transfer(&_dev, write, sizeof(write), NULL, 0) == 0);
+    TEST_CHECK((sim_24xx_mem[0x60] == 1) && (sim_24xx_mem[0x61] == 2));
+}
+
+/**
+ * \brief Check that each device gets its own bus rate
+ */
+static void _test_rates(void)
+{
+    const uint8_t write[] = {0x70, 0xAA};
+    const struct i2c_device fast = {EEPROM_ADDRESS, 400000};
+    const struct i2c_device slow = {EEPROM_ADDRESS, 30000};
+    double start;
+    double normal;
+
+    _eeprom(0);
+
+    start = sim_time_us;
+    TEST_CHECK((_transfer(&_dev, write, sizeof(write), NULL, 0) == 0) && (UCB0BR0 == 10) && (UCB0BR1 == 0));
+    normal = sim_time_us - start;
+    TEST_CHECK(sim_24xx_mem[0x70] == 0xAA);
+
+    start = sim_time_us;
+    TEST_CHECK((_transfer(&fast, write, sizeof(write), NULL, 0) == 0) && (UCB0BR0 == 4) && (UCB0BR1 == 0));
+    TEST_CHECK((sim_time_us - start) < (normal / 2));
+
+    start = sim_time_us;
+    TEST_CHECK((_transfer(&slow, write, sizeof(write), NULL, 0) == 0) && (UCB0BR0 == 34));
+    TEST_CHECK((sim_time_us - start) > (normal * 3));
+
+    TEST_CHECK((_transfer(&_dev, write, sizeof(write), NULL, 0) == 0) && (UCB0BR0 == 10));
+}
+
+/**
+ * \brief Time transfers on the simulated bus
+ *
+ * The time includes the bus, the interrupt latency, with isr_us per
+ * interrupt, and the driver's setup between transfers.
+ */
+static void _bench(void)
+{
+    static const uint32_t rates[] = {100000, 250000};
+    static const double isr_us[] = {0, 20};
+    uint8_t buf[BENCH_LEN + 1];
+    size_t i;
+    size_t j;
+
+    _eeprom(0);
+    memset(buf, 0, sizeof(buf));
+
+    printf("bus rate   isr us   write %u B us   read %u B us   1 B read us   isrs/byte\n",
+           BENCH_LEN, BENCH_LEN);
+
+    for (i = 0; i < (sizeof(rates) / sizeof(rates[0])); i++) {
+        for (j = 0; j < (sizeof(isr_us) / sizeof(isr_us[0])); j++) {
+            struct i2c_device dev = {EEPROM_ADDRESS, 0};
+            double write;
+            double read;
+            double one;
+            double start;
+
+            dev.bus_hz = rates[i];
+            sim_ucb0_timing.isr_us = isr_us[j];
+            memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+
+            start = sim_time_us;
+            TEST_CHECK(_transfer(&dev, buf, sizeof(buf), NULL, 0) == 0);
+            write = sim_time_us - start;
+
+            start = sim_time_us;
+            TEST_CHECK(_transfer(&dev, buf, 1, buf + 1, BENCH_LEN) == 0);
+            read = sim_time_us - start;
+
+            start = sim_time_us;
+            TEST_CHECK(_transfer(&dev, buf, 1, buf + 1, 1) == 0);
+            one = sim_time_us - start;
+
+            printf("%8lu   %6.0f   %13.0f   %12.0f   %11.0f   %9.2f\n",
+                   (unsigned long) i2c_bus_hz(&dev), isr_us[j], write, read, one,
+                   (double) sim_ucb0_stats.isrs / (double) sim_ucb0_stats.bytes);
+        }
+    }
+
+    sim_ucb0_timing.isr_us = 0;
+}
+
+/**
+ * \brief Sleep until the transfer in progress has completed
+ */
+static void _run(void)
+{
+    while (i2c_busy() != 0) {
+        __bis_SR_register(LPM0_bits | GIE);
+    }
+
+    sim_ucb0_idle();
+}
+
+/**
+ * \brief Completion callback of the asynchronous transfers
+ */
+static void _callback(int err, void *arg)
+{
+    (void) arg;
+
+    _callback_err = err;
+    _callback_calls++;
+}
+
+/**
+ * \brief Reset the EEPROM, a 24C02, and the bus statistics
+ * \param[in] write_time_us - the duration of the write cycle
+ */
+static void _eeprom(double write_time_us)
+{
+    struct sim_24xx_config config = {EEPROM_ADDRESS, 256, 8, 1, 0};
+
+    config.write_time_us = write_time_us;
+    sim_24xx_init(&config);
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+}
+
+/**
+ * \brief Perform a transfer and let the bus return to idle
+ * \return the result of i2c_transfer()
+ */
+static int _transfer(const struct i2c_device *dev, const void *tx, size_t tx_len, void *rx, size_t rx_len)
+{
+    struct i2c_data data;
+    int err;
+
+    data.tx_buf = tx;
+    data.tx_len = tx_len;
+    data.rx_buf = rx;
+    data.rx_len = rx_len;
+
+    err = i2c_transfer(dev, &data);
+    sim_ucb0_idle();
+
+    return err;
+}
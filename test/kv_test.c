@@ -0,0 +1,431 @@
+/**
+ * \file kv_test.c
+ * \author Chris Karaplis
+ * \brief Key-value store tests against the simulated bus and 24xx EEPROM
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include "test.h"
+#include "kv.h"
+#include "eeprom_cache.h"
+#include "crc16.h"
+#include "i2c.h"
+#include "usci_b0.h"
+#include "eeprom_24xx.h"
+#include <stdint.h>
+#include <string.h>
+#include <msp430.h>
+
+/* Base address of the EEPROM */
+#define EEPROM_ADDRESS  0x50
+
+/* Write cycle of a 24C02 */
+#define WRITE_TIME_US   5000
+
+/* Size of a record header, as laid out by kv.c */
+#define HEADER_SIZE     6
+
+/* From timer.h, which clashes with the POSIX timers declared by <time.h> */
+int timer_init(void);
+
+/* Timer tick interrupt handler, every 100ms */
+void timer1_isr(void);
+
+static const struct eeprom _24c02 = {{EEPROM_ADDRESS, 0}, 256, 8, 1};
+
+static void _test_args(void);
+static void _test_boot(void);
+static void _test_power_cut(void);
+static void _test_sequence(void);
+static void _test_compaction(void);
+static void _test_full(void);
+static void _test_poll(void);
+static int _check(uint8_t key, const void *value, size_t len);
+static void _record(uint8_t sector, uint16_t pos, uint8_t key, uint16_t seq, const char *value);
+static int _erased(uint8_t sector);
+static uint16_t _addr(uint8_t sector, uint16_t pos);
+static void _boot(void);
+static void _device(void);
+
+int main(void)
+{
+    struct i2c_config config = {100000, 0};
+
+    sim_sleep = sim_ucb0_run;
+    sim_timer1_a0 = timer1_isr;
+    sim_ucb0_attach(&sim_24xx);
+    __enable_interrupt();
+    (void) timer_init();
+    (void) i2c_init(&config);
+
+    _test_args();
+    _test_boot();
+    _test_power_cut();
+    _test_sequence();
+    _test_compaction();
+    _test_full();
+    _test_poll();
+
+    return test_result("kv_test");
+}
+
+/**
+ * \brief SMCLK frequency, as set by the board
+ */
+uint32_t board_get_smclk(void)
+{
+    return 1000000;
+}
+
+/**
+ * \brief The watchdog is not simulated
+ */
+void watchdog_pet(void)
+{
+}
+
+/**
+ * \brief Check the argument validation
+ */
+static void _test_args(void)
+{
+    uint8_t buf[KV_VALUE_MAX + 1];
+
+    memset(buf, 0, sizeof(buf));
+
+    /* Nothing works before the store is initialized */
+    TEST_CHECK(kv_set(0, buf, 1) == -1);
+    TEST_CHECK(kv_get(0, buf, sizeof(buf)) == -1);
+    TEST_CHECK(kv_poll() == 0);
+
+    _device();
+    TEST_CHECK(kv_set(KV_KEYS, buf, 1) == -1);
+    TEST_CHECK(kv_set(0, NULL, 1) == -1);
+    TEST_CHECK(kv_set(0, buf, KV_VALUE_MAX + 1) == -1);
+    TEST_CHECK(kv_get(0, buf, sizeof(buf)) == -1);
+
+    /* The value must fit in the buffer */
+    TEST_CHECK(kv_set(0, "abc", 3) == 0);
+    TEST_CHECK(kv_get(0, buf, 2) == -1);
+    TEST_CHECK(kv_get(0, NULL, 3) == -1);
+    TEST_CHECK(kv_get(KV_KEYS, buf, sizeof(buf)) == -1);
+}
+
+/**
+ * \brief The index is rebuilt from the records at boot
+ */
+static void _test_boot(void)
+{
+    _device();
+
+    TEST_CHECK(kv_set(0, "old", 3) == 0);
+    TEST_CHECK(kv_set(1, "xy", 2) == 0);
+    TEST_CHECK(kv_set(2, NULL, 0) == 0);
+    TEST_CHECK(kv_set(0, "new", 3) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+
+    _boot();
+    TEST_CHECK(_check(0, "new", 3));
+    TEST_CHECK(_check(1, "xy", 2));
+    TEST_CHECK(_check(2, NULL, 0));
+    TEST_CHECK(_check(3, NULL, 0) == 0);
+
+    /* The sequence numbers carry on, so a record written now is the newest */
+    TEST_CHECK(kv_set(1, "z", 1) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    _boot();
+    TEST_CHECK(_check(1, "z", 1));
+    TEST_CHECK(_check(0, "new", 3));
+}
+
+/**
+ * \brief Records lost or torn by a power cut are ignored
+ */
+static void _test_power_cut(void)
+{
+    const uint16_t torn = _addr(0, HEADER_SIZE + 3);
+
+    _device();
+
+    TEST_CHECK(kv_set(0, "old", 3) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+
+    /* A record still in the cache is lost */
+    TEST_CHECK(kv_set(0, "new", 3) == 0);
+    _boot();
+    TEST_CHECK(_check(0, "old", 3));
+
+    /* A record whose value was not completely written fails its CRC */
+    TEST_CHECK(kv_set(0, "new", 3) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK(memcmp(&sim_24xx_mem[torn + HEADER_SIZE], "new", 3) == 0);
+    sim_24xx_mem[torn + HEADER_SIZE + 2] = 0xFF;
+    _boot();
+    TEST_CHECK(_check(0, "old", 3));
+
+    /* So does one with only the start of its header written */
+    memset(&sim_24xx_mem[torn], 0xFF, HEADER_SIZE + 3);
+    sim_24xx_mem[torn] = 0;
+    sim_24xx_mem[torn + 1] = 3;
+    _boot();
+    TEST_CHECK(_check(0, "old", 3));
+
+    /* The next record takes the place of the torn one */
+    TEST_CHECK(kv_set(0, "abc", 3) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK((sim_24xx_mem[torn] == 0) && (memcmp(&sim_24xx_mem[torn + HEADER_SIZE], "abc", 3) == 0));
+    _boot();
+    TEST_CHECK(_check(0, "abc", 3));
+}
+
+/**
+ * \brief The newest record wins whichever sector it is in, across wrap around
+ */
+static void _test_sequence(void)
+{
+    const uint16_t next = _addr(0, 2 * (HEADER_SIZE + 1));
+
+    _device();
+
+    /* The log went round from sector 2 to sector 0, as did the sequence */
+    _record(2, 0, 1, 0xFFFD, "d");
+    _record(2, HEADER_SIZE + 1, 0, 0xFFFE, "a");
+    _record(3, 0, 0, 0xFFFF, "b");
+    _record(0, 0, 0, 0x0000, "c");
+    _record(0, HEADER_SIZE + 1, 2, 0x0001, "e");
+    _boot();
+    TEST_CHECK(_check(0, "c", 1));
+    TEST_CHECK(_check(1, "d", 1));
+    TEST_CHECK(_check(2, "e", 1));
+
+    /* Records are appended after the newest one, numbered after it */
+    TEST_CHECK(kv_set(3, "f", 1) == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK((sim_24xx_mem[next] == 3) && (sim_24xx_mem[next + 2] == 2) && (sim_24xx_mem[next + 3] == 0));
+    _boot();
+    TEST_CHECK(_check(3, "f", 1));
+}
+
+/**
+ * \brief Old sectors are compacted as the log goes round, live records move
+ */
+static void _test_compaction(void)
+{
+    uint8_t value[KV_VALUE_MAX];
+    unsigned int i;
+
+    _device();
+
+    TEST_CHECK(kv_set(1, "keep", 4) == 0);
+
+    /* Goes round the sectors several times */
+    for (i = 0; i < ((3 * KV_SECTORS * KV_SECTOR_SIZE) / (HEADER_SIZE + KV_VALUE_MAX)); i++) {
+        memset(value, (int) i, sizeof(value));
+        TEST_CHECK(kv_set(0, value, sizeof(value)) == 0);
+        TEST_CHECK(_check(0, value, sizeof(value)));
+    }
+
+    TEST_CHECK(_check(1, "keep", 4));
+    TEST_CHECK(eeprom_cache_flush() == 0);
+
+    /* The record of key 1 was first written at the start of sector 0 */
+    TEST_CHECK(memcmp(&sim_24xx_mem[_addr(0, HEADER_SIZE)], "keep", 4) != 0);
+
+    _boot();
+    TEST_CHECK(_check(0, value, sizeof(value)));
+    TEST_CHECK(_check(1, "keep", 4));
+}
+
+/**
+ * \brief Values which would not fit after compaction are refused
+ */
+static void _test_full(void)
+{
+    uint8_t value[KV_VALUE_MAX];
+    unsigned int i;
+
+    _device();
+    memset(value, 0x5A, sizeof(value));
+
+    /* The live records must fit in all but two sectors */
+    TEST_CHECK(kv_set(0, value, sizeof(value)) == 0);
+    TEST_CHECK(kv_set(1, value, sizeof(value)) == 0);
+    TEST_CHECK(kv_set(2, value, sizeof(value)) == -1);
+    TEST_CHECK(_check(2, NULL, 0) == 0);
+    TEST_CHECK(kv_set(2, "ab", 2) == 0);
+
+    /* A full store can still be updated */
+    for (i = 0; i < (2 * KV_SECTORS); i++) {
+        value[0] = (uint8_t) i;
+        TEST_CHECK(kv_set(i % 2, value, sizeof(value)) == 0);
+    }
+
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    _boot();
+    TEST_CHECK(_check(1, value, sizeof(value)));
+    value[0]--;
+    TEST_CHECK(_check(0, value, sizeof(value)));
+    TEST_CHECK(_check(2, "ab", 2));
+}
+
+/**
+ * \brief The oldest sector is compacted in the background once one is free
+ */
+static void _test_poll(void)
+{
+    uint8_t value[KV_VALUE_MAX];
+    unsigned long cycles;
+    unsigned int i;
+
+    _device();
+    memset(value, 0, sizeof(value));
+
+    /* Two records per sector, the fifth uses up the second to last free sector */
+    for (i = 0; i < 4; i++) {
+        value[0] = (uint8_t) i;
+        TEST_CHECK(kv_set(0, value, sizeof(value)) == 0);
+        TEST_CHECK(kv_poll() == 0);
+    }
+
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK(_erased(0) == 0);
+
+    value[0] = 4;
+    TEST_CHECK(kv_set(0, value, sizeof(value)) == 0);
+    TEST_CHECK(kv_poll() == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK(_erased(0) && !_erased(1));
+
+    /* With two free sectors again there is nothing to do */
+    cycles = sim_24xx_stats.write_cycles;
+    TEST_CHECK(kv_poll() == 0);
+    TEST_CHECK(eeprom_cache_flush() == 0);
+    TEST_CHECK(sim_24xx_stats.write_cycles == cycles);
+
+    _boot();
+    TEST_CHECK(_check(0, value, sizeof(value)));
+}
+
+/**
+ * \brief Check the value of a key
+ * \param[in] key - the key
+ * \param[in] value - the expected value
+ * \param[in] len - the length of the expected value
+ * \return non-zero if the key has this value, 0 otherwise
+ */
+static int _check(uint8_t key, const void *value, size_t len)
+{
+    uint8_t buf[KV_VALUE_MAX];
+
+    return (kv_get(key, buf, sizeof(buf)) == (int) len) && ((len == 0) || (memcmp(buf, value, len) == 0));
+}
+
+/**
+ * \brief Write a record straight to the simulated EEPROM
+ * \param[in] sector - the sector
+ * \param[in] pos - the offset in the sector
+ * \param[in] key - the key
+ * \param[in] seq - the sequence number
+ * \param[in] value - the value, a string
+ */
+static void _record(uint8_t sector, uint16_t pos, uint8_t key, uint16_t seq, const char *value)
+{
+    uint8_t *const rec = &sim_24xx_mem[_addr(sector, pos)];
+    const size_t len = strlen(value);
+    uint16_t crc;
+
+    rec[0] = key;
+    rec[1] = (uint8_t) len;
+    rec[2] = seq & 0xFF;
+    rec[3] = seq >> 8;
+
+    crc = crc16(crc16(CRC16_INIT, rec, 4), value, len);
+    rec[4] = crc & 0xFF;
+    rec[5] = crc >> 8;
+    memcpy(&rec[HEADER_SIZE], value, len);
+}
+
+/**
+ * \brief Check whether a sector of the simulated EEPROM is erased
+ * \param[in] sector - the sector
+ * \return non-zero if every byte is 0xFF, 0 otherwise
+ */
+static int _erased(uint8_t sector)
+{
+    uint16_t pos;
+    int erased = 1;
+
+    for (pos = 0; pos < KV_SECTOR_SIZE; pos++) {
+        if (sim_24xx_mem[_addr(sector, pos)] != 0xFF) {
+            erased = 0;
+        }
+    }
+
+    return erased;
+}
+
+/**
+ * \brief Get the EEPROM address of a position in a sector
+ * \param[in] sector - the sector
+ * \param[in] pos - the offset in the sector
+ * \return the address
+ */
+static uint16_t _addr(uint8_t sector, uint16_t pos)
+{
+    return KV_BASE + (sector * KV_SECTOR_SIZE) + pos;
+}
+
+/**
+ * \brief Restart the store, dropping what the cache had not written back
+ */
+static void _boot(void)
+{
+    TEST_CHECK(eeprom_cache_init(&_24c02) == 0);
+    TEST_CHECK(kv_init() == 0);
+}
+
+/**
+ * \brief Reset the simulated 24C02, erased, and boot the store on it
+ */
+static void _device(void)
+{
+    struct sim_24xx_config config;
+
+    config.address = _24c02.dev.address;
+    config.size = _24c02.size;
+    config.page_size = _24c02.page_size;
+    config.addr_width = _24c02.addr_width;
+    config.write_time_us = WRITE_TIME_US;
+    sim_24xx_init(&config);
+    memset(&sim_ucb0_stats, 0, sizeof(sim_ucb0_stats));
+
+    _boot();
+}
@@ -0,0 +1,335 @@
+/**
+ * \file proto_test.c
+ * \author Chris Karaplis
+ * \brief Binary protocol loopback tests, with the COBS and CRC-16 codecs
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.h"
+#include "proto.h"
+#include "cobs.h"
+#include "crc16.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Size of the loopback buffers in each direction */
+#define LOOP_SIZE   1024
+
+/* Command handled by _echo() */
+#define CMD_ECHO    0x01
+
+/* Command handled by _fail() */
+#define CMD_FAIL    0x02
+
+/* Host to device loopback buffer */
+static uint8_t _in[LOOP_SIZE];
+static size_t _in_len = 0;
+static size_t _in_pos = 0;
+
+/* Device to host loopback buffer */
+static uint8_t _out[LOOP_SIZE];
+static size_t _out_len = 0;
+static size_t _out_pos = 0;
+
+static void _test_crc16(void);
+static void _test_cobs(void);
+static void _test_proto(void);
+static void _request(uint8_t cmd, uint8_t seq, const void *payload, size_t len);
+static int _response(uint8_t *cmd, uint8_t *seq, uint8_t *status, uint8_t *payload);
+static int _echo(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+static int _fail(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len);
+
+int main(void)
+{
+    _test_crc16();
+    _test_cobs();
+    _test_proto();
+
+    return test_result("proto_test");
+}
+
+/**
+ * \brief Read from the host to device loopback buffer, in place of the UART
+ */
+int uart_read(void *buf, size_t len, uint16_t timeout_ms, int delim)
+{
+    uint8_t *ptr = buf;
+    size_t count = 0;
+
+    (void) timeout_ms;
+
+    /* Every test ends with the exit command, so running dry is a failure */
+    if (_in_pos == _in_len) {
+        TEST_CHECK(_in_pos < _in_len);
+        exit(test_result("proto_test"));
+    }
+
+    while ((count < len) && (_in_pos < _in_len)) {
+        ptr[count] = _in[_in_pos++];
+
+        if (ptr[count++] == delim) {
+            break;
+        }
+    }
+
+    return (int) count;
+}
+
+/**
+ * \brief Write to the device to host loopback buffer, in place of the UART
+ */
+int uart_write_all(const void *buf, size_t len)
+{
+    TEST_CHECK((_out_len + len) <= sizeof(_out));
+    memcpy(&_out[_out_len], buf, len);
+    _out_len += len;
+
+    return (int) len;
+}
+
+/**
+ * \brief CRC-16 check value
+ */
+static void _test_crc16(void)
+{
+    uint16_t crc;
+
+    TEST_CHECK(crc16(CRC16_INIT, "123456789", 9) == 0x29B1);
+
+    /* Split calculations and the residue of a block with its own CRC */
+    crc = crc16(crc16(CRC16_INIT, "1234", 4), "56789", 5);
+    TEST_CHECK(crc == 0x29B1);
+    {
+        uint8_t data[11] = "123456789";
+
+        data[9] = crc >> 8;
+        data[10] = crc & 0xFF;
+        TEST_CHECK(crc16(CRC16_INIT, data, sizeof(data)) == 0);
+    }
+}
+
+/**
+ * \brief COBS encoding of known vectors and random round trips
+ */
+static void _test_cobs(void)
+{
+    static const uint8_t zero[] = {0x00};
+    static const uint8_t zero_enc[] = {0x01, 0x01};
+    static const uint8_t mixed[] = {0x11, 0x22, 0x00, 0x33};
+    static const uint8_t mixed_enc[] = {0x03, 0x11, 0x22, 0x02, 0x33};
+    static const uint8_t invalid[] = {0x05, 0x11, 0x22};
+    static uint8_t in[600];
+    static uint8_t enc[COBS_ENCODED_MAX(sizeof(in))];
+    static uint8_t inplace[256];
+    uint8_t dec[8];
+    int i;
+
+    TEST_CHECK(cobs_encode(zero, sizeof(zero), enc) == sizeof(zero_enc));
+    TEST_CHECK(memcmp(enc, zero_enc, sizeof(zero_enc)) == 0);
+    TEST_CHECK(cobs_encode(mixed, sizeof(mixed), enc) == sizeof(mixed_enc));
+    TEST_CHECK(memcmp(enc, mixed_enc, sizeof(mixed_enc)) == 0);
+    TEST_CHECK(cobs_decode(mixed_enc, sizeof(mixed_enc), dec) == sizeof(mixed));
+    TEST_CHECK(memcmp(dec, mixed, sizeof(mixed)) == 0);
+
+    /* A code byte which points past the end of the data */
+    TEST_CHECK(cobs_decode(invalid, sizeof(invalid), dec) == -1);
+
+    /* Runs longer than 254 bytes and zero bytes, decoded in place */
+    srand(1);
+
+    for (i = 0; i < 10000; i++) {
+        const size_t len = (size_t) rand() % sizeof(in);
+        size_t n;
+        size_t j;
+
+        for (j = 0; j < len; j++) {
+            in[j] = ((rand() % 4) != 0) ? (uint8_t) ((rand() % 255) + 1) : 0;
+        }
+
+        n = cobs_encode(in, len, enc);
+        TEST_CHECK(n <= COBS_ENCODED_MAX(len));
+        TEST_CHECK(memchr(enc, 0, n) == NULL);
+
+        /* Short blocks encode the same in place, one byte down */
+        if (len < 254) {
+            memcpy(&inplace[1], in, len);
+            TEST_CHECK(cobs_encode(&inplace[1], len, inplace) == n);
+            TEST_CHECK(memcmp(inplace, enc, n) == 0);
+        }
+
+        TEST_CHECK(cobs_decode(enc, n, enc) == (int) len);
+        TEST_CHECK(memcmp(enc, in, len) == 0);
+    }
+}
+
+/**
+ * \brief Requests through proto_run() and their responses
+ */
+static void _test_proto(void)
+{
+    static const struct proto_cmd cmds[] = {
+        {CMD_ECHO, _echo},
+        {CMD_FAIL, _fail}
+    };
+    static const uint8_t payload[] = {0x00, 0x01, 0x00, 0x02};
+    uint8_t frame[64];
+    uint8_t rsp[PROTO_MAX_PAYLOAD + 8];
+    uint8_t cmd;
+    uint8_t seq;
+    uint8_t status;
+    size_t len;
+    size_t i;
+
+    /* A leading delimiter and a frame with a bad CRC are ignored */
+    _in[_in_len++] = 0;
+    _request(CMD_ECHO, 1, payload, sizeof(payload));
+    len = _in_len;
+    _request(CMD_ECHO, 2, payload, sizeof(payload));
+    _in[len + 2] ^= 0x40;
+
+    /* So is garbage, up to the next delimiter */
+    _in[_in_len++] = 0x05;
+    _in[_in_len++] = 0x00;
+
+    /* An oversized frame is discarded as a whole */
+    for (i = 0; i < 100; i++) {
+        _in[_in_len++] = 0x55;
+    }
+
+    _in[_in_len++] = 0x00;
+
+    _request(0x42, 3, NULL, 0);
+    _request(CMD_FAIL, 4, NULL, 0);
+    memset(frame, 0xA5, sizeof(frame));
+
+    /* A payload over PROTO_MAX_PAYLOAD is discarded, even if it fits the frame */
+    _request(CMD_ECHO, 7, frame, PROTO_MAX_PAYLOAD + 1);
+    _request(CMD_ECHO, 5, frame, PROTO_MAX_PAYLOAD);
+    _request(PROTO_CMD_EXIT, 6, NULL, 0);
+
+    proto_run(cmds, sizeof(cmds) / sizeof(cmds[0]));
+    TEST_CHECK(_in_pos == _in_len);
+
+    TEST_CHECK(_response(&cmd, &seq, &status, rsp) == sizeof(payload));
+    TEST_CHECK((cmd == (CMD_ECHO | 0x80)) && (seq == 1) && (status == PROTO_STATUS_OK));
+    TEST_CHECK(memcmp(rsp, payload, sizeof(payload)) == 0);
+
+    TEST_CHECK(_response(&cmd, &seq, &status, rsp) == 0);
+    TEST_CHECK((cmd == 0xC2) && (seq == 3) && (status == PROTO_STATUS_UNKNOWN));
+
+    TEST_CHECK(_response(&cmd, &seq, &status, rsp) == 0);
+    TEST_CHECK((cmd == (CMD_FAIL | 0x80)) && (seq == 4) && (status == PROTO_STATUS_ERROR));
+
+    TEST_CHECK(_response(&cmd, &seq, &status, rsp) == PROTO_MAX_PAYLOAD);
+    TEST_CHECK((cmd == (CMD_ECHO | 0x80)) && (seq == 5) && (status == PROTO_STATUS_OK));
+    TEST_CHECK(memcmp(rsp, frame, PROTO_MAX_PAYLOAD) == 0);
+
+    TEST_CHECK(_response(&cmd, &seq, &status, rsp) == 0);
+    TEST_CHECK((cmd == (PROTO_CMD_EXIT | 0x80)) && (seq == 6) && (status == PROTO_STATUS_OK));
+
+    TEST_CHECK(_out_pos == _out_len);
+}
+
+/**
+ * \brief Encode a request into the host to device loopback buffer
+ * \param[in] cmd - the command ID
+ * \param[in] seq - the sequence number
+ * \param[in] payload - the payload
+ * \param[in] len - the length of the payload
+ */
+static void _request(uint8_t cmd, uint8_t seq, const void *payload, size_t len)
+{
+    uint8_t raw[PROTO_MAX_PAYLOAD + 5];
+    uint16_t crc;
+
+    raw[0] = cmd;
+    raw[1] = seq;
+    memcpy(&raw[2], payload, len);
+    len += 2;
+
+    crc = crc16(CRC16_INIT, raw, len);
+    raw[len++] = crc >> 8;
+    raw[len++] = crc & 0xFF;
+
+    _in_len += cobs_encode(raw, len, &_in[_in_len]);
+    _in[_in_len++] = 0;
+}
+
+/**
+ * \brief Decode the next response from the device to host loopback buffer
+ * \param[out] cmd - the command ID
+ * \param[out] seq - the sequence number
+ * \param[out] status - the status code
+ * \param[out] payload - the payload, at least PROTO_MAX_PAYLOAD bytes
+ * \return the length of the payload on success, -1 if the response is invalid
+ */
+static int _response(uint8_t *cmd, uint8_t *seq, uint8_t *status, uint8_t *payload)
+{
+    uint8_t raw[COBS_ENCODED_MAX(PROTO_MAX_PAYLOAD + 5)];
+    size_t len = 0;
+    int n;
+    int ret = -1;
+
+    while ((_out_pos < _out_len) && (_out[_out_pos] != 0) && (len < sizeof(raw))) {
+        raw[len++] = _out[_out_pos++];
+    }
+
+    /* Skip the delimiter */
+    _out_pos++;
+    n = cobs_decode(raw, len, raw);
+
+    if ((n >= 5) && (crc16(CRC16_INIT, raw, n) == 0)) {
+        *cmd = raw[0];
+        *seq = raw[1];
+        *status = raw[2];
+        memcpy(payload, &raw[3], n - 5);
+        ret = n - 5;
+    }
+
+    return ret;
+}
+
+static int _echo(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
+{
+    memmove(rsp, req, req_len);
+    *rsp_len = req_len;
+
+    return 0;
+}
+
+static int _fail(const uint8_t *req, size_t req_len, uint8_t *rsp, size_t *rsp_len)
+{
+    (void) req;
+    (void) req_len;
+    (void) rsp;
+    (void) rsp_len;
+
+    return -1;
+}
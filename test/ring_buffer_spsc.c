@@ -0,0 +1,312 @@
+/**
+ * \file ring_buffer_spsc.c
+ * \author Chris Karaplis
+ * \brief Ring buffer SPSC stress test and throughput benchmark
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CPU affinity */
+#define _GNU_SOURCE
+
+#include "test.h"
+#include "ring_buffer.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Elements passed from the producer to the consumer in each run */
+#define SPSC_OPS        2000000UL
+
+/* Ring buffer geometry, the largest element size is 64 bytes */
+#define SPSC_ELEMS      64
+#define SPSC_ELEM_MAX   64
+
+/* Number of elements moved per bulk write or read */
+#define SPSC_BURST      16
+
+#ifdef RING_BUFFER_ATOMIC
+#define SPSC_NAME       "ring_buffer_spsc_atomic"
+#else
+#define SPSC_NAME       "ring_buffer_spsc"
+#endif
+
+struct spsc_run
+{
+    rbd_t rbd;
+    size_t s_elem;
+    unsigned long ops;
+    int bulk;
+    int producer_cpu;
+    unsigned long errors;
+};
+
+/* Number of high water callbacks */
+static unsigned int _high_water_calls = 0;
+
+static void _test_stats(void);
+static void _high_water(void *arg);
+static void _fill(uint8_t *elem, size_t s_elem, unsigned long seq);
+static void *_producer(void *arg);
+static void _consumer(struct spsc_run *run);
+static double _run(size_t s_elem, unsigned long ops, int bulk, int producer_cpu);
+static int _pin(pthread_t thread, int cpu);
+
+int main(int argc, char *argv[])
+{
+    static const size_t sizes[] = {1, 2, 4, 16, 64};
+    const unsigned long ops = (argc > 1) ? strtoul(argv[1], NULL, 0) : SPSC_OPS;
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int producer_cpu;
+
+    _test_stats();
+
+    printf("%s, %lu elements per run, %u element ring\n", SPSC_NAME, ops, SPSC_ELEMS);
+
+    /* The consumer runs on CPU 0, the producer on the same CPU and then the next one */
+    for (producer_cpu = 0; producer_cpu < 2; producer_cpu++) {
+        size_t i;
+
+        if (producer_cpu >= cpus) {
+            printf("producer and consumer on different cores: skipped, %ld CPU online\n", cpus);
+            break;
+        }
+
+        printf("producer and consumer on %s\n", (producer_cpu == 0) ? "the same core" : "different cores");
+        printf("s_elem   put/get Mops/s   write/read Mops/s\n");
+
+        for (i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+            const double single = _run(sizes[i], ops, 0, producer_cpu);
+            const double bulk = _run(sizes[i], ops, 1, producer_cpu);
+
+            printf("%6u   %14.2f   %17.2f\n", (unsigned int) sizes[i], single / 1e6, bulk / 1e6);
+        }
+    }
+
+    return test_result(SPSC_NAME);
+}
+
+/**
+ * \brief The statistics and the high water callback follow the consumer
+ *
+ * In the atomic build, the producer caches the consumer's index and only
+ * reloads it when the cached copy shows too little space. Elements which
+ * have been read must not count towards the peak or the high water mark.
+ */
+static void _test_stats(void)
+{
+    static uint8_t buf[8];
+    rb_attr_t attr = {1, sizeof(buf), buf, RB_DROP_NEWEST, 6, _high_water, NULL};
+    uint8_t data[8] = {0};
+    rb_stats_t stats;
+    rbd_t rbd;
+
+    TEST_CHECK(ring_buffer_init(&rbd, &attr) == 0);
+
+    TEST_CHECK(ring_buffer_write(rbd, data, 5) == 5);
+    TEST_CHECK(ring_buffer_read(rbd, data, 5) == 5);
+    TEST_CHECK(ring_buffer_put(rbd, data) == 0);
+    TEST_CHECK(ring_buffer_write(rbd, data, 1) == 1);
+    TEST_CHECK(ring_buffer_stats(rbd, &stats, 0) == 0);
+    TEST_CHECK((stats.peak == 5) && (_high_water_calls == 0));
+
+    /* Rising to the high water mark still notifies, once */
+    TEST_CHECK(ring_buffer_write(rbd, data, 4) == 4);
+    TEST_CHECK(ring_buffer_put(rbd, data) == 0);
+    TEST_CHECK(ring_buffer_stats(rbd, &stats, 0) == 0);
+    TEST_CHECK((stats.peak == 7) && (_high_water_calls == 1));
+
+    TEST_CHECK(ring_buffer_deinit(rbd) == 0);
+}
+
+/**
+ * \brief High water callback, counts its calls
+ * \param[in] arg - unused
+ */
+static void _high_water(void *arg)
+{
+    (void) arg;
+    _high_water_calls++;
+}
+
+/**
+ * \brief Fill an element with a pattern derived from its sequence number
+ * \param[out] elem - the element
+ * \param[in] s_elem - the size of the element
+ * \param[in] seq - the sequence number
+ */
+static void _fill(uint8_t *elem, size_t s_elem, unsigned long seq)
+{
+    size_t i;
+
+    for (i = 0; i < s_elem; i++) {
+        elem[i] = (uint8_t) ((seq >> ((i & 3) * 8)) + i);
+    }
+}
+
+/**
+ * \brief Producer thread, adds the elements in sequence
+ * \param[in] arg - the run
+ * \return NULL
+ */
+static void *_producer(void *arg)
+{
+    struct spsc_run *run = arg;
+    uint8_t elems[SPSC_BURST * SPSC_ELEM_MAX];
+    unsigned long seq = 0;
+
+    TEST_CHECK(_pin(pthread_self(), run->producer_cpu) == 0);
+
+    while (seq < run->ops) {
+        size_t n = 1;
+        size_t added;
+        size_t i;
+
+        if ((run->bulk != 0) && ((run->ops - seq) >= SPSC_BURST)) {
+            n = SPSC_BURST;
+        }
+
+        /* Elements which do not fit are generated again on the next attempt */
+        for (i = 0; i < n; i++) {
+            _fill(&elems[i * run->s_elem], run->s_elem, seq + i);
+        }
+
+        if (run->bulk != 0) {
+            added = ring_buffer_write(run->rbd, elems, n);
+        } else {
+            added = (ring_buffer_put(run->rbd, elems) == 0) ? 1 : 0;
+        }
+
+        seq += added;
+
+        if (added == 0) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Consumer, removes the elements and checks their sequence
+ * \param[in/out] run - the run
+ */
+static void _consumer(struct spsc_run *run)
+{
+    uint8_t elems[SPSC_BURST * SPSC_ELEM_MAX];
+    uint8_t expected[SPSC_ELEM_MAX];
+    unsigned long seq = 0;
+
+    while (seq < run->ops) {
+        size_t removed;
+        size_t i;
+
+        if (run->bulk != 0) {
+            removed = ring_buffer_read(run->rbd, elems, SPSC_BURST);
+        } else {
+            removed = (ring_buffer_get(run->rbd, elems) == 0) ? 1 : 0;
+        }
+
+        for (i = 0; i < removed; i++) {
+            _fill(expected, run->s_elem, seq + i);
+
+            if (memcmp(&elems[i * run->s_elem], expected, run->s_elem) != 0) {
+                run->errors++;
+            }
+        }
+
+        seq += removed;
+
+        if (removed == 0) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * \brief Pass elements between a producer thread and the calling thread
+ * \param[in] s_elem - the size of the elements
+ * \param[in] ops - the number of elements
+ * \param[in] bulk - non-zero to use bulk writes and reads
+ * \param[in] producer_cpu - the CPU to run the producer on, the consumer runs on CPU 0
+ * \return the number of elements passed per second
+ */
+static double _run(size_t s_elem, unsigned long ops, int bulk, int producer_cpu)
+{
+    static uint8_t mem[SPSC_ELEMS * SPSC_ELEM_MAX];
+    rb_attr_t attr = {0, SPSC_ELEMS, mem, RB_DROP_NEWEST, 0, NULL, NULL};
+    struct spsc_run run;
+    pthread_t thread;
+    double start;
+    double rate = 0;
+
+    attr.s_elem = s_elem;
+    memset(&run, 0, sizeof(run));
+    run.s_elem = s_elem;
+    run.ops = ops;
+    run.bulk = bulk;
+    run.producer_cpu = producer_cpu;
+
+    TEST_CHECK(ring_buffer_init(&run.rbd, &attr) == 0);
+    TEST_CHECK(_pin(pthread_self(), 0) == 0);
+
+    start = test_seconds();
+    TEST_CHECK(pthread_create(&thread, NULL, _producer, &run) == 0);
+    _consumer(&run);
+    TEST_CHECK(pthread_join(thread, NULL) == 0);
+    rate = (double) ops / (test_seconds() - start);
+
+    if (run.errors != 0) {
+        printf("s_elem %u: %lu elements out of sequence\n", (unsigned int) s_elem, run.errors);
+    }
+
+    TEST_CHECK(run.errors == 0);
+    TEST_CHECK(ring_buffer_count(run.rbd) == 0);
+    TEST_CHECK(ring_buffer_deinit(run.rbd) == 0);
+
+    return rate;
+}
+
+/**
+ * \brief Pin a thread to a CPU
+ * \param[in] thread - the thread
+ * \param[in] cpu - the CPU
+ * \return 0 on success, an error number otherwise
+ */
+static int _pin(pthread_t thread, int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return pthread_setaffinity_np(thread, sizeof(set), &set);
+}
@@ -0,0 +1,397 @@
+/**
+ * \file ring_buffer_test.c
+ * \author Chris Karaplis
+ * \brief Ring buffer unit tests and benchmarks
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test.h"
+#include "ring_buffer.h"
+#include <stdint.h>
+#include <string.h>
+
+/* Elements moved per benchmark run */
+#define BENCH_ELEMS     20000000UL
+
+/* Elements moved per bulk write or read, the size of a UART burst */
+#define BENCH_BURST     16
+
+/* Specialized ring buffer of the same size as the benchmarked descriptor */
+RING_BUFFER_DEFINE(_chars, char, 64)
+
+static void _test_bulk(void);
+static void _test_define(void);
+static void _test_overwrite(void);
+static void _test_interleaved(rb_policy_t policy);
+static void _bench_bulk(size_t s_elem);
+static void _bench_define(void);
+static int _chars_put_call(char c) __attribute__((noinline));
+static int _chars_get_call(char *c) __attribute__((noinline));
+
+int main(void)
+{
+    _test_bulk();
+    _test_define();
+    _test_overwrite();
+    _test_interleaved(RB_DROP_NEWEST);
+    _test_interleaved(RB_OVERWRITE_OLDEST);
+
+    printf("s_elem   put/get Melem/s   write/read Melem/s\n");
+    _bench_bulk(1);
+    _bench_bulk(4);
+    _bench_define();
+
+    return test_result("ring_buffer_test");
+}
+
+/**
+ * \brief Bulk writes and reads which wrap around the end of the buffer
+ */
+static void _test_bulk(void)
+{
+    static uint16_t mem[8];
+    rb_attr_t attr = {sizeof(mem[0]), 8, mem, RB_DROP_NEWEST, 0, NULL, NULL};
+    uint16_t in[12];
+    uint16_t out[12];
+    uint16_t seq = 0;
+    uint16_t expected = 0;
+    rbd_t rbd;
+    size_t i;
+    size_t n;
+
+    TEST_CHECK(ring_buffer_init(&rbd, &attr) == 0);
+    TEST_CHECK((ring_buffer_count(rbd) == 0) && (ring_buffer_space(rbd) == 8));
+
+    /* Vary the offsets so that every split point is exercised */
+    for (i = 0; i < 1000; i++) {
+        size_t j;
+
+        n = (i % 7) + 1;
+
+        for (j = 0; j < n; j++) {
+            in[j] = seq + j;
+        }
+
+        n = ring_buffer_write(rbd, in, n);
+        seq += n;
+        TEST_CHECK((ring_buffer_count(rbd) + ring_buffer_space(rbd)) == 8);
+
+        n = ring_buffer_read(rbd, out, (i * 5) % 6);
+
+        for (j = 0; j < n; j++) {
+            TEST_CHECK(out[j] == expected);
+            expected++;
+        }
+    }
+
+    /* A full buffer accepts only what fits, an empty one returns nothing */
+    n = ring_buffer_read(rbd, out, 12);
+    TEST_CHECK((n + expected) == seq);
+
+    for (i = 0; i < 12; i++) {
+        in[i] = i;
+    }
+
+    TEST_CHECK(ring_buffer_write(rbd, in, 12) == 8);
+    TEST_CHECK((ring_buffer_count(rbd) == 8) && (ring_buffer_space(rbd) == 0));
+    TEST_CHECK(ring_buffer_write(rbd, in, 1) == 0);
+    TEST_CHECK(ring_buffer_read(rbd, out, 12) == 8);
+    TEST_CHECK(memcmp(in, out, 8 * sizeof(in[0])) == 0);
+    TEST_CHECK(ring_buffer_read(rbd, out, 12) == 0);
+
+    /* Invalid descriptors */
+    TEST_CHECK(ring_buffer_write(RING_BUFFER_MAX, in, 1) == 0);
+    TEST_CHECK(ring_buffer_read(RING_BUFFER_MAX, out, 1) == 0);
+    TEST_CHECK(ring_buffer_count(RING_BUFFER_MAX) == 0);
+    TEST_CHECK(ring_buffer_space(RING_BUFFER_MAX) == 0);
+
+    TEST_CHECK(ring_buffer_deinit(rbd) == 0);
+}
+
+/**
+ * \brief Specialized ring buffer order, full and empty conditions
+ */
+static void _test_define(void)
+{
+    char c = 0;
+    int i;
+
+    TEST_CHECK(_chars_count() == 0);
+    TEST_CHECK(_chars_get(&c) == -1);
+
+    /* Run through the buffer several times so that the indices wrap */
+    for (i = 0; i < 200; i++) {
+        TEST_CHECK(_chars_put((char) i) == 0);
+        TEST_CHECK(_chars_put((char) (i + 1)) == 0);
+        TEST_CHECK((_chars_get(&c) == 0) && (c == (char) i));
+        TEST_CHECK((_chars_get(&c) == 0) && (c == (char) (i + 1)));
+    }
+
+    for (i = 0; i < 64; i++) {
+        TEST_CHECK(_chars_put((char) i) == 0);
+    }
+
+    TEST_CHECK(_chars_put(0) == -1);
+    TEST_CHECK(_chars_count() == 64);
+
+    for (i = 0; i < 64; i++) {
+        TEST_CHECK((_chars_get(&c) == 0) && (c == (char) i));
+    }
+
+    TEST_CHECK(_chars_count() == 0);
+}
+
+/**
+ * \brief Overwrite policy for single and bulk writes
+ */
+static void _test_overwrite(void)
+{
+    static uint8_t mem[4];
+    rb_attr_t attr = {sizeof(mem[0]), 4, mem, RB_OVERWRITE_OLDEST, 0, NULL, NULL};
+    const uint8_t in[6] = {0, 1, 2, 3, 4, 5};
+    uint8_t out[6];
+    rb_stats_t stats;
+    void *ptr;
+    rbd_t rbd;
+
+    TEST_CHECK(ring_buffer_init(&rbd, &attr) == 0);
+
+    /* Only the newest 4 of the 6 elements are kept */
+    TEST_CHECK(ring_buffer_write(rbd, in, 6) == 6);
+    TEST_CHECK(ring_buffer_count(rbd) == 4);
+    TEST_CHECK(ring_buffer_read(rbd, out, 6) == 4);
+    TEST_CHECK(memcmp(out, &in[2], 4) == 0);
+
+    /* Writes into a partly full buffer discard just enough old elements */
+    TEST_CHECK(ring_buffer_write(rbd, in, 3) == 3);
+    TEST_CHECK(ring_buffer_write(rbd, &in[3], 3) == 3);
+    TEST_CHECK(ring_buffer_put(rbd, &in[0]) == 0);
+    TEST_CHECK(ring_buffer_read(rbd, out, 6) == 4);
+    TEST_CHECK((out[0] == 3) && (out[1] == 4) && (out[2] == 5) && (out[3] == 0));
+
+    TEST_CHECK(ring_buffer_stats(rbd, &stats, 0) == 0);
+    TEST_CHECK((stats.puts == 13) && (stats.gets == 8) && (stats.drops == 5) && (stats.peak == 4));
+
+    /* Elements cannot be written in place */
+    TEST_CHECK(ring_buffer_reserve(rbd, &ptr, 1) == 0);
+    TEST_CHECK(ring_buffer_commit(rbd, 1) == -1);
+    TEST_CHECK(ring_buffer_count(rbd) == 0);
+
+    TEST_CHECK(ring_buffer_deinit(rbd) == 0);
+}
+
+/**
+ * \brief A producer interrupting the consumer at pseudo random points
+ * \param[in] policy - the overflow policy
+ *
+ * The producer adds a run of sequence numbers, one at a time or in bulk,
+ * between each step of the consumer, as an ISR would. Whatever the policy,
+ * the consumer must see increasing sequence numbers, and the counters must
+ * account for every element.
+ */
+static void _test_interleaved(rb_policy_t policy)
+{
+    static uint32_t mem[8];
+    rb_attr_t attr = {sizeof(mem[0]), 8, mem, RB_DROP_NEWEST, 0, NULL, NULL};
+    uint32_t random = 1;
+    uint32_t seq = 0;
+    uint32_t last = 0;
+    unsigned long received = 0;
+    rb_stats_t stats;
+    rbd_t rbd;
+    int i;
+
+    attr.policy = policy;
+    TEST_CHECK(ring_buffer_init(&rbd, &attr) == 0);
+
+    for (i = 0; i < 100000; i++) {
+        uint32_t in[12];
+        uint32_t out[4];
+        size_t n;
+        size_t j;
+
+        random = (random * 1103515245) + 12345;
+        n = (random >> 16) % 12;
+
+        for (j = 0; j < n; j++) {
+            in[j] = ++seq;
+        }
+
+        /* Producer */
+        if ((random & 0x100) != 0) {
+            (void) ring_buffer_write(rbd, in, n);
+        } else {
+            for (j = 0; j < n; j++) {
+                (void) ring_buffer_put(rbd, &in[j]);
+            }
+        }
+
+        TEST_CHECK(ring_buffer_count(rbd) <= 8);
+
+        /* Consumer */
+        n = (random & 0x200) ? ring_buffer_read(rbd, out, (random >> 24) % 5) :
+                               (size_t) (ring_buffer_get(rbd, out) == 0);
+
+        for (j = 0; j < n; j++) {
+            TEST_CHECK(out[j] > last);
+            last = out[j];
+        }
+
+        received += n;
+    }
+
+    TEST_CHECK(ring_buffer_stats(rbd, &stats, 0) == 0);
+    TEST_CHECK(stats.gets == received);
+    TEST_CHECK(stats.drops > 0);
+
+    /* Rejected elements are not added, discarded ones are added and then dropped */
+    if (policy == RB_DROP_NEWEST) {
+        TEST_CHECK((stats.puts + stats.drops) == seq);
+        TEST_CHECK((stats.puts - stats.gets) == ring_buffer_count(rbd));
+    } else {
+        TEST_CHECK(stats.puts == seq);
+        TEST_CHECK((stats.puts - stats.drops - stats.gets) == ring_buffer_count(rbd));
+    }
+
+    TEST_CHECK(ring_buffer_deinit(rbd) == 0);
+}
+
+/**
+ * \brief Compare moving bursts of elements one at a time and in bulk
+ * \param[in] s_elem - the size of the elements
+ */
+static void _bench_bulk(size_t s_elem)
+{
+    static uint8_t mem[64 * 4];
+    rb_attr_t attr = {0, 64, mem, RB_DROP_NEWEST, 0, NULL, NULL};
+    uint8_t burst[BENCH_BURST * 4];
+    unsigned long moved;
+    double single;
+    double bulk;
+    rbd_t rbd;
+
+    attr.s_elem = s_elem;
+    memset(burst, 0x5A, sizeof(burst));
+    TEST_CHECK(ring_buffer_init(&rbd, &attr) == 0);
+
+    single = test_seconds();
+
+    for (moved = 0; moved < BENCH_ELEMS; moved += BENCH_BURST) {
+        size_t i;
+
+        for (i = 0; i < BENCH_BURST; i++) {
+            (void) ring_buffer_put(rbd, &burst[i * s_elem]);
+        }
+
+        for (i = 0; i < BENCH_BURST; i++) {
+            (void) ring_buffer_get(rbd, &burst[i * s_elem]);
+        }
+    }
+
+    single = (double) BENCH_ELEMS / (test_seconds() - single);
+    bulk = test_seconds();
+
+    for (moved = 0; moved < BENCH_ELEMS; moved += BENCH_BURST) {
+        (void) ring_buffer_write(rbd, burst, BENCH_BURST);
+        (void) ring_buffer_read(rbd, burst, BENCH_BURST);
+    }
+
+    bulk = (double) BENCH_ELEMS / (test_seconds() - bulk);
+
+    printf("%6u   %15.1f   %18.1f\n", (unsigned int) s_elem, single / 1e6, bulk / 1e6);
+
+    TEST_CHECK(ring_buffer_count(rbd) == 0);
+    TEST_CHECK(ring_buffer_deinit(rbd) == 0);
+}
+
+/**
+ * \brief Compare the specialized ring buffer with the descriptor API for chars
+ *
+ * Both are called through a function, as from an ISR in another module, so
+ * the sizes of _chars_put_call and ring_buffer_put can be compared with nm.
+ */
+static void _bench_define(void)
+{
+    static char mem[64];
+    rb_attr_t attr = {sizeof(char), 64, mem, RB_DROP_NEWEST, 0, NULL, NULL};
+    char burst[BENCH_BURST];
+    unsigned long moved;
+    double descriptor;
+    double define;
+    rbd_t rbd;
+
+    memset(burst, 0x5A, sizeof(burst));
+    TEST_CHECK(ring_buffer_init(&rbd, &attr) == 0);
+
+    descriptor = test_seconds();
+
+    for (moved = 0; moved < BENCH_ELEMS; moved += BENCH_BURST) {
+        size_t i;
+
+        for (i = 0; i < BENCH_BURST; i++) {
+            (void) ring_buffer_put(rbd, &burst[i]);
+        }
+
+        for (i = 0; i < BENCH_BURST; i++) {
+            (void) ring_buffer_get(rbd, &burst[i]);
+        }
+    }
+
+    descriptor = (test_seconds() - descriptor) / (double) BENCH_ELEMS;
+    define = test_seconds();
+
+    for (moved = 0; moved < BENCH_ELEMS; moved += BENCH_BURST) {
+        size_t i;
+
+        for (i = 0; i < BENCH_BURST; i++) {
+            (void) _chars_put_call(burst[i]);
+        }
+
+        for (i = 0; i < BENCH_BURST; i++) {
+            (void) _chars_get_call(&burst[i]);
+        }
+    }
+
+    define = (test_seconds() - define) / (double) BENCH_ELEMS;
+
+    printf("char put + get: descriptor %.2f ns, RING_BUFFER_DEFINE %.2f ns\n",
+           descriptor * 1e9, define * 1e9);
+
+    TEST_CHECK(ring_buffer_deinit(rbd) == 0);
+}
+
+static int _chars_put_call(char c)
+{
+    return _chars_put(c);
+}
+
+static int _chars_get_call(char *c)
+{
+    return _chars_get(c);
+}
@@ -0,0 +1,185 @@
+/**
+ * \file eeprom_24xx.c
+ * \author Chris Karaplis
+ * \brief Behavioral model of a 24xx series I2C EEPROM for host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "eeprom_24xx.h"
+#include <msp430.h>
+#include <string.h>
+
+/* Largest page of the model */
+#define SIM_24XX_PAGE_MAX   256
+
+uint8_t sim_24xx_mem[SIM_24XX_SIZE_MAX];
+struct sim_24xx_stats sim_24xx_stats;
+
+static struct sim_24xx_config _config;
+static double _busy_until = 0;
+
+/* Address pointer, and the address bytes still expected after a start */
+static uint32_t _pointer = 0;
+static uint32_t _block = 0;
+static int _addr_left = 0;
+
+/* Page latch of the write in progress */
+static uint8_t _latch[SIM_24XX_PAGE_MAX];
+static uint8_t _latched[SIM_24XX_PAGE_MAX];
+static uint32_t _page = 0;
+static unsigned int _latch_count = 0;
+
+static int _start(uint8_t address, int read);
+static int _write(uint8_t data);
+static uint8_t _read(void);
+static void _stop(void);
+
+const struct sim_i2c_slave sim_24xx = {_start, _write, _read, _stop};
+
+/**
+ * \brief Configure the device and fill its memory with 0xFF
+ * \param[in] config - the geometry and timing
+ */
+void sim_24xx_init(const struct sim_24xx_config *config)
+{
+    _config = *config;
+    _busy_until = 0;
+    _pointer = 0;
+    _addr_left = 0;
+    _latch_count = 0;
+    memset(sim_24xx_mem, 0xFF, sizeof(sim_24xx_mem));
+    memset(&sim_24xx_stats, 0, sizeof(sim_24xx_stats));
+}
+
+/**
+ * \brief Start condition addressed to the bus
+ * \param[in] address - the 7-bit address
+ * \param[in] read - non-zero if the master reads
+ * \return non-zero to ACK, 0 to NACK
+ *
+ * The device does not ACK during its write cycle. A write starts with the
+ * memory address, a read continues from the address pointer.
+ */
+static int _start(uint8_t address, int read)
+{
+    uint8_t blocks_mask = 0;
+    int ack = 0;
+
+    if ((_config.addr_width == 1) && (_config.size > 256)) {
+        blocks_mask = (uint8_t) ((_config.size / 256) - 1);
+    }
+
+    if ((address & ~blocks_mask) == _config.address) {
+        if (sim_time_us < _busy_until) {
+            sim_24xx_stats.busy_nacks++;
+        } else {
+            _block = (uint32_t) (address & blocks_mask) << 8;
+            _addr_left = read ? 0 : _config.addr_width;
+            _latch_count = 0;
+            memset(_latched, 0, sizeof(_latched));
+
+            if (_addr_left > 0) {
+                _pointer = _block;
+            }
+
+            ack = 1;
+        }
+    }
+
+    return ack;
+}
+
+/**
+ * \brief Byte written by the master
+ * \param[in] data - the byte
+ * \return non-zero to ACK
+ *
+ * Data bytes are latched into the page of the address pointer, wrapping
+ * around at the end of the page.
+ */
+static int _write(uint8_t data)
+{
+    if (_addr_left > 0) {
+        _pointer = (_addr_left == 2) ? ((uint32_t) data << 8) : (_pointer | data);
+        _addr_left--;
+
+        if (_addr_left == 0) {
+            _pointer %= _config.size;
+            _page = _pointer & ~((uint32_t) _config.page_size - 1);
+        }
+    } else {
+        const uint32_t offset = _pointer & (_config.page_size - 1);
+
+        if (_latched[offset] != 0) {
+            sim_24xx_stats.rollovers++;
+        }
+
+        _latch[offset] = data;
+        _latched[offset] = 1;
+        _latch_count++;
+        _pointer = _page | ((offset + 1) & (_config.page_size - 1));
+    }
+
+    return 1;
+}
+
+/**
+ * \brief Byte read by the master
+ * \return the byte at the address pointer
+ */
+static uint8_t _read(void)
+{
+    const uint8_t data = sim_24xx_mem[_pointer];
+
+    _pointer = (_pointer + 1) % _config.size;
+    sim_24xx_stats.read++;
+
+    return data;
+}
+
+/**
+ * \brief Stop condition, which starts the write cycle if data was latched
+ */
+static void _stop(void)
+{
+    if (_latch_count > 0) {
+        unsigned int i;
+
+        for (i = 0; i < _config.page_size; i++) {
+            if (_latched[i] != 0) {
+                sim_24xx_mem[_page + i] = _latch[i];
+                sim_24xx_stats.written++;
+            }
+        }
+
+        _latch_count = 0;
+        _busy_until = sim_time_us + _config.write_time_us;
+        sim_24xx_stats.write_cycles++;
+    }
+}
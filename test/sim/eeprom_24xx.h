@@ -0,0 +1,84 @@
+/**
+ * \file eeprom_24xx.h
+ * \author Chris Karaplis
+ * \brief Behavioral model of a 24xx series I2C EEPROM for host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __SIM_EEPROM_24XX_H__
+#define __SIM_EEPROM_24XX_H__
+
+#include "usci_b0.h"
+#include <stdint.h>
+
+/* Largest capacity of the model */
+#define SIM_24XX_SIZE_MAX   65536UL
+
+/* Device geometry and timing */
+struct sim_24xx_config
+{
+    uint8_t address;        /* Base I2C address, usually 0x50 */
+    uint32_t size;          /* Capacity in bytes */
+    uint16_t page_size;     /* Page size in bytes, a power of 2 */
+    uint8_t addr_width;     /* Address width in bytes, 1 or 2 */
+    double write_time_us;   /* Duration of the internal write cycle */
+};
+
+/* Device statistics */
+struct sim_24xx_stats
+{
+    unsigned long busy_nacks;   /* Addressing attempts NACKed during a write cycle */
+    unsigned long write_cycles; /* Internal write cycles started */
+    unsigned long written;      /* Bytes written to the memory */
+    unsigned long read;         /* Bytes read from the memory */
+    unsigned long rollovers;    /* Bytes written past the end of a page, which wrapped */
+};
+
+/**
+ * The memory of the device. Data written is latched and only stored here
+ * at the stop condition, when the write cycle starts.
+ */
+extern uint8_t sim_24xx_mem[SIM_24XX_SIZE_MAX];
+extern struct sim_24xx_stats sim_24xx_stats;
+
+/* The device, as a slave for sim_ucb0_attach() */
+extern const struct sim_i2c_slave sim_24xx;
+
+/**
+ * \brief Configure the device and fill its memory with 0xFF
+ * \param[in] config - the geometry and timing
+ *
+ * Parts with 1 address byte and more than 256 bytes answer to one I2C
+ * address per 256 byte block, the other parts to the base address only.
+ * Sequential reads roll over at the end of the memory and page writes at
+ * the end of the page, as on the real parts.
+ */
+void sim_24xx_init(const struct sim_24xx_config *config);
+
+#endif /* __SIM_EEPROM_24XX_H__ */
@@ -0,0 +1,209 @@
+/**
+ * \file msp430.c
+ * \author Chris Karaplis
+ * \brief Simulated MSP430G2553 registers and intrinsics for host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <msp430.h>
+
+/* Special function registers */
+volatile unsigned char IE1;
+volatile unsigned char IFG1;
+volatile unsigned char IE2;
+volatile unsigned char IFG2;
+
+/* Watchdog timer */
+volatile unsigned int WDTCTL;
+
+/* Basic clock module and calibration data */
+volatile unsigned char DCOCTL;
+volatile unsigned char BCSCTL1;
+volatile unsigned char BCSCTL2;
+volatile unsigned char BCSCTL3;
+volatile unsigned char CALDCO_1MHZ;
+volatile unsigned char CALBC1_1MHZ;
+volatile unsigned int TLV_CHECKSUM;
+
+/* Ports */
+volatile unsigned char P1IN;
+volatile unsigned char P1OUT;
+volatile unsigned char P1DIR;
+volatile unsigned char P1IFG;
+volatile unsigned char P1IES;
+volatile unsigned char P1IE;
+volatile unsigned char P1SEL;
+volatile unsigned char P1SEL2;
+volatile unsigned char P1REN;
+volatile unsigned char P2IN;
+volatile unsigned char P2OUT;
+volatile unsigned char P2DIR;
+volatile unsigned char P2IFG;
+volatile unsigned char P2IES;
+volatile unsigned char P2IE;
+volatile unsigned char P2SEL;
+volatile unsigned char P2SEL2;
+volatile unsigned char P2REN;
+
+/* Timer_A */
+volatile unsigned int TA0CTL;
+volatile unsigned int TA0R;
+volatile unsigned int TA0CCTL0;
+volatile unsigned int TA0CCR0;
+volatile unsigned int TA1CTL;
+volatile unsigned int TA1R;
+volatile unsigned int TA1IV;
+volatile unsigned int TA1CCTL0;
+volatile unsigned int TA1CCTL1;
+volatile unsigned int TA1CCR0;
+volatile unsigned int TA1CCR1;
+
+/* USCI_A0 */
+volatile unsigned char UCA0CTL0;
+volatile unsigned char UCA0CTL1 = UCSWRST;
+volatile unsigned char UCA0BR0;
+volatile unsigned char UCA0BR1;
+volatile unsigned char UCA0MCTL;
+volatile unsigned char UCA0STAT;
+volatile unsigned char UCA0RXBUF;
+volatile unsigned char sim_uca0_tx[SIM_UCA0_TX_SIZE];
+volatile size_t sim_uca0_tx_len;
+
+/* USCI_B0 */
+volatile unsigned char UCB0CTL0;
+volatile unsigned char UCB0BR0;
+volatile unsigned char UCB0BR1;
+volatile unsigned char UCB0I2CIE;
+volatile unsigned char UCB0STAT;
+volatile unsigned int UCB0I2CSA;
+
+void (*sim_sleep)(void) = NULL;
+volatile int sim_woken = 0;
+volatile unsigned int sim_sr = 0;
+
+double sim_time_us = 0;
+void (*sim_timer1_a0)(void) = NULL;
+
+/* Timer1_A count which has not been added to TA1R yet, in us */
+static double _ta1_us = 0;
+
+/**
+ * \brief Advance the simulated time
+ * \param[in] us - the time to advance by in us
+ */
+void sim_advance_us(double us)
+{
+    sim_time_us += us;
+
+    /* Timer1_A in up mode, one count every 2us */
+    if ((TA1CTL & MC0) && (TA1CCR0 > 0)) {
+        unsigned long counts;
+
+        _ta1_us += us;
+        counts = (unsigned long) (_ta1_us / 2);
+        _ta1_us -= (double) counts * 2;
+
+        while (counts > 0) {
+            const unsigned long to_wrap = (unsigned long) (TA1CCR0 - TA1R) + 1;
+
+            if (counts < to_wrap) {
+                TA1R += (unsigned int) counts;
+                counts = 0;
+            } else {
+                counts -= to_wrap;
+                TA1R = 0;
+                TA1CCTL0 |= CCIFG;
+            }
+        }
+    }
+
+    /* A wrap while interrupts are disabled is serviced once they are enabled */
+    if ((TA1CCTL0 & CCIE) && (TA1CCTL0 & CCIFG) && (sim_sr & GIE) && (sim_timer1_a0 != NULL)) {
+        sim_sr &= ~GIE;
+        sim_timer1_a0();
+        sim_sr |= GIE;
+    }
+}
+
+unsigned int _get_interrupt_state(void)
+{
+    return sim_sr & GIE;
+}
+
+void __set_interrupt_state(unsigned int state)
+{
+    sim_sr = (sim_sr & ~GIE) | (state & GIE);
+}
+
+void __disable_interrupt(void)
+{
+    sim_sr &= ~GIE;
+}
+
+void __enable_interrupt(void)
+{
+    sim_sr |= GIE;
+}
+
+/**
+ * \brief Set status register bits
+ * \param[in] bits - the bits to set
+ *
+ * Entering a low power mode runs sim_sleep in place of the waking interrupts
+ * and returns with the CPU active, as the interrupts would on exit.
+ */
+void __bis_SR_register(unsigned int bits)
+{
+    sim_sr |= (bits & GIE);
+
+    if (((bits & CPUOFF) != 0) && (sim_sleep != NULL)) {
+        sim_sleep();
+    }
+}
+
+void __bic_SR_register(unsigned int bits)
+{
+    sim_sr &= ~bits;
+}
+
+void __bic_SR_register_on_exit(unsigned int bits)
+{
+    if ((bits & CPUOFF) != 0) {
+        sim_woken = 1;
+    }
+}
+
+void __delay_cycles(unsigned long cycles)
+{
+    (void) cycles;
+}
+
+void __no_operation(void)
+{
+}
@@ -0,0 +1,261 @@
+/**
+ * \file msp430.h
+ * \author Chris Karaplis
+ * \brief Simulated MSP430G2553 registers and intrinsics for host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __SIM_MSP430_H__
+#define __SIM_MSP430_H__
+
+#include <stddef.h>
+
+/**
+ * Host replacement for the toolchain's <msp430.h>. Peripheral registers are
+ * plain variables which the tests set and inspect, and interrupt handlers
+ * are called directly by the tests. The interrupt attribute is reduced to
+ * 'used' since the host compiler has no MSP430 vectors.
+ */
+#define interrupt(vector) used
+
+/* Interrupt vectors */
+#define PORT1_VECTOR        2
+#define PORT2_VECTOR        3
+#define USCIAB0TX_VECTOR    6
+#define USCIAB0RX_VECTOR    7
+#define TIMER0_A1_VECTOR    8
+#define TIMER0_A0_VECTOR    9
+#define TIMER1_A1_VECTOR    12
+#define TIMER1_A0_VECTOR    13
+
+/* Status register */
+#define GIE                 0x0008
+#define CPUOFF              0x0010
+#define LPM0_bits           (CPUOFF)
+
+/* Bits */
+#define BIT0                0x01
+#define BIT1                0x02
+#define BIT2                0x04
+#define BIT3                0x08
+#define BIT4                0x10
+#define BIT5                0x20
+#define BIT6                0x40
+#define BIT7                0x80
+
+/* Special function registers */
+extern volatile unsigned char IE1;
+extern volatile unsigned char IFG1;
+extern volatile unsigned char IE2;
+extern volatile unsigned char IFG2;
+
+#define WDTIFG              0x01
+#define UCA0RXIE            0x01
+#define UCA0TXIE            0x02
+#define UCB0RXIE            0x04
+#define UCB0TXIE            0x08
+#define UCA0RXIFG           0x01
+#define UCA0TXIFG           0x02
+#define UCB0RXIFG           0x04
+#define UCB0TXIFG           0x08
+
+/* Watchdog timer */
+extern volatile unsigned int WDTCTL;
+
+#define WDTPW               0x5A00
+#define WDTHOLD             0x0080
+#define WDTCNTCL            0x0008
+#define WDTSSEL             0x0004
+
+/* Basic clock module and calibration data */
+extern volatile unsigned char DCOCTL;
+extern volatile unsigned char BCSCTL1;
+extern volatile unsigned char BCSCTL2;
+extern volatile unsigned char BCSCTL3;
+extern volatile unsigned char CALDCO_1MHZ;
+extern volatile unsigned char CALBC1_1MHZ;
+extern volatile unsigned int TLV_CHECKSUM;
+
+#define DIVS_0              0x00
+#define DIVS_3              0x06
+#define LFXT1S_2            0x20
+
+/* Ports */
+extern volatile unsigned char P1IN;
+extern volatile unsigned char P1OUT;
+extern volatile unsigned char P1DIR;
+extern volatile unsigned char P1IFG;
+extern volatile unsigned char P1IES;
+extern volatile unsigned char P1IE;
+extern volatile unsigned char P1SEL;
+extern volatile unsigned char P1SEL2;
+extern volatile unsigned char P1REN;
+extern volatile unsigned char P2IN;
+extern volatile unsigned char P2OUT;
+extern volatile unsigned char P2DIR;
+extern volatile unsigned char P2IFG;
+extern volatile unsigned char P2IES;
+extern volatile unsigned char P2IE;
+extern volatile unsigned char P2SEL;
+extern volatile unsigned char P2SEL2;
+extern volatile unsigned char P2REN;
+
+/* Timer_A */
+extern volatile unsigned int TA0CTL;
+extern volatile unsigned int TA0R;
+extern volatile unsigned int TA0CCTL0;
+extern volatile unsigned int TA0CCR0;
+extern volatile unsigned int TA1CTL;
+extern volatile unsigned int TA1R;
+extern volatile unsigned int TA1IV;
+extern volatile unsigned int TA1CCTL0;
+extern volatile unsigned int TA1CCTL1;
+extern volatile unsigned int TA1CCR0;
+extern volatile unsigned int TA1CCR1;
+
+#define TASSEL1             0x0200
+#define TASSEL_2            0x0200
+#define ID0                 0x0040
+#define TAIFG               0x0001
+#define MC0                 0x0010
+#define MC_0                0x0000
+#define MC_2                0x0020
+#define TACLR               0x0004
+#define CM_2                0x8000
+#define CM_3                0xC000
+#define CCIS_0              0x0000
+#define CCIS_2              0x2000
+#define SCS                 0x0800
+#define CAP                 0x0100
+#define CCIE                0x0010
+#define COV                 0x0002
+#define CCIFG               0x0001
+#define TA1IV_TACCR1        0x0002
+
+/**
+ * USCI_A0 in UART mode. Writes to UCA0TXBUF are captured in sim_uca0_tx, of
+ * which sim_uca0_tx_len bytes have been written (modulo its size).
+ */
+#define SIM_UCA0_TX_SIZE    4096
+
+extern volatile unsigned char UCA0CTL0;
+extern volatile unsigned char UCA0CTL1;
+extern volatile unsigned char UCA0BR0;
+extern volatile unsigned char UCA0BR1;
+extern volatile unsigned char UCA0MCTL;
+extern volatile unsigned char UCA0STAT;
+extern volatile unsigned char UCA0RXBUF;
+extern volatile unsigned char sim_uca0_tx[SIM_UCA0_TX_SIZE];
+extern volatile size_t sim_uca0_tx_len;
+
+#define UCA0TXBUF           (sim_uca0_tx[(sim_uca0_tx_len++) & (SIM_UCA0_TX_SIZE - 1)])
+
+#define UCSSEL_2            0x80
+#define UCSWRST             0x01
+#define UCOS16              0x01
+#define UCBUSY              0x01
+
+/* USCI_B0 in I2C mode */
+extern volatile unsigned char UCB0CTL0;
+extern volatile unsigned char UCB0CTL1;
+extern volatile unsigned char UCB0BR0;
+extern volatile unsigned char UCB0BR1;
+extern volatile unsigned char UCB0I2CIE;
+extern volatile unsigned char UCB0STAT;
+extern volatile unsigned int UCB0I2CSA;
+
+/**
+ * The bus is simulated by sim/usci_b0.c. Accessing UCB0CTL1 advances the
+ * bus, so that busy waits on its bits make progress, reading UCB0RXBUF
+ * clears UCB0RXIFG and UCB0TXBUF holds SIM_UCB0_TXBUF_EMPTY until the
+ * driver loads a byte.
+ */
+#define SIM_UCB0_TXBUF_EMPTY    0x100
+
+extern volatile unsigned int sim_ucb0_txbuf;
+
+volatile unsigned char *sim_ucb0_ctl1(void);
+unsigned char sim_ucb0_rxbuf(void);
+
+#define UCB0CTL1            (*sim_ucb0_ctl1())
+#define UCB0RXBUF           (sim_ucb0_rxbuf())
+#define UCB0TXBUF           (sim_ucb0_txbuf)
+
+#define UCMST               0x08
+#define UCMODE_3            0x06
+#define UCSYNC              0x01
+#define UCTR                0x10
+#define UCTXNACK            0x08
+#define UCTXSTP             0x04
+#define UCTXSTT             0x02
+#define UCNACKIE            0x08
+#define UCALIE              0x01
+#define UCSCLLOW            0x40
+#define UCBBUSY             0x10
+#define UCNACKIFG           0x08
+#define UCALIFG             0x01
+
+/**
+ * Called when the code under test enters a low power mode, in place of the
+ * interrupts which would wake the CPU. May be NULL.
+ */
+extern void (*sim_sleep)(void);
+
+/* Set when an interrupt handler clears CPUOFF on exit to wake the CPU */
+extern volatile int sim_woken;
+
+/**
+ * Simulated time in us, advanced by the bus models. Timer1_A counts at
+ * 500kHz (SMCLK / 2, as set by timer_init()) and sets CCIFG in TA1CCTL0
+ * each time TA1R wraps at TA1CCR0. sim_timer1_a0 is called as its CCR0
+ * interrupt handler while the flag is set, if enabled and GIE is set.
+ */
+extern double sim_time_us;
+extern void (*sim_timer1_a0)(void);
+
+/**
+ * \brief Advance the simulated time
+ * \param[in] us - the time to advance by in us
+ */
+void sim_advance_us(double us);
+
+/* Intrinsics, the interrupt state is kept in the GIE bit of sim_sr */
+extern volatile unsigned int sim_sr;
+
+unsigned int _get_interrupt_state(void);
+void __set_interrupt_state(unsigned int state);
+void __disable_interrupt(void);
+void __enable_interrupt(void);
+void __bis_SR_register(unsigned int bits);
+void __bic_SR_register(unsigned int bits);
+void __bic_SR_register_on_exit(unsigned int bits);
+void __delay_cycles(unsigned long cycles);
+void __no_operation(void);
+
+#endif /* __SIM_MSP430_H__ */
@@ -0,0 +1,393 @@
+/**
+ * \file usci_b0.c
+ * \author Chris Karaplis
+ * \brief Simulated USCI_B0 in I2C master mode for host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "usci_b0.h"
+#include <msp430.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Time to let pass when nothing happens on the bus, in us */
+#define SIM_UCB0_IDLE_US    10
+
+/* Simulated time after which a sleep is considered hung, in us */
+#define SIM_UCB0_SLEEP_MAX_US   60e6
+
+/* Interrupts serviced in a row without any time passing, if isr_us is 0 */
+#define SIM_UCB0_STALL_MAX      100000UL
+
+/* Phases of the bus */
+enum
+{
+    SIM_UCB0_IDLE = 0,
+    SIM_UCB0_ADDRESS,   /* Address being sent after a (repeated) start */
+    SIM_UCB0_TX,        /* Master transmitting */
+    SIM_UCB0_RX,        /* Master receiving */
+    SIM_UCB0_NACKED     /* NACK received, waiting for the stop */
+};
+
+/* USCIAB0TX and USCIAB0RX interrupt handlers in usci.c */
+void usci_tx_isr(void);
+void usci_rx_isr(void);
+
+struct sim_ucb0_timing sim_ucb0_timing = {1000000.0, 0.0};
+struct sim_ucb0_stats sim_ucb0_stats;
+int sim_ucb0_fault = SIM_UCB0_FAULT_NONE;
+int sim_ucb0_nack_at = -1;
+volatile unsigned int sim_ucb0_txbuf = SIM_UCB0_TXBUF_EMPTY;
+
+static volatile unsigned char _ctl1 = UCSWRST;
+static unsigned char _rxbuf;
+static const struct sim_i2c_slave *_slave = NULL;
+static int _phase = SIM_UCB0_IDLE;
+static int _transmit = 0;
+static int _tx_count = 0;
+static unsigned int _tx_shift = SIM_UCB0_TXBUF_EMPTY;
+static int _rx_shifting = 0;
+static int _rx_last = 0;
+
+static void _step(void);
+static void _start(void);
+static void _address(void);
+static void _transmit_byte(void);
+static void _receive(void);
+static void _stop(void);
+static void _bits(unsigned int bits);
+static int _dispatch(void);
+
+/**
+ * \brief Access UCB0CTL1, advancing the bus first
+ * \return the register
+ */
+volatile unsigned char *sim_ucb0_ctl1(void)
+{
+    _step();
+
+    return &_ctl1;
+}
+
+/**
+ * \brief Read UCB0RXBUF, which clears UCB0RXIFG
+ * \return the received byte
+ */
+unsigned char sim_ucb0_rxbuf(void)
+{
+    IFG2 &= ~UCB0RXIFG;
+
+    return _rxbuf;
+}
+
+/**
+ * \brief Attach the slave to the bus
+ * \param[in] slave - the slave, NULL for none
+ */
+void sim_ucb0_attach(const struct sim_i2c_slave *slave)
+{
+    _slave = slave;
+}
+
+/**
+ * \brief Run the bus and its interrupts until an interrupt wakes the CPU
+ */
+void sim_ucb0_run(void)
+{
+    const double start = sim_time_us;
+    unsigned long stalled = 0;
+
+    sim_woken = 0;
+
+    while (sim_woken == 0) {
+        const double before = sim_time_us;
+
+        _step();
+
+        if (_dispatch() != 0) {
+            stalled++;
+        } else if (sim_time_us == before) {
+            /* Nothing happened, let time pass for the timers */
+            sim_advance_us(SIM_UCB0_IDLE_US);
+        } else {
+            /* The bus made progress */
+        }
+
+        if (sim_time_us != before) {
+            stalled = 0;
+        }
+
+        if (((sim_time_us - start) > SIM_UCB0_SLEEP_MAX_US) || (stalled > SIM_UCB0_STALL_MAX)) {
+            fprintf(stderr, "sim_ucb0_run: nothing woke the CPU\n");
+            abort();
+        }
+    }
+}
+
+/**
+ * \brief Run the bus until the current byte or condition has completed
+ */
+void sim_ucb0_idle(void)
+{
+    int i;
+
+    for (i = 0; (i < 100) && (_phase != SIM_UCB0_IDLE); i++) {
+        _step();
+    }
+}
+
+/**
+ * \brief Advance the bus by one event
+ *
+ * Each call completes at most one condition or byte, taking the time it
+ * needs on the bus. While UCB0TXIFG or UCB0RXIFG is pending, the USCI holds
+ * SCL low until the driver has serviced it.
+ */
+static void _step(void)
+{
+    if (_ctl1 & UCSWRST) {
+        /* The reset releases the bus and clears the flags */
+        _phase = SIM_UCB0_IDLE;
+        _rx_shifting = 0;
+        _rx_last = 0;
+        _tx_shift = SIM_UCB0_TXBUF_EMPTY;
+        sim_ucb0_txbuf = SIM_UCB0_TXBUF_EMPTY;
+        IFG2 &= ~(UCB0TXIFG | UCB0RXIFG);
+        UCB0STAT &= ~(UCNACKIFG | UCALIFG);
+
+        if (sim_ucb0_fault == SIM_UCB0_FAULT_HUNG) {
+            sim_ucb0_fault = SIM_UCB0_FAULT_NONE;
+        }
+    } else if (sim_ucb0_fault == SIM_UCB0_FAULT_HUNG) {
+        /* SCL is held low, nothing moves */
+    } else {
+        /* Loading UCB0TXBUF clears UCB0TXIFG */
+        if (sim_ucb0_txbuf != SIM_UCB0_TXBUF_EMPTY) {
+            IFG2 &= ~UCB0TXIFG;
+        }
+
+        if ((_ctl1 & UCTXSTT) && (_phase != SIM_UCB0_ADDRESS) && (_phase != SIM_UCB0_NACKED)) {
+            _start();
+        } else if (_phase == SIM_UCB0_ADDRESS) {
+            _address();
+        } else if (_phase == SIM_UCB0_TX) {
+            _transmit_byte();
+        } else if (_phase == SIM_UCB0_RX) {
+            _receive();
+        } else if ((_phase == SIM_UCB0_NACKED) && (_ctl1 & UCTXSTP)) {
+            _stop();
+        } else {
+            /* Idle, or waiting for the driver */
+        }
+    }
+}
+
+/**
+ * \brief Send a (repeated) start condition
+ *
+ * In transmit mode, UCB0TXIFG is set straight away so that the first data
+ * byte can be loaded while the address is sent.
+ */
+static void _start(void)
+{
+    _phase = SIM_UCB0_ADDRESS;
+    _transmit = ((_ctl1 & UCTR) != 0);
+    sim_ucb0_stats.starts++;
+    _bits(1);
+
+    if (_transmit) {
+        IFG2 |= UCB0TXIFG;
+    }
+}
+
+/**
+ * \brief Send the slave address and check its ACK
+ */
+static void _address(void)
+{
+    const uint8_t address = (uint8_t) (UCB0I2CSA & 0x7F);
+
+    _ctl1 &= ~UCTXSTT;
+    _bits(9);
+    sim_ucb0_stats.bytes++;
+
+    if ((_slave != NULL) && (_slave->start(address, !_transmit) != 0)) {
+        _phase = _transmit ? SIM_UCB0_TX : SIM_UCB0_RX;
+        _tx_count = 0;
+    } else {
+        UCB0STAT |= UCNACKIFG;
+        IFG2 &= ~UCB0TXIFG;
+        _phase = SIM_UCB0_NACKED;
+        sim_ucb0_stats.nacks++;
+    }
+}
+
+/**
+ * \brief Send the byte loaded in UCB0TXBUF, or the stop condition
+ *
+ * As on the USCI, the byte moves from UCB0TXBUF to the shift register
+ * first, which sets UCB0TXIFG so that the next byte can be loaded while it
+ * is sent. The slave's ACK or NACK comes at the end of the byte.
+ */
+static void _transmit_byte(void)
+{
+    if (_tx_shift != SIM_UCB0_TXBUF_EMPTY) {
+        const uint8_t data = (uint8_t) _tx_shift;
+
+        _tx_shift = SIM_UCB0_TXBUF_EMPTY;
+
+        if (sim_ucb0_fault == SIM_UCB0_FAULT_ARB_LOST) {
+            /* The USCI drops to slave mode and the other master owns the bus */
+            sim_ucb0_fault = SIM_UCB0_FAULT_NONE;
+            UCB0CTL0 &= ~UCMST;
+            UCB0STAT |= UCALIFG;
+            IFG2 &= ~UCB0TXIFG;
+            sim_ucb0_txbuf = SIM_UCB0_TXBUF_EMPTY;
+            _phase = SIM_UCB0_IDLE;
+            _bits(1);
+        } else {
+            int ack;
+
+            _bits(9);
+            sim_ucb0_stats.bytes++;
+
+            if (_tx_count++ == sim_ucb0_nack_at) {
+                sim_ucb0_nack_at = -1;
+                ack = 0;
+            } else {
+                ack = _slave->write(data);
+            }
+
+            if (ack == 0) {
+                UCB0STAT |= UCNACKIFG;
+                _phase = SIM_UCB0_NACKED;
+                sim_ucb0_stats.nacks++;
+            }
+        }
+    } else if (sim_ucb0_txbuf != SIM_UCB0_TXBUF_EMPTY) {
+        _tx_shift = sim_ucb0_txbuf;
+        sim_ucb0_txbuf = SIM_UCB0_TXBUF_EMPTY;
+        IFG2 |= UCB0TXIFG;
+    } else if (_ctl1 & UCTXSTP) {
+        _stop();
+    } else {
+        /* SCL is held low until the driver loads a byte */
+    }
+}
+
+/**
+ * \brief Receive the next byte, or send the stop condition after the last
+ *
+ * A byte is shifted in over two steps once UCB0RXIFG has been cleared, so
+ * that a stop requested in between applies to it, as on the USCI. The
+ * master NACKs that byte and sends the stop once it has been read.
+ */
+static void _receive(void)
+{
+    if ((IFG2 & UCB0RXIFG) == 0) {
+        if (_rx_last != 0) {
+            _rx_last = 0;
+            _stop();
+        } else if (_rx_shifting == 0) {
+            _rx_shifting = 1;
+        } else {
+            _rx_shifting = 0;
+            _bits(9);
+            sim_ucb0_stats.bytes++;
+            _rxbuf = _slave->read();
+            IFG2 |= UCB0RXIFG;
+
+            if (_ctl1 & UCTXSTP) {
+                _rx_last = 1;
+            }
+        }
+    }
+}
+
+/**
+ * \brief Send the stop condition
+ */
+static void _stop(void)
+{
+    _ctl1 &= ~UCTXSTP;
+    _phase = SIM_UCB0_IDLE;
+    _tx_shift = SIM_UCB0_TXBUF_EMPTY;
+    sim_ucb0_txbuf = SIM_UCB0_TXBUF_EMPTY;
+    sim_ucb0_stats.stops++;
+    _bits(1);
+
+    if (_slave != NULL) {
+        _slave->stop();
+    }
+}
+
+/**
+ * \brief Let the time of some bits pass on the bus
+ * \param[in] bits - the number of SCL periods
+ */
+static void _bits(unsigned int bits)
+{
+    const unsigned int prescaler = UCB0BR0 | (UCB0BR1 << 8);
+
+    sim_advance_us((bits * (double) prescaler * 1e6) / sim_ucb0_timing.brclk_hz);
+}
+
+/**
+ * \brief Service a pending USCI_B0 interrupt
+ * \return non-zero if an interrupt was serviced, 0 otherwise
+ *
+ * The state interrupts are serviced first, like the higher priority
+ * USCIAB0RX vector. Interrupts are disabled while the handler runs.
+ */
+static int _dispatch(void)
+{
+    void (*isr)(void) = NULL;
+
+    if ((sim_sr & GIE) == 0) {
+        /* Interrupts are disabled */
+    } else if (((UCB0I2CIE & UCNACKIE) && (UCB0STAT & UCNACKIFG)) ||
+               ((UCB0I2CIE & UCALIE) && (UCB0STAT & UCALIFG))) {
+        isr = usci_rx_isr;
+    } else if (((IE2 & UCB0TXIE) && (IFG2 & UCB0TXIFG)) ||
+               ((IE2 & UCB0RXIE) && (IFG2 & UCB0RXIFG))) {
+        isr = usci_tx_isr;
+    } else {
+        /* Nothing pending */
+    }
+
+    if (isr != NULL) {
+        sim_ucb0_stats.isrs++;
+        sim_advance_us(sim_ucb0_timing.isr_us);
+        sim_sr &= ~GIE;
+        isr();
+        sim_sr |= GIE;
+    }
+
+    return (isr != NULL);
+}
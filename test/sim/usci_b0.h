@@ -0,0 +1,105 @@
+/**
+ * \file usci_b0.h
+ * \author Chris Karaplis
+ * \brief Simulated USCI_B0 in I2C master mode for host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __SIM_USCI_B0_H__
+#define __SIM_USCI_B0_H__
+
+#include <stdint.h>
+
+/**
+ * I2C slave attached to the simulated bus. start() is called with the 7-bit
+ * address after a (repeated) start condition and write() with each byte
+ * the master sends, both return non-zero to ACK. read() provides the bytes
+ * the master receives and stop() is called after the stop condition.
+ */
+struct sim_i2c_slave
+{
+    int (*start)(uint8_t address, int read);
+    int (*write)(uint8_t data);
+    uint8_t (*read)(void);
+    void (*stop)(void);
+};
+
+/* Bus timing */
+struct sim_ucb0_timing
+{
+    double brclk_hz;    /* BRCLK (SMCLK) frequency, SCL runs at brclk_hz / (UCB0BR1:UCB0BR0) */
+    double isr_us;      /* CPU time to service an interrupt, the bus waits meanwhile */
+};
+
+/* Bus statistics */
+struct sim_ucb0_stats
+{
+    unsigned long starts;   /* Start and repeated start conditions */
+    unsigned long stops;    /* Stop conditions */
+    unsigned long bytes;    /* Bytes on the bus, including the addresses */
+    unsigned long nacks;    /* Address and data bytes which were not acknowledged */
+    unsigned long isrs;     /* Interrupts serviced */
+};
+
+/* Faults which can be injected */
+#define SIM_UCB0_FAULT_NONE     0
+#define SIM_UCB0_FAULT_HUNG     1   /* SCL is held low until USCI_B0 is reset */
+#define SIM_UCB0_FAULT_ARB_LOST 2   /* Another master wins the next data byte sent */
+
+extern struct sim_ucb0_timing sim_ucb0_timing;
+extern struct sim_ucb0_stats sim_ucb0_stats;
+extern int sim_ucb0_fault;
+
+/* Index of the next data byte written which the bus NACKs, -1 for none */
+extern int sim_ucb0_nack_at;
+
+/**
+ * \brief Attach the slave to the bus
+ * \param[in] slave - the slave, NULL for none
+ */
+void sim_ucb0_attach(const struct sim_i2c_slave *slave);
+
+/**
+ * \brief Run the bus and its interrupts until an interrupt wakes the CPU
+ *
+ * To be installed as sim_sleep. The interrupts are dispatched to the
+ * USCIAB0TX and USCIAB0RX vectors of usci.c. While the bus is idle or hung,
+ * the simulated time keeps running so that timers expire.
+ */
+void sim_ucb0_run(void);
+
+/**
+ * \brief Run the bus until the current byte or condition has completed
+ *
+ * Lets a transfer which was left in progress, e.g. a stop condition, reach
+ * the idle state without any interrupts.
+ */
+void sim_ucb0_idle(void);
+
+#endif /* __SIM_USCI_B0_H__ */
@@ -0,0 +1,285 @@
+/**
+ * \file sim_test.c
+ * \author Chris Karaplis
+ * \brief Self-test of the 24xx EEPROM model used by the host tests
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include "test.h"
+#include "eeprom_24xx.h"
+#include <stdint.h>
+#include <string.h>
+#include <msp430.h>
+
+/* Base address of the EEPROM */
+#define EEPROM_ADDRESS  0x50
+
+/* Write cycle of the parts */
+#define WRITE_TIME_US   5000
+
+static void _test_page_write(void);
+static void _test_busy(void);
+static void _test_read(void);
+static void _test_blocks(void);
+static void _test_two_byte_address(void);
+static int _write(uint8_t address, uint16_t mem, const uint8_t *data, size_t len, uint8_t addr_width);
+static int _read(uint8_t address, uint8_t *buf, size_t len);
+static void _device(uint32_t size, uint16_t page_size, uint8_t addr_width);
+
+int main(void)
+{
+    _test_page_write();
+    _test_busy();
+    _test_read();
+    _test_blocks();
+    _test_two_byte_address();
+
+    return test_result("sim_test");
+}
+
+/**
+ * \brief Page writes are latched until the stop and wrap at the end of the page
+ */
+static void _test_page_write(void)
+{
+    const uint8_t data[] = {1, 2, 3, 4};
+    unsigned int i;
+
+    _device(256, 8, 1);
+
+    /* Nothing is stored before the stop condition */
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS, 0) != 0);
+    TEST_CHECK((sim_24xx.write(22) != 0) && (sim_24xx.write(data[0]) != 0));
+    TEST_CHECK(sim_24xx_mem[22] == 0xFF);
+    sim_24xx.stop();
+    TEST_CHECK(sim_24xx_mem[22] == 1);
+    TEST_CHECK((sim_24xx_stats.write_cycles == 1) && (sim_24xx_stats.written == 1));
+
+    /* Two bytes past the end of the page land at its start */
+    sim_advance_us(WRITE_TIME_US);
+    TEST_CHECK(_write(EEPROM_ADDRESS, 30, data, sizeof(data), 1));
+    TEST_CHECK((sim_24xx_mem[30] == 1) && (sim_24xx_mem[31] == 2));
+    TEST_CHECK((sim_24xx_mem[24] == 3) && (sim_24xx_mem[25] == 4) && (sim_24xx_mem[32] == 0xFF));
+    TEST_CHECK(sim_24xx_stats.written == 5);
+
+    /* Bytes written twice to the same place count as rollovers, the last wins */
+    sim_advance_us(WRITE_TIME_US);
+    TEST_CHECK(sim_24xx_stats.rollovers == 0);
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS, 0) != 0);
+    TEST_CHECK(sim_24xx.write(0) != 0);
+
+    for (i = 0; i < 10; i++) {
+        TEST_CHECK(sim_24xx.write((uint8_t) i) != 0);
+    }
+
+    sim_24xx.stop();
+    TEST_CHECK((sim_24xx_stats.rollovers == 2) && (sim_24xx_stats.written == 13));
+    TEST_CHECK((sim_24xx_mem[0] == 8) && (sim_24xx_mem[1] == 9) && (sim_24xx_mem[2] == 2));
+
+    /* A stop without data is not a write cycle */
+    sim_advance_us(WRITE_TIME_US);
+    TEST_CHECK(_write(EEPROM_ADDRESS, 0, data, 0, 1));
+    TEST_CHECK(sim_24xx_stats.write_cycles == 3);
+}
+
+/**
+ * \brief The device NACKs its address until the write cycle is over
+ */
+static void _test_busy(void)
+{
+    const uint8_t data[] = {0x42};
+    uint8_t buf[1];
+
+    _device(256, 8, 1);
+
+    TEST_CHECK(_write(EEPROM_ADDRESS, 5, data, sizeof(data), 1));
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS, 0) == 0);
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS, 1) == 0);
+    TEST_CHECK(sim_24xx_stats.busy_nacks == 2);
+
+    sim_advance_us(WRITE_TIME_US - 100);
+    TEST_CHECK(_read(EEPROM_ADDRESS, buf, sizeof(buf)) == 0);
+    TEST_CHECK(sim_24xx_stats.busy_nacks == 3);
+
+    sim_advance_us(100);
+    TEST_CHECK(_read(EEPROM_ADDRESS, buf, sizeof(buf)) != 0);
+    TEST_CHECK((buf[0] == 0xFF) && (sim_24xx_stats.busy_nacks == 3));
+
+    /* Other addresses are never acknowledged */
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS + 1, 0) == 0);
+    TEST_CHECK(sim_24xx_stats.busy_nacks == 3);
+}
+
+/**
+ * \brief Reads continue from the address pointer and roll over at the end
+ */
+static void _test_read(void)
+{
+    uint8_t buf[4];
+    unsigned int i;
+
+    _device(256, 8, 1);
+
+    for (i = 0; i < 256; i++) {
+        sim_24xx_mem[i] = (uint8_t) i;
+    }
+
+    /* A random read sets the pointer with a dummy write, without a write cycle */
+    TEST_CHECK(_write(EEPROM_ADDRESS, 253, NULL, 0, 1));
+    TEST_CHECK(_read(EEPROM_ADDRESS, buf, sizeof(buf)) != 0);
+    TEST_CHECK((buf[0] == 253) && (buf[1] == 254) && (buf[2] == 255) && (buf[3] == 0));
+    TEST_CHECK(sim_24xx_stats.write_cycles == 0);
+
+    /* A current address read carries on from there */
+    TEST_CHECK(_read(EEPROM_ADDRESS, buf, 2) != 0);
+    TEST_CHECK((buf[0] == 1) && (buf[1] == 2));
+    TEST_CHECK(sim_24xx_stats.read == 6);
+}
+
+/**
+ * \brief Parts of more than 256 bytes with 1 address byte answer per block
+ */
+static void _test_blocks(void)
+{
+    const uint8_t data[] = {0xA5};
+    uint8_t buf[2];
+
+    _device(512, 16, 1);
+
+    TEST_CHECK(_write(EEPROM_ADDRESS + 1, 0x10, data, sizeof(data), 1));
+    TEST_CHECK((sim_24xx_mem[0x110] == 0xA5) && (sim_24xx_mem[0x10] == 0xFF));
+
+    /* A sequential read crosses into the next block and wraps at the end */
+    sim_advance_us(WRITE_TIME_US);
+    sim_24xx_mem[0x1FF] = 0x11;
+    sim_24xx_mem[0] = 0x22;
+    TEST_CHECK(_write(EEPROM_ADDRESS + 1, 0xFF, NULL, 0, 1));
+    TEST_CHECK(_read(EEPROM_ADDRESS, buf, sizeof(buf)) != 0);
+    TEST_CHECK((buf[0] == 0x11) && (buf[1] == 0x22));
+
+    /* Beyond the blocks of the part */
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS + 2, 0) == 0);
+}
+
+/**
+ * \brief Parts with 2 address bytes, the address rolls over at the capacity
+ */
+static void _test_two_byte_address(void)
+{
+    const uint8_t data[] = {1, 2};
+    uint8_t buf[2];
+
+    _device(4096, 32, 2);
+
+    TEST_CHECK(_write(EEPROM_ADDRESS, 0x0123, data, sizeof(data), 2));
+    TEST_CHECK((sim_24xx_mem[0x123] == 1) && (sim_24xx_mem[0x124] == 2));
+
+    /* Address bits above the capacity are ignored */
+    sim_advance_us(WRITE_TIME_US);
+    TEST_CHECK(_write(EEPROM_ADDRESS, 0x1123, NULL, 0, 2));
+    TEST_CHECK(_read(EEPROM_ADDRESS, buf, sizeof(buf)) != 0);
+    TEST_CHECK((buf[0] == 1) && (buf[1] == 2));
+    TEST_CHECK(sim_24xx.start(EEPROM_ADDRESS + 1, 0) == 0);
+}
+
+/**
+ * \brief Write to the device, or only set its address pointer
+ * \param[in] address - the 7-bit I2C address
+ * \param[in] mem - the memory address
+ * \param[in] data - the data, NULL if len is 0
+ * \param[in] len - the number of bytes to write
+ * \param[in] addr_width - the number of memory address bytes
+ * \return non-zero if the device acknowledged its address, 0 otherwise
+ */
+static int _write(uint8_t address, uint16_t mem, const uint8_t *data, size_t len, uint8_t addr_width)
+{
+    int ack = sim_24xx.start(address, 0);
+
+    if (ack != 0) {
+        size_t i;
+
+        if (addr_width == 2) {
+            TEST_CHECK(sim_24xx.write(mem >> 8) != 0);
+        }
+
+        TEST_CHECK(sim_24xx.write(mem & 0xFF) != 0);
+
+        for (i = 0; i < len; i++) {
+            TEST_CHECK(sim_24xx.write(data[i]) != 0);
+        }
+
+        sim_24xx.stop();
+    }
+
+    return ack;
+}
+
+/**
+ * \brief Read from the address pointer of the device
+ * \param[in] address - the 7-bit I2C address
+ * \param[out] buf - the buffer to store the data
+ * \param[in] len - the number of bytes to read
+ * \return non-zero if the device acknowledged its address, 0 otherwise
+ */
+static int _read(uint8_t address, uint8_t *buf, size_t len)
+{
+    int ack = sim_24xx.start(address, 1);
+
+    if (ack != 0) {
+        size_t i;
+
+        for (i = 0; i < len; i++) {
+            buf[i] = sim_24xx.read();
+        }
+
+        sim_24xx.stop();
+    }
+
+    return ack;
+}
+
+/**
+ * \brief Reset the simulated device
+ * \param[in] size - the capacity in bytes
+ * \param[in] page_size - the page size in bytes
+ * \param[in] addr_width - the number of memory address bytes
+ */
+static void _device(uint32_t size, uint16_t page_size, uint8_t addr_width)
+{
+    struct sim_24xx_config config;
+
+    config.address = EEPROM_ADDRESS;
+    config.size = size;
+    config.page_size = page_size;
+    config.addr_width = addr_width;
+    config.write_time_us = WRITE_TIME_US;
+    sim_24xx_init(&config);
+}
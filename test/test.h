@@ -0,0 +1,88 @@
+/**
+ * \file test.h
+ * \author Chris Karaplis
+ * \brief Minimal host test helpers
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+
+/* The POSIX timers of <time.h> clash with timer.h, whose tests leave it out */
+#ifndef TEST_NO_SECONDS
+#include <time.h>
+#endif
+
+/* Number of failed checks in the test program */
+static int test_failures = 0;
+
+/**
+ * \brief Check a condition, reporting the location if it does not hold
+ * \param cond - the condition
+ *
+ * Execution continues after a failed check so that every failure is reported.
+ */
+#define TEST_CHECK(cond)                                                       \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+/**
+ * \brief Report the result of the test program
+ * \param[in] name - the name of the test program
+ * \return the exit status, 0 if all checks passed, 1 otherwise
+ */
+static inline int test_result(const char *name)
+{
+    printf("%s: %s\n", name, (test_failures == 0) ? "PASS" : "FAIL");
+
+    return (test_failures == 0) ? 0 : 1;
+}
+
+#ifndef TEST_NO_SECONDS
+/**
+ * \brief Get a monotonic timestamp for benchmarks
+ * \return the time in seconds
+ */
+static inline double test_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+#endif
+
+#endif /* __TEST_H__ */
@@ -0,0 +1,169 @@
+/**
+ * \file timer_test.c
+ * \author Chris Karaplis
+ * \brief Timer module tests against the simulated Timer1_A
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#define TEST_NO_SECONDS
+#include "test.h"
+#include "timer.h"
+#include <stdint.h>
+#include <msp430.h>
+
+/* Timer tick interrupt handler, every 100ms */
+void timer1_isr(void);
+
+/* Length of a timer tick in us */
+#define TICK_US     100000UL
+
+static void _test_timers(void);
+static void _test_timestamp(void);
+static void _test_wrap(void);
+static void _ticks(unsigned int n);
+static void _count(void *arg);
+
+int main(void)
+{
+    sim_timer1_a0 = timer1_isr;
+    __enable_interrupt();
+    (void) timer_init();
+
+    _test_timers();
+    _test_timestamp();
+    _test_wrap();
+
+    return test_result("timer_test");
+}
+
+/**
+ * \brief Single shot and periodic timers
+ */
+static void _test_timers(void)
+{
+    unsigned int once = 0;
+    unsigned int periodic = 0;
+    int handle;
+
+    TEST_CHECK(timer_create(300, 0, _count, &once) >= 0);
+    handle = timer_create(200, 1, _count, &periodic);
+    TEST_CHECK(handle >= 0);
+
+    _ticks(2);
+    TEST_CHECK((once == 0) && (periodic == 1));
+    _ticks(1);
+    TEST_CHECK((once == 1) && (periodic == 1));
+    _ticks(5);
+    TEST_CHECK((once == 1) && (periodic == 4));
+
+    /* Deleted timers do not fire, and their slot is free again */
+    TEST_CHECK(timer_delete(handle) == 0);
+    _ticks(4);
+    TEST_CHECK(periodic == 4);
+    TEST_CHECK(timer_delete(-1) == -1);
+
+    /* Timeouts shorter than a tick last one tick */
+    TEST_CHECK(timer_create(10, 0, _count, &once) >= 0);
+    _ticks(1);
+    TEST_CHECK(once == 2);
+}
+
+/**
+ * \brief Timestamps count in 2us steps within and across ticks
+ */
+static void _test_timestamp(void)
+{
+    uint32_t start = timer_timestamp_us();
+
+    sim_advance_us(150);
+    TEST_CHECK(timer_timestamp_us() - start == 150);
+    sim_advance_us(TICK_US + 20);
+    TEST_CHECK(timer_timestamp_us() - start == TICK_US + 170);
+
+    /* A tick which has not been handled yet is counted */
+    start = timer_timestamp_us();
+    __disable_interrupt();
+    sim_advance_us(TICK_US);
+    TEST_CHECK(timer_timestamp_us() - start == TICK_US);
+    __enable_interrupt();
+    sim_advance_us(0);
+    TEST_CHECK(timer_timestamp_us() - start == TICK_US);
+}
+
+/**
+ * \brief Intervals across the wrap of the 16-bit tick and of the timestamp
+ *
+ * The tick counter wraps after 6553.6s, the timestamp after 2^32us, about
+ * 71.6 minutes. Intervals measured across either point are still correct.
+ */
+static void _test_wrap(void)
+{
+    unsigned int once = 0;
+    uint32_t start;
+    unsigned long i;
+
+    for (i = 0; i < 65536UL; i++) {
+        start = timer_timestamp_us();
+        sim_advance_us(TICK_US);
+        TEST_CHECK(timer_timestamp_us() - start == TICK_US);
+
+        /* Timers keep firing across the wrap of the tick counter */
+        if ((i % 4096) == 4095) {
+            TEST_CHECK(timer_create(200, 0, _count, &once) >= 0);
+        } else if ((i % 4096) == 1) {
+            TEST_CHECK(once == (i / 4096));
+        }
+    }
+
+    _ticks(2);
+    TEST_CHECK(once == 16);
+}
+
+/**
+ * \brief Advance the simulated time by whole timer ticks
+ * \param[in] n - the number of ticks
+ *
+ * Each tick is handled before the next one, as on the target.
+ */
+static void _ticks(unsigned int n)
+{
+    while (n-- > 0) {
+        sim_advance_us(TICK_US);
+    }
+}
+
+/**
+ * \brief Timer callback, counts its calls
+ * \param[in] arg - the counter to increment
+ */
+static void _count(void *arg)
+{
+    (*(unsigned int *) arg)++;
+}
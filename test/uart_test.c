@@ -0,0 +1,654 @@
+/**
+ * \file uart_test.c
+ * \author Chris Karaplis
+ * \brief UART driver tests against the simulated USCI_A0
+ *
+ * Copyright (c) 2017, simplyembedded.org
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define TEST_NO_SECONDS
+#include "test.h"
+#include "uart.h"
+#include "timer.h"
+#include "usci.h"
+#include "ring_buffer.h"
+#include "watchdog.h"
+#include <stdint.h>
+#include <string.h>
+#include <msp430.h>
+
+/* Software flow control characters */
+#define XON     0x11
+#define XOFF    0x13
+
+/* CTS interrupt handler */
+void port2_isr(void);
+
+/* Timer tick interrupt handler, every 100ms */
+void timer1_isr(void);
+
+/* SMCLK frequency in Hz */
+static uint32_t _smclk = 1000000;
+
+/* Number of times the watchdog was pet, and whether the TX ISR runs meanwhile */
+static unsigned int _pets = 0;
+static int _pet_tx = 0;
+
+/* Number of times the CPU slept, and was woken by the TX ISR */
+static unsigned int _sleeps = 0;
+static unsigned int _wakes = 0;
+
+static void _test_raw(void);
+static void _test_line(void);
+static void _test_write(void);
+static void _test_write_wait(void);
+static void _test_read_wait(void);
+static void _test_xonxoff(void);
+static void _test_rtscts(void);
+static void _test_baud(void);
+static void _init(uart_flow_t flow);
+static int _reset(uart_config_t *config);
+static void _rx(const char *data, size_t len);
+static size_t _tx_drain(void);
+static int _tx_equals(const char *data, size_t len);
+static void _sleep_tx(void);
+static void _sleep_rx(void);
+static void _nop(void *arg);
+
+int main(void)
+{
+    _init(UART_FLOW_NONE);
+    _test_raw();
+    _test_line();
+    _test_write();
+    _test_write_wait();
+    _test_read_wait();
+
+    _init(UART_FLOW_XONXOFF);
+    _test_xonxoff();
+
+    _init(UART_FLOW_RTSCTS);
+    _test_rtscts();
+
+    _test_baud();
+
+    return test_result("uart_test");
+}
+
+uint32_t board_get_smclk(void)
+{
+    return _smclk;
+}
+
+/**
+ * \brief Pet the watchdog, one timer tick passes each time
+ *
+ * Stands in for the time spent by the driver while it waits. If enabled,
+ * the TX ISR also sends a byte, if it can.
+ */
+void watchdog_pet(void)
+{
+    _pets++;
+
+    if (_pet_tx != 0) {
+        IFG2 |= UCA0TXIFG;
+        (void) uart_tx_isr();
+    }
+
+    timer1_isr();
+}
+
+/**
+ * \brief Raw mode reception, overflow and statistics
+ */
+static void _test_raw(void)
+{
+    uint8_t buf[40];
+    rb_stats_t stats;
+    size_t i;
+
+    _rx("abc", 3);
+    TEST_CHECK(uart_getchar() == 'a');
+    TEST_CHECK(uart_getchar() == 'b');
+    TEST_CHECK(uart_getchar() == 'c');
+    TEST_CHECK(uart_getchar() == -1);
+
+    TEST_CHECK(uart_rx_stats(&stats, 1) == 0);
+    TEST_CHECK((stats.size == 32) && (stats.peak == 3) && (stats.puts == 3) && (stats.gets == 3));
+    TEST_CHECK(stats.drops == 0);
+
+    /* The bytes which do not fit are dropped and counted */
+    for (i = 0; i < sizeof(buf); i++) {
+        const char c = (char) i;
+
+        _rx(&c, 1);
+    }
+
+    TEST_CHECK(uart_read(buf, sizeof(buf), 0, -1) == 32);
+
+    for (i = 0; i < 32; i++) {
+        TEST_CHECK(buf[i] == i);
+    }
+
+    TEST_CHECK(uart_rx_stats(&stats, 1) == 0);
+    TEST_CHECK((stats.peak == 32) && (stats.puts == 32) && (stats.gets == 32) && (stats.drops == 8));
+    TEST_CHECK(uart_rx_stats(&stats, 0) == 0);
+    TEST_CHECK((stats.peak == 0) && (stats.puts == 0) && (stats.gets == 0) && (stats.drops == 0));
+
+    /* Binary data up to and including the delimiter */
+    _rx("12\0" "34", 5);
+    TEST_CHECK(uart_read(buf, sizeof(buf), 0, 0) == 3);
+    TEST_CHECK(memcmp(buf, "12\0", 3) == 0);
+    TEST_CHECK(uart_read(buf, 1, 0, 0) == 1);
+    TEST_CHECK(uart_read(buf, sizeof(buf), 0, 0) == 1);
+    TEST_CHECK(uart_read(buf, sizeof(buf), 0, 0) == 0);
+    TEST_CHECK(uart_read(NULL, sizeof(buf), 0, 0) == -1);
+
+    /* Bytes with the top bit set are not mistaken for an empty buffer */
+    _rx("\xff\x80\xff", 3);
+    TEST_CHECK(uart_getchar() == 0xFF);
+    TEST_CHECK(uart_read(buf, sizeof(buf), 0, -1) == 2);
+    TEST_CHECK((buf[0] == 0x80) && (buf[1] == 0xFF));
+}
+
+/**
+ * \brief Line assembly, editing and echo
+ */
+static void _test_line(void)
+{
+    char line[UART_LINE_MAX + 1];
+    rb_stats_t stats;
+    int i;
+
+    uart_set_mode(UART_MODE_LINE);
+    sim_uca0_tx_len = 0;
+
+    _rx("12", 2);
+    TEST_CHECK(uart_line_ready() == 0);
+    TEST_CHECK(uart_getline(line, sizeof(line)) == -1);
+
+    /* Backspace, CR/LF pairs and LF alone */
+    _rx("\b3\r\n45\n", 7);
+    TEST_CHECK(uart_line_ready() == 2);
+    TEST_CHECK(_tx_equals("12\b \b3\n\r45\n\r", 12));
+    TEST_CHECK((uart_getline(line, sizeof(line)) == 2) && (strcmp(line, "13") == 0));
+    TEST_CHECK((uart_getline(line, sizeof(line)) == 2) && (strcmp(line, "45") == 0));
+    TEST_CHECK(uart_getline(line, sizeof(line)) == -1);
+
+    /* Long lines are truncated to UART_LINE_MAX */
+    _rx("abcdefghijklmnopqrstu\r", 22);
+    TEST_CHECK(uart_getline(line, sizeof(line)) == UART_LINE_MAX);
+    TEST_CHECK(strcmp(line, "abcdefghijklmnop") == 0);
+
+    /* Lines which do not fit in the RX ring buffer are dropped */
+    TEST_CHECK(uart_rx_stats(&stats, 1) == 0);
+
+    for (i = 0; i < 4; i++) {
+        _rx("1234567\r", 8);
+    }
+
+    _rx("x\r", 2);
+    TEST_CHECK(uart_line_ready() == 4);
+    TEST_CHECK(uart_rx_stats(&stats, 1) == 0);
+    TEST_CHECK((stats.peak == 32) && (stats.drops == 2));
+
+    for (i = 0; i < 4; i++) {
+        TEST_CHECK((uart_getline(line, sizeof(line)) == 7) && (strcmp(line, "1234567") == 0));
+    }
+
+    TEST_CHECK(uart_line_ready() == 0);
+
+    /* Including a line which only partly fits */
+    for (i = 0; i < 3; i++) {
+        _rx("1234567\r", 8);
+    }
+
+    _rx("abcdefghij\r", 11);
+    TEST_CHECK(uart_line_ready() == 3);
+    TEST_CHECK(uart_rx_stats(&stats, 1) == 0);
+    TEST_CHECK(stats.drops == 11);
+
+    for (i = 0; i < 3; i++) {
+        TEST_CHECK((uart_getline(line, sizeof(line)) == 7) && (strcmp(line, "1234567") == 0));
+    }
+
+    TEST_CHECK(uart_line_ready() == 0);
+
+    /* A line being edited is out of reach of the reader until committed */
+    _rx("ab\rcd", 5);
+    TEST_CHECK((uart_getline(line, sizeof(line)) == 2) && (strcmp(line, "ab") == 0));
+    TEST_CHECK(uart_getline(line, sizeof(line)) == -1);
+    _rx("\be\r", 3);
+    TEST_CHECK((uart_getline(line, sizeof(line)) == 2) && (strcmp(line, "ce") == 0));
+    TEST_CHECK(uart_line_ready() == 0);
+
+    /* Lines read as blocks of data are consumed as well */
+    _rx("ab\rcd\r", 6);
+    TEST_CHECK(uart_line_ready() == 2);
+    TEST_CHECK(uart_read(line, sizeof(line), 0, '\n') == 3);
+    TEST_CHECK(memcmp(line, "ab\n", 3) == 0);
+    TEST_CHECK(uart_line_ready() == 1);
+    TEST_CHECK(uart_read(line, 1, 0, -1) == 1);
+    TEST_CHECK((uart_getline(line, sizeof(line)) == 1) && (strcmp(line, "d") == 0));
+    TEST_CHECK(uart_line_ready() == 0);
+    TEST_CHECK(uart_getline(line, sizeof(line)) == -1);
+
+    /* Switching modes discards pending input */
+    _rx("zz\r", 3);
+    uart_set_mode(UART_MODE_RAW);
+    TEST_CHECK(uart_getchar() == -1);
+    _rx("x\r", 2);
+    TEST_CHECK(uart_getchar() == 'x');
+    TEST_CHECK(uart_getchar() == '\r');
+}
+
+/**
+ * \brief Non-blocking writes queue only what fits in the TX ring buffer
+ */
+static void _test_write(void)
+{
+    char data[40];
+    size_t i;
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = (char) ('0' + i);
+    }
+
+    sim_uca0_tx_len = 0;
+    TEST_CHECK(uart_write(data, sizeof(data)) == 32);
+    TEST_CHECK(uart_write(&data[32], sizeof(data) - 32) == 0);
+    TEST_CHECK(_tx_drain() == 32);
+    TEST_CHECK(uart_write(&data[32], sizeof(data) - 32) == 8);
+    TEST_CHECK(_tx_equals(data, sizeof(data)));
+    TEST_CHECK(uart_write(NULL, 1) == -1);
+}
+
+/**
+ * \brief Blocking writes and flushes give up once transmission stalls
+ */
+static void _test_write_wait(void)
+{
+    char data[100];
+    size_t i;
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = (char) i;
+    }
+
+    /* The TX ISR sends a byte each time the watchdog is pet */
+    sim_uca0_tx_len = 0;
+    _pet_tx = 1;
+    _pets = 0;
+    TEST_CHECK(uart_write_all(data, sizeof(data)) == sizeof(data));
+    TEST_CHECK(uart_flush() == 0);
+    TEST_CHECK(_pets > 0);
+    TEST_CHECK(_tx_equals(data, sizeof(data)));
+    TEST_CHECK(uart_write_all(NULL, 1) == -1);
+    _pet_tx = 0;
+
+    /* Without a free timer, the CPU sleeps until the TX ISR makes room */
+    for (i = 0; timer_create(60000, 1, _nop, NULL) >= 0; i++);
+
+    TEST_CHECK(i > 0);
+    sim_uca0_tx_len = 0;
+    sim_sleep = _sleep_tx;
+    _sleeps = 0;
+    _wakes = 0;
+    TEST_CHECK(uart_write_all(data, sizeof(data)) == sizeof(data));
+    TEST_CHECK(uart_flush() == 0);
+    TEST_CHECK((_sleeps > 0) && (_wakes == _sleeps));
+    TEST_CHECK(_tx_equals(data, sizeof(data)));
+    sim_sleep = NULL;
+
+    while (i-- > 0) {
+        TEST_CHECK(timer_delete((int) i) == 0);
+    }
+}
+
+/**
+ * \brief Reads with a timeout sleep until data arrives or the time is up
+ */
+static void _test_read_wait(void)
+{
+    uint8_t buf[8];
+    size_t i;
+
+    /* Each time the watchdog is pet, a timer tick of 100ms passes */
+    _pets = 0;
+    TEST_CHECK(uart_read(buf, sizeof(buf), 300, -1) == 0);
+    TEST_CHECK(_pets == 3);
+
+    /* The timeout is kept without a free timer, it never turns into no wait */
+    for (i = 0; timer_create(60000, 1, _nop, NULL) >= 0; i++);
+
+    TEST_CHECK(i > 0);
+    _pets = 0;
+    TEST_CHECK(uart_read(buf, sizeof(buf), 300, -1) == 0);
+    TEST_CHECK(_pets == 3);
+
+    /* Data received while the CPU sleeps wakes it */
+    sim_sleep = _sleep_rx;
+    _sleeps = 0;
+    _pets = 0;
+    TEST_CHECK(uart_read(buf, sizeof(buf), 300, 0) == 3);
+    TEST_CHECK(memcmp(buf, "ab\0", 3) == 0);
+    TEST_CHECK((_sleeps == 1) && (_pets == 1));
+    sim_sleep = NULL;
+
+    while (i-- > 0) {
+        TEST_CHECK(timer_delete((int) i) == 0);
+    }
+}
+
+/**
+ * \brief Software flow control in both directions
+ */
+static void _test_xonxoff(void)
+{
+    char data[40];
+    char c = 'a';
+    int i;
+
+    sim_uca0_tx_len = 0;
+
+    /* XOFF is sent when 24 of the 32 bytes are used, XON once 8 are left */
+    for (i = 0; i < 23; i++) {
+        _rx(&c, 1);
+    }
+
+    TEST_CHECK(sim_uca0_tx_len == 0);
+    _rx(&c, 1);
+    TEST_CHECK(_tx_equals("\x13", 1));
+
+    for (i = 0; i < 15; i++) {
+        TEST_CHECK(uart_getchar() == 'a');
+    }
+
+    TEST_CHECK(_tx_drain() == 0);
+    TEST_CHECK(uart_getchar() == 'a');
+    TEST_CHECK(_tx_equals("\x13\x11", 2));
+
+    /* Transmission pauses while the host has sent XOFF */
+    c = XOFF;
+    _rx(&c, 1);
+    TEST_CHECK(uart_puts("hi") == 2);
+    TEST_CHECK(_tx_drain() == 0);
+
+    /* Waits give up after 500ms, five timer ticks, petting the watchdog */
+    memset(data, 'x', sizeof(data));
+    _pets = 0;
+    TEST_CHECK(uart_write_all(data, sizeof(data)) == 30);
+    TEST_CHECK(_pets == 5);
+    TEST_CHECK(uart_flush() == -1);
+    TEST_CHECK(_pets == 10);
+
+    c = XON;
+    _rx(&c, 1);
+    TEST_CHECK(sim_uca0_tx_len == 34);
+    TEST_CHECK(_tx_equals("\x13\x11hixxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", 34));
+    TEST_CHECK(uart_flush() == 0);
+
+    /* The flow control characters are not received as data */
+    for (i = 0; i < 8; i++) {
+        TEST_CHECK(uart_getchar() == 'a');
+    }
+
+    TEST_CHECK(uart_getchar() == -1);
+}
+
+/**
+ * \brief Hardware flow control in both directions
+ */
+static void _test_rtscts(void)
+{
+    const char c = 'a';
+    int i;
+
+    sim_uca0_tx_len = 0;
+    TEST_CHECK((P2OUT & BIT0) == 0);
+
+    /* RTS is deasserted (high) at the high water mark and asserted at the low one */
+    for (i = 0; i < 24; i++) {
+        _rx(&c, 1);
+    }
+
+    TEST_CHECK((P2OUT & BIT0) != 0);
+
+    for (i = 0; i < 16; i++) {
+        TEST_CHECK(uart_getchar() == 'a');
+    }
+
+    TEST_CHECK((P2OUT & BIT0) == 0);
+    TEST_CHECK(sim_uca0_tx_len == 0);
+
+    /* Transmission pauses while CTS is deasserted (high) */
+    P2IN |= BIT1;
+    TEST_CHECK(uart_puts("hi") == 2);
+    TEST_CHECK(_tx_drain() == 0);
+    _pets = 0;
+    TEST_CHECK(uart_flush() == -1);
+    TEST_CHECK(_pets == 5);
+
+    P2IN &= ~BIT1;
+    P2IFG |= BIT1;
+    port2_isr();
+    TEST_CHECK(_tx_equals("hi", 2));
+
+    while (uart_getchar() >= 0);
+}
+
+/**
+ * \brief Baud rate registers against the tables of the reference manual
+ *
+ * The rows are from SLAU144 tables 15-4 (UCOS16 = 0) and 15-5 (UCOS16 = 1)
+ * for the mode the driver picks. The tables tune UCBRSx for the lowest bit
+ * error, while the driver rounds the fractional divider, so the low
+ * frequency modulation may be off by one.
+ */
+static void _test_baud(void)
+{
+    static const struct
+    {
+        uint32_t clk;
+        uint32_t baud;
+        uint16_t br;
+        uint8_t os;
+        uint8_t mod;    /* UCBRFx when oversampling, UCBRSx otherwise */
+    } rows[] = {
+        {1000000, 9600, 6, 1, 8},
+        {1000000, 19200, 3, 1, 4},
+        {1000000, 57600, 17, 0, 3},
+        {1000000, 115200, 8, 0, 6},
+        {8000000, 9600, 52, 1, 1},
+        {8000000, 19200, 26, 1, 1},
+        {8000000, 38400, 13, 1, 0},
+        {8000000, 57600, 8, 1, 11},
+        {8000000, 115200, 4, 1, 5},
+        {16000000, 9600, 104, 1, 3},
+        {16000000, 19200, 52, 1, 1},
+        {16000000, 38400, 26, 1, 1},
+        {16000000, 57600, 17, 1, 6},
+        {16000000, 115200, 8, 1, 11}
+    };
+    uart_config_t config = {0, UART_FLOW_NONE, 0};
+    size_t i;
+
+    for (i = 0; i < (sizeof(rows) / sizeof(rows[0])); i++) {
+        _smclk = rows[i].clk;
+        config.baud = rows[i].baud;
+        TEST_CHECK(_reset(&config) == 0);
+        TEST_CHECK(((UCA0BR0 | (UCA0BR1 << 8)) == rows[i].br) && ((UCA0MCTL & UCOS16) == rows[i].os));
+        TEST_CHECK((config.error <= 20) && (config.error >= -20));
+
+        if (rows[i].os != 0) {
+            TEST_CHECK((UCA0MCTL >> 4) == rows[i].mod);
+        } else {
+            const int brs = (UCA0MCTL >> 1) & 0x7;
+
+            TEST_CHECK((brs >= (rows[i].mod - 1)) && (brs <= (rows[i].mod + 1)));
+        }
+    }
+
+    /* The error is reported in tenths of a percent */
+    _smclk = 1000000;
+    config.baud = 115200;
+    TEST_CHECK((_reset(&config) == 0) && (config.error == 6));
+
+    /* Rates which need a divider below 3 are rejected */
+    config.baud = 400000;
+    TEST_CHECK(_reset(&config) == -1);
+}
+
+/**
+ * \brief Initialize the UART, as if after a reset
+ * \param[in] flow - the flow control
+ */
+static void _init(uart_flow_t flow)
+{
+    uart_config_t config = {9600, UART_FLOW_NONE, 0};
+
+    config.flow = flow;
+    _smclk = 1000000;
+    P2OUT = 0;
+    P2IN = 0;
+
+    TEST_CHECK(_reset(&config) == 0);
+    TEST_CHECK(config.error == 1);
+}
+
+/**
+ * \brief Reset and initialize the UART
+ * \param[in/out] config - the UART configuration
+ * \return the result of uart_init()
+ */
+static int _reset(uart_config_t *config)
+{
+    rbd_t rbd;
+
+    /* Release the ring buffers of the previous initialization */
+    for (rbd = 0; rbd < RING_BUFFER_MAX; rbd++) {
+        (void) ring_buffer_deinit(rbd);
+    }
+
+    UCA0CTL1 |= UCSWRST;
+    UCA0BR0 = 0;
+    UCA0BR1 = 0;
+    UCA0MCTL = 0;
+
+    return uart_init(config);
+}
+
+/**
+ * \brief Receive data through the RX ISR, transmitting anything it queues
+ * \param[in] data - the received data
+ * \param[in] len - the number of bytes
+ */
+static void _rx(const char *data, size_t len)
+{
+    while (len-- > 0) {
+        UCA0RXBUF = (unsigned char) *data++;
+        IFG2 |= UCA0RXIFG;
+        (void) uart_rx_isr();
+        TEST_CHECK((IFG2 & UCA0RXIFG) == 0);
+        (void) _tx_drain();
+    }
+}
+
+/**
+ * \brief Run the TX ISR until it has nothing left to send
+ * \return the number of bytes transmitted
+ */
+static size_t _tx_drain(void)
+{
+    const size_t start = sim_uca0_tx_len;
+    size_t last;
+
+    do {
+        last = sim_uca0_tx_len;
+        IFG2 |= UCA0TXIFG;
+        (void) uart_tx_isr();
+    } while ((IE2 & UCA0TXIE) && (sim_uca0_tx_len != last));
+
+    return sim_uca0_tx_len - start;
+}
+
+/**
+ * \brief Sleep until the TX ISR sends a byte
+ *
+ * Stands in for LPM0, the TX ISR runs once and should wake the CPU.
+ */
+static void _sleep_tx(void)
+{
+    _sleeps++;
+    IFG2 |= UCA0TXIFG;
+
+    if (uart_tx_isr() != 0) {
+        _wakes++;
+    }
+}
+
+/**
+ * \brief Sleep until the RX ISR has received some data
+ *
+ * Stands in for LPM0, three bytes are received and the CPU woken.
+ */
+static void _sleep_rx(void)
+{
+    _sleeps++;
+    _rx("ab\0", 3);
+}
+
+/**
+ * \brief Timer callback which does nothing
+ * \param[in] arg - unused
+ */
+static void _nop(void *arg)
+{
+    (void) arg;
+}
+
+/**
+ * \brief Check everything transmitted since the capture was last cleared
+ * \param[in] data - the expected data
+ * \param[in] len - the number of bytes
+ * \return non-zero if the transmitted data matches, 0 otherwise
+ */
+static int _tx_equals(const char *data, size_t len)
+{
+    size_t i;
+    int equal;
+
+    (void) _tx_drain();
+    equal = (sim_uca0_tx_len == len);
+
+    for (i = 0; (i < len) && (equal != 0); i++) {
+        equal = (sim_uca0_tx[i] == (unsigned char) data[i]);
+    }
+
+    return equal;
+}